@@ -1,7 +1,30 @@
 #define NONIUS_RUNNER
 #include "nonius.hpp"
 
+#include "concurrent_object_pool.hpp"
+#include "dense_object_pool.hpp"
 #include "object_pool.hpp"
+#include "pool_allocator.hpp"
+#include "pool_memory_resource.hpp"
+#include "pooled_shared.hpp"
+#include "soa_object_pool.hpp"
+#include "static_object_pool.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #ifdef BENCH_BOOST_POOL
 #include <boost/pool/object_pool.hpp>
@@ -108,6 +131,32 @@ private:
     std::vector<value_t*> ptr;
 };
 
+/// Test harness for DenseObjectPool, keeping handles rather than pointers as
+/// objects move when others are deleted
+template <typename T>
+class DenseObjectPoolHarness
+{
+public:
+    typedef T value_t;
+
+    DenseObjectPoolHarness(size_t block_size, size_t allocs)
+        : pool(static_cast<detail::index_t>(block_size)), handles(allocs)
+    {
+    }
+    void new_index(size_t i) { handles[i] = pool.new_object(); }
+    void delete_all() { pool.delete_all(); }
+    template <typename F>
+    void for_each(const F func) const
+    {
+        pool.for_each(func);
+    }
+    size_t count() const { return handles.size(); }
+
+private:
+    DenseObjectPool<T> pool;
+    std::vector<ObjectPoolHandle> handles;
+};
+
 #define BENCH_HEAP_ALLOC
 #ifdef BENCH_HEAP_ALLOC
 /// Test harness for running benchmark tests using the default system allocator.
@@ -227,6 +276,21 @@ void run_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
             });
     }
 
+    // DenseObjectPool alloc+free bench
+    {
+        const auto block_size = num_allocs;
+        snprintf(label, label_size, "DenseObjectPool<Sized<%zu>> %s", Size, bench_test.name());
+        registry.emplace_back(label,
+            [&bench_test, block_size, num_allocs](nonius::chronometer meter)
+            {
+                DenseObjectPoolHarness<SizedN> pool(block_size, num_allocs);
+                meter.measure([&bench_test, &pool]
+                    {
+                        return bench_test.run(pool);
+                    });
+            });
+    }
+
     // DynamicObjectPool alloc+free benches
     {
         static const size_t block_sizes[3] = {64, 128, 256};
@@ -281,6 +345,939 @@ void run_for_size(nonius::benchmark_registry& registry, size_t num_allocs)
 #endif // BENCH_HEAP_ALLOC
 }
 
+/// Fills a pool to the given percentage occupancy, deleting a pseudo random
+/// selection of entries.
+template <typename PoolT>
+void fill_to_occupancy(PoolT& pool, size_t num_entries, size_t percent)
+{
+    typedef typename PoolT::value_t value_t;
+    std::vector<value_t*> ptr(num_entries, nullptr);
+    for (auto& p : ptr)
+    {
+        p = pool.new_object();
+    }
+    uint32_t seed = 12345;
+    for (auto p : ptr)
+    {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 100 >= percent)
+        {
+            pool.delete_object(p);
+        }
+    }
+}
+
+// for_each over a partially occupied pool with each occupancy scan instruction set
+template <size_t Size>
+void run_for_occupancy(nonius::benchmark_registry& registry, size_t num_entries, size_t percent)
+{
+    typedef Sized<Size> SizedN;
+    typedef FixedObjectPool<SizedN> PoolT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    static const detail::ScanIsa isas[] = {
+        detail::ScanIsa::Scalar, detail::ScanIsa::SSE2, detail::ScanIsa::AVX2};
+    static const char* isa_names[] = {"scalar", "sse2", "avx2"};
+    const detail::ScanIsa default_isa = detail::get_scan_isa();
+    for (size_t i = 0; i < 3; ++i)
+    {
+        const detail::ScanIsa isa = isas[i];
+        if (!detail::set_scan_isa(isa))
+        {
+            continue;
+        }
+        snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> for_each %zu%% occupied %s", Size,
+            percent, isa_names[i]);
+        registry.emplace_back(label,
+            [isa, default_isa, num_entries, percent](nonius::chronometer meter)
+            {
+                PoolT pool(static_cast<typename PoolT::index_t>(num_entries));
+                fill_to_occupancy(pool, num_entries, percent);
+                detail::set_scan_isa(isa);
+                meter.measure([&pool]
+                    {
+                        pool.for_each([](SizedN* ptr)
+                            {
+                                ++ptr->c[0];
+                            });
+                    });
+                detail::set_scan_isa(default_isa);
+                pool.delete_all();
+            });
+    }
+    detail::set_scan_isa(default_isa);
+
+    snprintf(label, label_size, "DenseObjectPool<Sized<%zu>> for_each %zu%% occupied", Size,
+        percent);
+    registry.emplace_back(label,
+        [num_entries, percent](nonius::chronometer meter)
+        {
+            DenseObjectPool<SizedN> pool(static_cast<detail::index_t>(num_entries));
+            std::vector<ObjectPoolHandle> handles(num_entries);
+            for (auto& handle : handles)
+            {
+                handle = pool.new_object();
+            }
+            uint32_t seed = 12345;
+            for (auto handle : handles)
+            {
+                seed = seed * 1103515245 + 12345;
+                if ((seed >> 16) % 100 >= percent)
+                {
+                    pool.delete_object(handle);
+                }
+            }
+            meter.measure([&pool]
+                {
+                    pool.for_each([](SizedN* ptr)
+                        {
+                            ++ptr->c[0];
+                        });
+                });
+            pool.delete_all();
+        });
+}
+
+// for_each over a sparse DynamicObjectPool before and after compaction
+template <size_t Size>
+void run_compact(nonius::benchmark_registry& registry, size_t num_entries, size_t percent)
+{
+    typedef Sized<Size> SizedN;
+    typedef DynamicObjectPool<SizedN> PoolT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    static const size_t block_size = 256;
+
+    // measure the memory held before and after compacting for the labels
+    size_t sparse_bytes = 0;
+    size_t compact_bytes = 0;
+    {
+        PoolT pool(block_size);
+        fill_to_occupancy(pool, num_entries, percent);
+        pool.reclaim_memory();
+        sparse_bytes = pool.calc_stats().bytes_reserved;
+        pool.compact();
+        compact_bytes = pool.calc_stats().bytes_reserved;
+        pool.delete_all();
+    }
+
+    for (int compacted = 0; compacted < 2; ++compacted)
+    {
+        snprintf(label, label_size,
+            "DynamicObjectPool<Sized<%zu>> for_each %zu%% occupied %s %zu KB", Size, percent,
+            compacted ? "compacted" : "sparse", (compacted ? compact_bytes : sparse_bytes) >> 10);
+        registry.emplace_back(label,
+            [compacted, num_entries, percent](nonius::chronometer meter)
+            {
+                PoolT pool(block_size);
+                fill_to_occupancy(pool, num_entries, percent);
+                pool.reclaim_memory();
+                if (compacted)
+                {
+                    pool.compact();
+                }
+                meter.measure([&pool]
+                    {
+                        pool.for_each([](SizedN* ptr)
+                            {
+                                ++ptr->c[0];
+                            });
+                    });
+                pool.delete_all();
+            });
+    }
+}
+
+/// An entity with twelve fields, of which the partial update touches two
+struct Entity12
+{
+    float x, vx;
+    float other[10];
+};
+
+// updating 2 of 12 fields with FixedObjectPool and SoAObjectPool
+void run_soa(nonius::benchmark_registry& registry, size_t num_entries, size_t percent)
+{
+    typedef FixedObjectPool<Entity12> FixedT;
+    typedef SoAObjectPool<float, float, float, float, float, float, float, float, float, float,
+        float, float> SoAT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "FixedObjectPool<Entity12> x += vx %zu%% occupied", percent);
+    registry.emplace_back(label,
+        [num_entries, percent](nonius::chronometer meter)
+        {
+            FixedT pool(static_cast<detail::index_t>(num_entries));
+            fill_to_occupancy(pool, num_entries, percent);
+            meter.measure([&pool]
+                {
+                    pool.for_each([](Entity12* e)
+                        {
+                            e->x += e->vx;
+                        });
+                });
+            pool.delete_all();
+        });
+
+    snprintf(label, label_size, "SoAObjectPool<12 x float> x += vx %zu%% occupied", percent);
+    registry.emplace_back(label,
+        [num_entries, percent](nonius::chronometer meter)
+        {
+            SoAT pool(static_cast<detail::index_t>(num_entries));
+            std::vector<SoAT::index_t> entries(num_entries);
+            for (auto& entry : entries)
+            {
+                entry = pool.new_entry();
+            }
+            uint32_t seed = 12345;
+            for (auto entry : entries)
+            {
+                seed = seed * 1103515245 + 12345;
+                if ((seed >> 16) % 100 >= percent)
+                {
+                    pool.delete_entry(entry);
+                }
+            }
+            meter.measure([&pool]
+                {
+                    pool.for_each_span<0, 1>([](size_t count, float* x, const float* vx)
+                        {
+                            for (size_t i = 0; i < count; ++i)
+                            {
+                                x[i] += vx[i];
+                            }
+                        });
+                });
+            pool.delete_all();
+        });
+}
+
+/// Counts data TLB load misses of the calling thread using perf events on
+/// Linux. valid() is false where the counter is unavailable, e.g. when
+/// perf_event_paranoid forbids it or on other platforms.
+class DtlbMissCounter
+{
+public:
+    DtlbMissCounter() : fd(-1)
+    {
+#if defined(__linux__)
+        perf_event_attr attr;
+        ::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+    ~DtlbMissCounter()
+    {
+#if defined(__linux__)
+        if (fd != -1)
+        {
+            close(fd);
+        }
+#endif
+    }
+    bool valid() const { return fd != -1; }
+    void start()
+    {
+#if defined(__linux__)
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+    uint64_t stop()
+    {
+        uint64_t count = 0;
+#if defined(__linux__)
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &count, sizeof(count)) != sizeof(count))
+        {
+            count = 0;
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd;
+
+    DtlbMissCounter(const DtlbMissCounter&) = delete;
+    DtlbMissCounter& operator=(const DtlbMissCounter&) = delete;
+};
+
+/// Accumulates dTLB misses over every run of a benchmark. Nonius only
+/// reports times, so the totals are printed when the benchmark registry is
+/// destroyed at exit.
+struct DtlbMissReport
+{
+    std::string label;
+    uint64_t misses = 0;
+    uint64_t runs = 0;
+    bool valid = true;
+
+    ~DtlbMissReport()
+    {
+        if (!valid)
+        {
+            printf("%s: dTLB miss counter unavailable\n", label.c_str());
+        }
+        else if (runs != 0)
+        {
+            printf("%s: %llu dTLB load misses per run\n", label.c_str(),
+                static_cast<unsigned long long>(misses / runs));
+        }
+    }
+};
+
+/// Registers a benchmark of the given harness which also counts dTLB misses
+template <typename HarnessT, typename Test>
+void register_dtlb_bench(nonius::benchmark_registry& registry, const char* label,
+    size_t block_size, size_t num_allocs)
+{
+    std::shared_ptr<DtlbMissReport> report(new DtlbMissReport);
+    report->label = label;
+    registry.emplace_back(label,
+        [report, block_size, num_allocs](nonius::chronometer meter)
+        {
+            const Test bench_test;
+            HarnessT pool(block_size, num_allocs);
+            DtlbMissCounter counter;
+            report->valid = counter.valid();
+            if (counter.valid())
+            {
+                counter.start();
+            }
+            meter.measure([&bench_test, &pool]
+                {
+                    return bench_test.run(pool);
+                });
+            if (counter.valid())
+            {
+                report->misses += counter.stop();
+                report->runs += static_cast<uint64_t>(meter.runs());
+            }
+        });
+}
+
+/// Pool configuration backed by huge pages
+struct HugePageTraits : ObjectPoolTraits
+{
+    static const bool huge_pages = true;
+};
+
+// alloc+memset+free of pools large enough to be TLB bound, with and without huge pages
+template <size_t Size>
+void run_huge_pages(nonius::benchmark_registry& registry, size_t num_allocs)
+{
+    typedef Sized<Size> SizedN;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    static const size_t block_size = 16384;
+
+    snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %zu allocs 4K pages %s", Size,
+        num_allocs, BenchAllocMemsetFree().name());
+    register_dtlb_bench<ObjectPoolHarness<FixedObjectPool<SizedN> >, BenchAllocMemsetFree>(
+        registry, label, num_allocs, num_allocs);
+    snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %zu allocs huge pages %s", Size,
+        num_allocs, BenchAllocMemsetFree().name());
+    register_dtlb_bench<ObjectPoolHarness<FixedObjectPool<SizedN, HugePageTraits> >,
+        BenchAllocMemsetFree>(registry, label, num_allocs, num_allocs);
+    snprintf(label, label_size,
+        "DynamicObjectPool<Sized<%zu>> %zu allocs %zu byte blocks 4K pages %s", Size, num_allocs,
+        block_size, BenchAllocMemsetFree().name());
+    register_dtlb_bench<ObjectPoolHarness<DynamicObjectPool<SizedN> >, BenchAllocMemsetFree>(
+        registry, label, block_size, num_allocs);
+    snprintf(label, label_size,
+        "DynamicObjectPool<Sized<%zu>> %zu allocs %zu byte blocks huge pages %s", Size,
+        num_allocs, block_size, BenchAllocMemsetFree().name());
+    register_dtlb_bench<ObjectPoolHarness<DynamicObjectPool<SizedN, HugePageTraits> >,
+        BenchAllocMemsetFree>(registry, label, block_size, num_allocs);
+}
+
+/// Allocates count objects then deletes them, either one at a time with
+/// new_object and delete_object or in one call to new_objects and
+/// delete_objects
+template <typename PoolT>
+size_t single_alloc_free(PoolT& pool, std::vector<typename PoolT::value_t*>& ptrs)
+{
+    for (auto& ptr : ptrs)
+    {
+        ptr = pool.new_object();
+    }
+    for (auto ptr : ptrs)
+    {
+        pool.delete_object(ptr);
+    }
+    return ptrs.size();
+}
+
+template <typename PoolT>
+size_t batch_alloc_free(PoolT& pool, std::vector<typename PoolT::value_t*>& ptrs)
+{
+    const auto count = static_cast<typename PoolT::index_t>(ptrs.size());
+    pool.new_objects(count, ptrs.data());
+    pool.delete_objects(ptrs.data(), count);
+    return ptrs.size();
+}
+
+// single object loops against batch allocation for fixed and dynamic pools
+template <size_t Size>
+void run_batch(nonius::benchmark_registry& registry, size_t count)
+{
+    typedef Sized<Size> SizedN;
+    typedef FixedObjectPool<SizedN> FixedT;
+    typedef DynamicObjectPool<SizedN> DynamicT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    static const size_t block_size = 256;
+
+    snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %zu new_object+delete_object",
+        Size, count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            FixedT pool(static_cast<detail::index_t>(count));
+            std::vector<SizedN*> ptrs(count, nullptr);
+            meter.measure([&pool, &ptrs]
+                {
+                    return single_alloc_free(pool, ptrs);
+                });
+        });
+
+    snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %zu new_objects+delete_objects",
+        Size, count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            FixedT pool(static_cast<detail::index_t>(count));
+            std::vector<SizedN*> ptrs(count, nullptr);
+            meter.measure([&pool, &ptrs]
+                {
+                    return batch_alloc_free(pool, ptrs);
+                });
+        });
+
+    snprintf(label, label_size,
+        "DynamicObjectPool<Sized<%zu>> %zu byte blocks %zu new_object+delete_object", Size,
+        block_size, count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            DynamicT pool(block_size);
+            std::vector<SizedN*> ptrs(count, nullptr);
+            meter.measure([&pool, &ptrs]
+                {
+                    return single_alloc_free(pool, ptrs);
+                });
+        });
+
+    snprintf(label, label_size,
+        "DynamicObjectPool<Sized<%zu>> %zu byte blocks %zu new_objects+delete_objects", Size,
+        block_size, count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            DynamicT pool(block_size);
+            std::vector<SizedN*> ptrs(count, nullptr);
+            meter.measure([&pool, &ptrs]
+                {
+                    return batch_alloc_free(pool, ptrs);
+                });
+        });
+}
+
+// heap backed fixed pool against inline storage with single word occupancy
+template <size_t Size, size_t Count>
+void run_static(nonius::benchmark_registry& registry)
+{
+    typedef Sized<Size> SizedN;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %zu new_object+delete_object",
+        Size, Count);
+    registry.emplace_back(label,
+        [](nonius::chronometer meter)
+        {
+            FixedObjectPool<SizedN> pool(Count);
+            std::vector<SizedN*> ptrs(Count, nullptr);
+            meter.measure([&pool, &ptrs]
+                {
+                    return single_alloc_free(pool, ptrs);
+                });
+        });
+
+    snprintf(label, label_size, "StaticObjectPool<Sized<%zu>, %zu> new_object+delete_object",
+        Size, Count);
+    registry.emplace_back(label,
+        [](nonius::chronometer meter)
+        {
+            StaticObjectPool<SizedN, Count> pool;
+            std::vector<SizedN*> ptrs(Count, nullptr);
+            meter.measure([&pool, &ptrs]
+                {
+                    return single_alloc_free(pool, ptrs);
+                });
+        });
+}
+
+// creating a large pool and delete_all after light use, which only touch
+// entries below the high water index
+template <size_t Size>
+void run_lazy_init(nonius::benchmark_registry& registry, size_t num_entries, size_t num_used)
+{
+    typedef Sized<Size> SizedN;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %zu entries create+destroy", Size,
+        num_entries);
+    registry.emplace_back(label,
+        [num_entries](nonius::chronometer meter)
+        {
+            meter.measure([num_entries]
+                {
+                    FixedObjectPool<SizedN> pool(static_cast<detail::index_t>(num_entries));
+                    return pool.calc_stats().bytes_reserved;
+                });
+        });
+
+    snprintf(label, label_size, "FixedObjectPool<Sized<%zu>> %zu entries %zu used delete_all",
+        Size, num_entries, num_used);
+    registry.emplace_back(label,
+        [num_entries, num_used](nonius::chronometer meter)
+        {
+            FixedObjectPool<SizedN> pool(static_cast<detail::index_t>(num_entries));
+            std::vector<SizedN*> ptrs(num_used, nullptr);
+            meter.measure([&pool, &ptrs]
+                {
+                    const auto count = static_cast<detail::index_t>(ptrs.size());
+                    pool.new_objects(count, ptrs.data());
+                    pool.delete_all();
+                    return ptrs.size();
+                });
+        });
+}
+
+/// Fills a map with pseudo random keys then repeatedly erases the oldest key
+/// and inserts a new one, so every operation frees or allocates a node.
+template <typename MapT>
+size_t map_churn(MapT& map, size_t count)
+{
+    uint32_t insert_seed = 12345;
+    uint32_t erase_seed = insert_seed;
+    for (size_t i = 0; i < count; ++i)
+    {
+        insert_seed = insert_seed * 1103515245 + 12345;
+        map[insert_seed] = static_cast<uint32_t>(i);
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        erase_seed = erase_seed * 1103515245 + 12345;
+        map.erase(erase_seed);
+        insert_seed = insert_seed * 1103515245 + 12345;
+        map[insert_seed] = static_cast<uint32_t>(i);
+    }
+    map.clear();
+    return count;
+}
+
+// std::map insert/erase churn with the default allocator and PoolAllocator
+void run_map_churn(nonius::benchmark_registry& registry, size_t count)
+{
+    typedef std::pair<const uint32_t, uint32_t> ValueT;
+    typedef std::map<uint32_t, uint32_t> StdMapT;
+    typedef std::map<uint32_t, uint32_t, std::less<uint32_t>, PoolAllocator<ValueT> > PoolMapT;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "std::map std::allocator %zu insert+erase", count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            StdMapT map;
+            meter.measure([&map, count]
+                {
+                    return map_churn(map, count);
+                });
+        });
+
+    snprintf(label, label_size, "std::map PoolAllocator %zu insert+erase", count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            PoolAllocatorArena arena;
+            PoolMapT map((PoolAllocator<ValueT>(arena)));
+            meter.measure([&map, count]
+                {
+                    return map_churn(map, count);
+                });
+        });
+}
+
+/// Creates count shared objects, copies each reference twice and then
+/// releases every reference, in creation order
+template <typename PtrT, typename MakeF>
+size_t shared_churn(std::vector<PtrT>& ptrs, size_t count, const MakeF make)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        ptrs.push_back(make(i));
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        ptrs.push_back(ptrs[i]);
+        ptrs.push_back(ptrs[i]);
+    }
+    ptrs.clear();
+    return count;
+}
+
+// std::make_shared against SharedObjectPool with atomic and plain counts
+void run_shared(nonius::benchmark_registry& registry, size_t count)
+{
+    typedef Sized<64> SizedN;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    snprintf(label, label_size, "std::make_shared<Sized<64>> %zu make+copy+release", count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            std::vector<std::shared_ptr<SizedN> > ptrs;
+            ptrs.reserve(count * 3);
+            meter.measure([&ptrs, count]
+                {
+                    return shared_churn(ptrs, count, [](size_t)
+                        {
+                            return std::make_shared<SizedN>();
+                        });
+                });
+        });
+
+    snprintf(label, label_size, "SharedObjectPool<Sized<64>> %zu make+copy+release", count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            SharedObjectPool<SizedN> pool(4096);
+            std::vector<pooled_shared<SizedN> > ptrs;
+            ptrs.reserve(count * 3);
+            meter.measure([&pool, &ptrs, count]
+                {
+                    return shared_churn(ptrs, count, [&pool](size_t)
+                        {
+                            return pool.make_shared();
+                        });
+                });
+        });
+
+    snprintf(label, label_size,
+        "SharedObjectPool<Sized<64>> non-atomic %zu make+copy+release", count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            SharedObjectPool<SizedN, false> pool(4096);
+            std::vector<pooled_shared<SizedN, false> > ptrs;
+            ptrs.reserve(count * 3);
+            meter.measure([&pool, &ptrs, count]
+                {
+                    return shared_churn(ptrs, count, [&pool](size_t)
+                        {
+                            return pool.make_shared();
+                        });
+                });
+        });
+
+    // libstdc++ skips atomic count updates until the process starts a
+    // thread, so measure std::make_shared again once one has run. This is
+    // registered last as the process stays multithreaded.
+    snprintf(label, label_size,
+        "std::make_shared<Sized<64>> multithreaded %zu make+copy+release", count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            std::thread([] {}).join();
+            std::vector<std::shared_ptr<SizedN> > ptrs;
+            ptrs.reserve(count * 3);
+            meter.measure([&ptrs, count]
+                {
+                    return shared_churn(ptrs, count, [](size_t)
+                        {
+                            return std::make_shared<SizedN>();
+                        });
+                });
+        });
+}
+
+#if OBJECT_POOL_HAS_PMR
+/// Allocates count blocks of varying small sizes with the given alignment
+/// from a memory resource, then frees them in a different order
+size_t resource_alloc_free(std::pmr::memory_resource& mr, size_t count, size_t alignment)
+{
+    std::vector<std::pair<void*, size_t> > ptr(count);
+    uint32_t seed = 12345;
+    for (auto& p : ptr)
+    {
+        seed = seed * 1103515245 + 12345;
+        p.second = 8 + (seed >> 16) % 248;
+        p.first = mr.allocate(p.second, alignment);
+        ::memset(p.first, 0, p.second);
+    }
+    for (size_t i = 0; i < count; i += 2)
+    {
+        mr.deallocate(ptr[i].first, ptr[i].second, alignment);
+    }
+    for (size_t i = 1; i < count; i += 2)
+    {
+        mr.deallocate(ptr[i].first, ptr[i].second, alignment);
+    }
+    return count;
+}
+
+// pool_memory_resource against std::pmr::unsynchronized_pool_resource
+template <typename ResourceT>
+void run_memory_resource(nonius::benchmark_registry& registry, const char* name, size_t count)
+{
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+
+    static const size_t alignments[] = {8, 64};
+    for (auto alignment : alignments)
+    {
+        snprintf(label, label_size, "%s %zu allocs %zu byte aligned alloc+free", name, count,
+            alignment);
+        registry.emplace_back(label,
+            [count, alignment](nonius::chronometer meter)
+            {
+                ResourceT mr;
+                meter.measure([&mr, count, alignment]
+                    {
+                        return resource_alloc_free(mr, count, alignment);
+                    });
+            });
+    }
+
+    snprintf(label, label_size, "%s std::pmr::map %zu insert+erase", name, count);
+    registry.emplace_back(label,
+        [count](nonius::chronometer meter)
+        {
+            ResourceT mr;
+            std::pmr::map<uint32_t, uint32_t> map(&mr);
+            meter.measure([&map, count]
+                {
+                    return map_churn(map, count);
+                });
+        });
+}
+#endif // OBJECT_POOL_HAS_PMR
+
+/// FixedObjectPool guarded by a mutex, for comparison with the thread safe pools
+template <typename T>
+class MutexFixedObjectPool
+{
+public:
+    typedef typename FixedObjectPool<T>::index_t index_t;
+    MutexFixedObjectPool(index_t max_entries) : pool(max_entries) {}
+    T* new_object()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return pool.new_object();
+    }
+    void delete_object(const T* ptr)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pool.delete_object(ptr);
+    }
+
+private:
+    std::mutex mutex;
+    FixedObjectPool<T> pool;
+};
+
+/// Runs func on the given number of threads and waits for them to finish
+template <typename F>
+void run_threads(size_t num_threads, const F func)
+{
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        threads.emplace_back(func);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/// Each thread repeatedly allocates a few objects, writes to them and frees them
+template <typename AllocF, typename FreeF>
+void alloc_write_free(size_t num_ops, const AllocF alloc, const FreeF free)
+{
+    static const size_t num_held = 8;
+    for (size_t i = 0; i < num_ops; i += num_held)
+    {
+        Sized<16>* held[num_held];
+        for (auto& p : held)
+        {
+            p = alloc();
+            ::memset(p, static_cast<int>(i), sizeof(*p));
+        }
+        for (auto p : held)
+        {
+            free(p);
+        }
+    }
+}
+
+// multi-threaded alloc+free of thread safe pools
+void run_threaded(nonius::benchmark_registry& registry, size_t num_threads, size_t num_ops)
+{
+    typedef Sized<16> SizedN;
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    const auto max_entries = static_cast<detail::index_t>(num_threads * 8);
+
+    snprintf(label, label_size, "MutexFixedObjectPool<Sized<16>> %zu threads alloc+free",
+        num_threads);
+    registry.emplace_back(label,
+        [num_threads, num_ops, max_entries](nonius::chronometer meter)
+        {
+            MutexFixedObjectPool<SizedN> pool(max_entries);
+            meter.measure([&pool, num_threads, num_ops]
+                {
+                    run_threads(num_threads, [&pool, num_ops]
+                        {
+                            alloc_write_free(num_ops,
+                                [&pool]
+                                {
+                                    return pool.new_object();
+                                },
+                                [&pool](const SizedN* p)
+                                {
+                                    pool.delete_object(p);
+                                });
+                        });
+                });
+        });
+
+    snprintf(label, label_size, "LockFreeFixedObjectPool<Sized<16>> %zu threads alloc+free",
+        num_threads);
+    registry.emplace_back(label,
+        [num_threads, num_ops, max_entries](nonius::chronometer meter)
+        {
+            LockFreeFixedObjectPool<SizedN> pool(max_entries);
+            meter.measure([&pool, num_threads, num_ops]
+                {
+                    run_threads(num_threads, [&pool, num_ops]
+                        {
+                            alloc_write_free(num_ops,
+                                [&pool]
+                                {
+                                    return pool.new_object();
+                                },
+                                [&pool](const SizedN* p)
+                                {
+                                    pool.delete_object(p);
+                                });
+                        });
+                });
+        });
+
+    snprintf(label, label_size, "ConcurrentObjectPool<Sized<16>> %zu threads alloc+free",
+        num_threads);
+    registry.emplace_back(label,
+        [num_threads, num_ops](nonius::chronometer meter)
+        {
+            ConcurrentObjectPool<SizedN> pool(256, 32);
+            meter.measure([&pool, num_threads, num_ops]
+                {
+                    run_threads(num_threads, [&pool, num_ops]
+                        {
+                            ConcurrentObjectPool<SizedN>::ThreadCache cache(pool);
+                            alloc_write_free(num_ops,
+                                [&cache]
+                                {
+                                    return cache.new_object();
+                                },
+                                [&cache](const SizedN* p)
+                                {
+                                    cache.delete_object(p);
+                                });
+                        });
+                });
+        });
+}
+
+struct PaddedTraits : ObjectPoolTraits
+{
+    static const bool cache_line_padding = true;
+};
+
+/// Allocates one counter per thread from the pool, consecutively, then each
+/// thread increments its own counter
+template <typename PoolT>
+void increment_counters(PoolT& pool, size_t num_threads, size_t num_writes)
+{
+    std::vector<uint64_t*> counters;
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        counters.push_back(pool.new_object(0u));
+    }
+    std::atomic<size_t> next_counter(0);
+    run_threads(num_threads, [&counters, &next_counter, num_writes]
+        {
+            volatile uint64_t* counter = counters[next_counter++];
+            for (size_t i = 0; i < num_writes; ++i)
+            {
+                *counter = *counter + 1;
+            }
+        });
+    for (auto counter : counters)
+    {
+        pool.delete_object(counter);
+    }
+}
+
+// threads writing to objects next to each other in a pool, with and without
+// cache line padding
+void run_false_sharing(
+    nonius::benchmark_registry& registry, size_t num_threads, size_t num_writes)
+{
+    static const size_t label_size = 1024;
+    char label[1024] = {};
+    const auto max_entries = static_cast<detail::index_t>(num_threads);
+
+    snprintf(label, label_size, "FixedObjectPool<uint64_t> %zu threads counters", num_threads);
+    registry.emplace_back(label,
+        [num_threads, num_writes, max_entries](nonius::chronometer meter)
+        {
+            FixedObjectPool<uint64_t> pool(max_entries);
+            meter.measure([&pool, num_threads, num_writes]
+                {
+                    increment_counters(pool, num_threads, num_writes);
+                });
+        });
+
+    snprintf(label, label_size, "FixedObjectPool<uint64_t, PaddedTraits> %zu threads counters",
+        num_threads);
+    registry.emplace_back(label,
+        [num_threads, num_writes, max_entries](nonius::chronometer meter)
+        {
+            FixedObjectPool<uint64_t, PaddedTraits> pool(max_entries);
+            meter.measure([&pool, num_threads, num_writes]
+                {
+                    increment_counters(pool, num_threads, num_writes);
+                });
+        });
+}
+
 // Auto registers tests with Nonius on static constructon.
 struct BenchmarkRegistrar
 {
@@ -298,6 +1295,59 @@ struct BenchmarkRegistrar
         run_for_size<16, BenchAllocMemsetFree>(registry, num_allocs);
         run_for_size<128, BenchAllocMemsetFree>(registry, num_allocs);
         run_for_size<512, BenchAllocMemsetFree>(registry, num_allocs);
+
+        // bench alloc+memset+free of large pools with and without huge pages
+        static const size_t num_large_allocs = 131072;
+        run_huge_pages<64>(registry, num_large_allocs);
+
+        // bench for_each at different occupancy levels
+        static const size_t num_entries = 65536;
+        run_for_occupancy<16>(registry, num_entries, 1);
+        run_for_occupancy<16>(registry, num_entries, 10);
+        run_for_occupancy<16>(registry, num_entries, 50);
+        run_for_occupancy<16>(registry, num_entries, 90);
+
+        // bench partial field updates with array of structs and structure of arrays
+        run_soa(registry, num_entries, 100);
+        run_soa(registry, num_entries, 90);
+        run_soa(registry, num_entries, 50);
+
+        // bench for_each over a sparse pool before and after compaction
+        run_compact<64>(registry, num_entries, 10);
+
+        // bench single object loops against batch allocation
+        run_batch<16>(registry, 10000);
+        run_batch<128>(registry, 10000);
+
+        // bench small pools with inline storage
+        run_static<16, 64>(registry);
+        run_static<16, 1000>(registry);
+
+        // bench pool creation and delete_all against pool size
+        run_lazy_init<16>(registry, 10000000, 1000);
+
+        // bench node container churn through PoolAllocator
+        run_map_churn(registry, num_allocs);
+        run_map_churn(registry, 100000);
+
+        // bench shared object reference counting
+        run_shared(registry, num_allocs);
+
+#if OBJECT_POOL_HAS_PMR
+        // bench memory resources
+        run_memory_resource<pool_memory_resource>(
+            registry, "pool_memory_resource", num_allocs);
+        run_memory_resource<std::pmr::unsynchronized_pool_resource>(
+            registry, "unsynchronized_pool_resource", num_allocs);
+#endif // OBJECT_POOL_HAS_PMR
+
+        // bench thread safe pools
+        static const size_t num_ops = 100000;
+        run_threaded(registry, 1, num_ops);
+        run_threaded(registry, 4, num_ops);
+
+        // bench false sharing between threads writing neighbouring objects
+        run_false_sharing(registry, 4, 1000000);
     }
 };
 BenchmarkRegistrar g_benchmark_registrar;
@@ -0,0 +1,528 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#include "concurrent_object_pool.hpp"
+
+ThreadPoolExecutor::ThreadPoolExecutor()
+    : ThreadPoolExecutor(std::max(std::thread::hardware_concurrency(), 1u) - 1)
+{
+}
+
+ThreadPoolExecutor::ThreadPoolExecutor(size_t num_threads)
+    : task_(nullptr), num_tasks_(0), next_task_(0), generation_(0), num_busy_(0), quit_(false)
+{
+    for (size_t i = 0; i < num_threads; ++i)
+    {
+        threads_.emplace_back(&ThreadPoolExecutor::worker_main, this);
+    }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    work_cv_.notify_all();
+    for (auto& thread : threads_)
+    {
+        thread.join();
+    }
+}
+
+size_t ThreadPoolExecutor::num_workers() const
+{
+    return threads_.size() + 1;
+}
+
+void ThreadPoolExecutor::run_tasks(size_t num_tasks, const Task& task)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // workers which woke late for the previous run must finish first
+        done_cv_.wait(lock, [this]
+            {
+                return num_busy_ == 0;
+            });
+        task_ = &task;
+        num_tasks_ = num_tasks;
+        next_task_ = 0;
+        ++generation_;
+    }
+    work_cv_.notify_all();
+    execute(num_tasks, task);
+    std::unique_lock<std::mutex> lock(mutex_);
+    // every task has been claimed, wait for the workers running them
+    done_cv_.wait(lock, [this]
+        {
+            return num_busy_ == 0;
+        });
+    task_ = nullptr;
+}
+
+void ThreadPoolExecutor::execute(size_t num_tasks, const Task& task)
+{
+    for (size_t index = next_task_++; index < num_tasks; index = next_task_++)
+    {
+        task(index);
+    }
+}
+
+void ThreadPoolExecutor::worker_main()
+{
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        work_cv_.wait(lock, [this, generation]
+            {
+                return quit_ || generation_ != generation;
+            });
+        if (quit_)
+        {
+            return;
+        }
+        generation = generation_;
+        if (task_ == nullptr)
+        {
+            // woke after the run had already completed
+            continue;
+        }
+        const Task* task = task_;
+        const size_t num_tasks = num_tasks_;
+        ++num_busy_;
+        lock.unlock();
+        execute(num_tasks, *task);
+        lock.lock();
+        if (--num_busy_ == 0)
+        {
+            done_cv_.notify_all();
+        }
+    }
+}
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace tests
+{
+
+TEST_CASE("ConcurrentObjectPool single thread", "[concurrentpool]")
+{
+    ConcurrentObjectPool<uint32_t> mp(64, 16);
+    {
+        ConcurrentObjectPool<uint32_t>::ThreadCache cache(mp);
+        std::vector<uint32_t*> v;
+        for (uint32_t i = 0; i < 200; ++i)
+        {
+            uint32_t* p = cache.new_object(i);
+            REQUIRE(p != nullptr);
+            v.push_back(p);
+        }
+        CHECK(mp.calc_stats().num_allocations == 200u);
+        uint32_t sum = 0;
+        mp.for_each([&sum](const uint32_t* p)
+            {
+                sum += *p;
+            });
+        CHECK(sum == 199u * 200u / 2);
+        // cached entries are not visited by for_each
+        for (size_t i = 0; i < 100; ++i)
+        {
+            cache.delete_object(v[i]);
+        }
+        CHECK(mp.calc_stats().num_allocations == 100u);
+        size_t count = 0;
+        mp.for_each([&count](const uint32_t* p)
+            {
+                CHECK(*p >= 100u);
+                ++count;
+            });
+        CHECK(count == 100u);
+        for (size_t i = 100; i < 200; ++i)
+        {
+            cache.delete_object(v[i]);
+        }
+        CHECK(mp.calc_stats().num_allocations == 0u);
+    }
+    // all cached entries were returned so every block can be reclaimed
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+}
+
+TEST_CASE("ConcurrentObjectPool multiple threads", "[concurrentpool]")
+{
+    static const size_t num_threads = 4;
+    static const size_t num_objects = 2000;
+    ConcurrentObjectPool<uint32_t> mp(128, 32);
+    // each thread deletes the previous thread's objects to exercise
+    // deleting through a different cache to the one that allocated
+    std::vector<std::vector<uint32_t*>> objects(num_threads);
+    std::atomic<size_t> num_allocated(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&mp, &objects, &num_allocated, &failed, t]
+            {
+                ConcurrentObjectPool<uint32_t>::ThreadCache cache(mp);
+                std::vector<uint32_t*>& mine = objects[t];
+                for (size_t round = 0; round < 10; ++round)
+                {
+                    for (size_t i = 0; i < num_objects; ++i)
+                    {
+                        mine.push_back(cache.new_object(static_cast<uint32_t>(t)));
+                    }
+                    for (auto p : mine)
+                    {
+                        if (p == nullptr || *p != t)
+                        {
+                            failed = true;
+                        }
+                    }
+                    if (round != 9)
+                    {
+                        for (auto p : mine)
+                        {
+                            cache.delete_object(p);
+                        }
+                        mine.clear();
+                    }
+                }
+                num_allocated += mine.size();
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(!failed);
+    CHECK(num_allocated == num_threads * num_objects);
+    CHECK(mp.calc_stats().num_allocations == num_threads * num_objects);
+    std::vector<size_t> counts(num_threads, 0);
+    mp.for_each([&counts](const uint32_t* p)
+        {
+            ++counts[*p];
+        });
+    for (auto count : counts)
+    {
+        CHECK(count == num_objects);
+    }
+
+    threads.clear();
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&mp, &objects, t]
+            {
+                ConcurrentObjectPool<uint32_t>::ThreadCache cache(mp);
+                for (auto p : objects[(t + 1) % num_threads])
+                {
+                    cache.delete_object(p);
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("ThreadOwnedObjectPool remote delete", "[threadownedpool]")
+{
+    static const size_t num_threads = 4;
+    static const size_t num_objects = 1000;
+    ThreadOwnedObjectPool<uint64_t> mp(64);
+    CHECK(mp.is_owner());
+    std::vector<uint64_t*> v;
+    for (uint64_t i = 0; i < num_threads * num_objects; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    typedef ThreadOwnedObjectPool<uint64_t>::Handle Handle;
+    const Handle h0 = mp.get_handle(v[0]);
+    // other threads delete all objects while the owner keeps allocating
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&mp, &v, &failed, t]
+            {
+                if (mp.is_owner())
+                {
+                    failed = true;
+                }
+                for (size_t i = t * num_objects; i < (t + 1) * num_objects; ++i)
+                {
+                    mp.delete_object(v[i]);
+                }
+            });
+    }
+    std::vector<uint64_t*> owned;
+    for (uint64_t i = 0; i < num_objects; ++i)
+    {
+        owned.push_back(mp.new_object(i));
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(!failed);
+    mp.collect();
+    CHECK(mp.get_object(h0) == nullptr);
+    CHECK(mp.calc_stats().num_allocations == num_objects);
+    // the remotely freed entries are reused rather than adding blocks
+    const size_t num_blocks = mp.calc_stats().num_blocks;
+    for (uint64_t i = 0; i < num_threads * num_objects - num_objects; ++i)
+    {
+        owned.push_back(mp.new_object(i));
+    }
+    CHECK(mp.calc_stats().num_blocks == num_blocks);
+    for (auto p : owned)
+    {
+        mp.delete_object(p);
+    }
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    CHECK(mp.collect() == 0u);
+}
+
+TEST_CASE("ThreadOwnedObjectPool new_object collects", "[threadownedpool]")
+{
+    ThreadOwnedObjectPool<uint64_t> mp(16);
+    std::vector<uint64_t*> v;
+    for (uint64_t i = 0; i < 16; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    std::thread([&mp, &v]
+        {
+            for (auto p : v)
+            {
+                mp.delete_object(p);
+            }
+        }).join();
+    // the owner picks up remote frees on allocation without an explicit collect
+    uint64_t* p = mp.new_object(uint64_t(1));
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 1u);
+    CHECK(mp.collect() == 0u);
+    mp.delete_object(p);
+}
+
+/// Executor which runs every task on the calling thread
+struct SerialExecutor
+{
+    size_t num_workers() const { return 3; }
+    template <typename F>
+    void run(size_t num_tasks, const F& task)
+    {
+        for (size_t i = 0; i < num_tasks; ++i)
+        {
+            task(i);
+        }
+    }
+};
+
+template <typename PoolT, typename E>
+void parallelForEach(PoolT& mp, E& executor, size_t size)
+{
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        v.push_back(mp.new_object(0u));
+    }
+    // leave the pool unevenly occupied
+    for (size_t i = 0; i < size / 2; ++i)
+    {
+        if (i % 3 != 0)
+        {
+            mp.delete_object(v[i]);
+            v[i] = nullptr;
+        }
+    }
+    for (int pass = 0; pass < 4; ++pass)
+    {
+        mp.parallel_for_each([](uint32_t* p)
+            {
+                ++*p;
+            },
+            executor);
+    }
+    // every live object was visited exactly once per pass
+    for (auto p : v)
+    {
+        if (p)
+        {
+            CHECK(*p == 4u);
+        }
+    }
+    mp.delete_all();
+}
+
+TEST_CASE("parallel_for_each", "[parallel]")
+{
+    ThreadPoolExecutor executor(3);
+    CHECK(executor.num_workers() == 4u);
+    SerialExecutor serial;
+    {
+        FixedObjectPool<uint32_t> mp(1000);
+        parallelForEach(mp, executor, 1000);
+        parallelForEach(mp, serial, 1000);
+        parallelForEach(mp, executor, 10);
+    }
+    {
+        DynamicObjectPool<uint32_t> mp(64);
+        parallelForEach(mp, executor, 1000);
+        parallelForEach(mp, serial, 1000);
+        parallelForEach(mp, executor, 10);
+    }
+    {
+        ThreadPoolExecutor single(0);
+        CHECK(single.num_workers() == 1u);
+        DynamicObjectPool<uint32_t> mp(64);
+        parallelForEach(mp, single, 1000);
+    }
+}
+
+TEST_CASE("LockFreeFixedObjectPool single thread", "[lockfreepool]")
+{
+    LockFreeFixedObjectPool<uint32_t> mp(64);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        uint32_t* p = mp.new_object(i);
+        REQUIRE(p != nullptr);
+        v.push_back(p);
+    }
+    // the pool is full
+    CHECK(mp.new_object(0u) == nullptr);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    for (size_t i = 0; i < 64; i += 2)
+    {
+        mp.delete_object(v[i]);
+    }
+    CHECK(mp.calc_stats().num_allocations == 32u);
+    uint32_t expected = 1;
+    mp.for_each([&expected](const uint32_t* p)
+        {
+            CHECK(*p == expected);
+            expected += 2;
+        });
+    // freed entries are reused
+    for (size_t i = 0; i < 64; i += 2)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        REQUIRE(v[i] != nullptr);
+    }
+    CHECK(mp.new_object(0u) == nullptr);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    CHECK(mp.new_object(0u) != nullptr);
+    mp.delete_all();
+}
+
+/// Entry too large for the pool's storage to fit in the address space
+struct LockFreeHuge
+{
+    uint8_t data[1 << 20];
+};
+
+TEST_CASE("LockFreeFixedObjectPool failed allocation", "[lockfreepool]")
+{
+    LockFreeFixedObjectPool<LockFreeHuge> mp(0xfffffff0u);
+    CHECK(mp.new_object() == nullptr);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    mp.delete_all();
+}
+
+TEST_CASE("LockFreeFixedObjectPool stress", "[lockfreepool]")
+{
+    // a small pool shared by many threads maximises contention on the head
+    static const size_t num_threads = 8;
+    static const size_t num_iterations = 20000;
+    static const uint32_t num_entries = 16;
+    struct Entry
+    {
+        std::atomic<uint32_t> owner;
+        Entry(uint32_t o) : owner(o) {}
+    };
+    LockFreeFixedObjectPool<Entry> mp(num_entries);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&mp, &failed, t]
+            {
+                Entry* held[2] = {nullptr, nullptr};
+                for (size_t i = 0; i < num_iterations; ++i)
+                {
+                    const size_t slot = i & 1;
+                    if (held[slot])
+                    {
+                        // nobody else may have been given this entry
+                        if (held[slot]->owner.load() != t)
+                        {
+                            failed = true;
+                        }
+                        mp.delete_object(held[slot]);
+                    }
+                    held[slot] = mp.new_object(t);
+                }
+                for (auto p : held)
+                {
+                    if (p && p->owner.load() != t)
+                    {
+                        failed = true;
+                    }
+                    mp.delete_object(p);
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(!failed);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    // every entry must be back on the free list exactly once
+    std::vector<Entry*> v;
+    for (uint32_t i = 0; i < num_entries; ++i)
+    {
+        Entry* p = mp.new_object(i);
+        REQUIRE(p != nullptr);
+        v.push_back(p);
+    }
+    CHECK(mp.new_object(0u) == nullptr);
+    std::sort(v.begin(), v.end());
+    CHECK(std::unique(v.begin(), v.end()) == v.end());
+    mp.delete_all();
+}
+
+} // namespace tests
+
+#endif // UNIT_TESTS
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef _BITS_CONCURRENT_OBJECT_POOL_HPP_
+#define _BITS_CONCURRENT_OBJECT_POOL_HPP_
+
+#include "object_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// ConcurrentObjectPool is a thread safe front end to a DynamicObjectPool.
+///
+/// Each thread allocates and deletes objects through its own ThreadCache,
+/// which holds a small number of reserved pool entries. Allocating from and
+/// deleting to the cache takes no lock and performs no atomic operations.
+/// When the cache is empty it is refilled with a batch of entries from the
+/// shared pool, and when it is full half of it is returned, both under a
+/// lock. Objects may be deleted through any thread's cache.
+template <typename T, typename Traits = ObjectPoolTraits>
+class ConcurrentObjectPool
+{
+    // setting occupancy bits would race between threads sharing a block
+    static_assert(!Traits::occupancy_bitmap,
+        "ConcurrentObjectPool does not support occupancy bitmaps");
+
+public:
+    typedef detail::index_t index_t;
+    typedef T value_t;
+
+    /// Cache of reserved entries for a single thread. A ThreadCache must
+    /// only be used by one thread at a time and must be destroyed before
+    /// its pool.
+    class ThreadCache
+    {
+    public:
+        ThreadCache(ConcurrentObjectPool& pool);
+        ~ThreadCache();
+
+        /// Constructs a new object from the pool. Returns nullptr if there
+        /// is no available space.
+        template <class... P>
+        T* new_object(P&&... params);
+
+        /// Deletes the given pointer. The pointer must be owned by the pool
+        /// but may have been allocated through any thread's cache.
+        void delete_object(const T* ptr);
+
+        /// Returns all cached entries to the pool
+        void flush();
+
+    private:
+        ConcurrentObjectPool& pool_;
+        /// reserved entries which are not constructed
+        T** entries_;
+        /// number of entries currently cached
+        index_t num_entries_;
+
+        ThreadCache(const ThreadCache&) = delete;
+        ThreadCache& operator=(const ThreadCache&) = delete;
+    };
+
+    /// The cache size is the maximum number of entries each ThreadCache
+    /// holds, half of which are moved to or from the pool at a time.
+    ConcurrentObjectPool(index_t entries_per_block, index_t cache_size);
+
+    /// Reclaim unused object pool blocks. Blocks holding cached entries are
+    /// not reclaimed.
+    void reclaim_memory();
+
+    /// Calls the given function for all allocated entries. No thread may
+    /// allocate or delete objects while this is running.
+    template <typename F>
+    void for_each(const F func) const;
+
+    /// Calculates object pool stats. No thread may allocate or delete
+    /// objects while this is running. num_allocations counts live objects,
+    /// excluding entries held by thread caches, so is linear in capacity;
+    /// the other counters include cached entries.
+    ObjectPoolStats calc_stats() const;
+
+private:
+    /// Reserves a batch of entries under the pool lock
+    index_t reserve_entries(T** entries, index_t count);
+
+    /// Releases a batch of entries under the pool lock
+    void release_entries(T* const* entries, index_t count);
+
+    mutable std::mutex mutex_;
+    DynamicObjectPool<T, Traits> pool_;
+    /// the maximum number of entries in each thread cache
+    const index_t cache_size_;
+
+    ConcurrentObjectPool(const ConcurrentObjectPool&) = delete;
+    ConcurrentObjectPool& operator=(const ConcurrentObjectPool&) = delete;
+};
+
+
+/// ThreadOwnedObjectPool is a DynamicObjectPool owned by a single thread
+/// which other threads may delete objects from.
+///
+/// Only the owning thread may allocate. When any other thread deletes an
+/// object, the object is destructed on that thread and its entry is pushed
+/// onto a lock-free list of remote frees. The owner returns these entries to
+/// the pool in one batch on its next new_object or an explicit collect(), so
+/// the owner's own allocations and deletes are never contended.
+///
+/// The list is threaded through the deleted objects' storage, so T must be
+/// at least the size of a pointer.
+template <typename T, typename Traits = ObjectPoolTraits>
+class ThreadOwnedObjectPool
+{
+    static_assert(sizeof(T) >= sizeof(void*),
+        "ThreadOwnedObjectPool stores remote free links in deleted objects");
+    // clearing occupancy bits from other threads would race with the owner
+    static_assert(!Traits::occupancy_bitmap,
+        "ThreadOwnedObjectPool does not support occupancy bitmaps");
+
+public:
+    typedef detail::index_t index_t;
+    typedef T value_t;
+    typedef typename DynamicObjectPool<T, Traits>::Handle Handle;
+
+    /// The pool is owned by the constructing thread and must be destroyed
+    /// by the owning thread.
+    ThreadOwnedObjectPool(index_t entries_per_block);
+    ~ThreadOwnedObjectPool();
+
+    /// Transfers ownership to the calling thread. The previous owner must no
+    /// longer be using the pool.
+    void take_ownership();
+
+    /// Returns true if called from the owning thread
+    bool is_owner() const;
+
+    /// Constructs a new object from the pool, first collecting any remote
+    /// frees. Must be called from the owning thread. Returns nullptr if there
+    /// is no available space.
+    template <class... P>
+    T* new_object(P&&... params);
+
+    /// Deletes the given pointer from any thread. The pointer must be owned
+    /// by the pool.
+    void delete_object(const T* ptr);
+
+    /// Returns entries deleted by other threads to the pool. Must be called
+    /// from the owning thread. Returns the number of entries collected.
+    size_t collect();
+
+    /// Delete all current allocations. Must be called from the owning thread
+    /// while no other thread is deleting objects.
+    void delete_all();
+
+    /// Reclaim unused object pool blocks. Must be called from the owning
+    /// thread. Entries deleted remotely since the last collect are not
+    /// reclaimed.
+    void reclaim_memory();
+
+    /// Returns a handle to the given pointer, see DynamicObjectPool. Must be
+    /// called from the owning thread while no other thread is deleting
+    /// objects, as remote deletes update the entry's generation.
+    Handle get_handle(const T* ptr) const;
+
+    /// Returns the object referred to by the handle, see DynamicObjectPool.
+    /// Must be called from the owning thread while no other thread is
+    /// deleting objects.
+    T* get_object(Handle handle) const;
+
+    /// Calls the given function for all allocated entries. Must be called
+    /// from the owning thread while no other thread is deleting objects.
+    template <typename F>
+    void for_each(const F func) const;
+
+    /// Calculates object pool stats. Must be called from the owning thread
+    /// while no other thread is deleting objects. num_allocations counts
+    /// live objects, excluding uncollected remote deletes, so is linear in
+    /// capacity.
+    ObjectPoolStats calc_stats() const;
+
+    /// Registers the pool's blocks with an owner, see DynamicObjectPool
+    void set_owner(void* owner);
+
+    /// Returns the owner set on the pool holding the given live object
+    static void* find_owner(const T* ptr);
+
+private:
+    /// Reads and writes the remote free link stored in a deleted entry
+    static T* load_link(const T* ptr);
+    static void store_link(T* ptr, T* next);
+
+    DynamicObjectPool<T, Traits> pool_;
+    std::thread::id owner_;
+    /// head of the list of remotely deleted entries
+    std::atomic<T*> remote_head_;
+    /// entries taken from the remote list by collect, kept to reuse capacity
+    std::vector<T*> collected_;
+
+    ThreadOwnedObjectPool(const ThreadOwnedObjectPool&) = delete;
+    ThreadOwnedObjectPool& operator=(const ThreadOwnedObjectPool&) = delete;
+};
+
+
+/// LockFreeFixedObjectPool is a thread safe variant of FixedObjectPool.
+///
+/// The free list head is an atomic word combining the index of the first
+/// free entry with a counter which is incremented on every update, so a
+/// compare and swap fails if the head was popped and pushed back in between
+/// (the ABA problem). The free list links are atomic as a popping thread may
+/// read a link while another thread rewrites it. new_object and
+/// delete_object are lock-free and may be called from any thread.
+template <typename T>
+class LockFreeFixedObjectPool
+{
+public:
+    typedef detail::index_t index_t;
+    typedef T value_t;
+
+    LockFreeFixedObjectPool(index_t max_entries);
+    ~LockFreeFixedObjectPool();
+
+    /// Constructs a new object from the pool. Returns nullptr if there is no
+    /// available space.
+    template <class... P>
+    T* new_object(P&&... params);
+
+    /// Deletes the given pointer. The pointer must be owned by the pool.
+    void delete_object(const T* ptr);
+
+    /// Delete all current allocations. No thread may allocate or delete
+    /// objects while this is running.
+    void delete_all();
+
+    /// Calls the given function for all allocated entries. No thread may
+    /// allocate or delete objects while this is running.
+    template <typename F>
+    void for_each(const F func) const;
+
+    /// Calculates object pool stats. No thread may allocate or delete
+    /// objects while this is running.
+    ObjectPoolStats calc_stats() const;
+
+private:
+    typedef std::atomic<index_t> link_t;
+
+    /// Splits and combines the free list head index and update counter
+    static index_t head_index(uint64_t head);
+    static uint64_t make_head(index_t index, uint64_t prev_head);
+
+    /// Initialises the free list with every entry free
+    void init_free_list();
+
+    /// Free list head, the low 32 bits are the index of the first free
+    /// entry and the high 32 bits are a counter to prevent ABA.
+    std::atomic<uint64_t> free_head_;
+    /// per entry free list links, an allocated entry links to itself
+    link_t* links_;
+    /// storage for entries
+    T* memory_;
+    const index_t max_entries_;
+
+    LockFreeFixedObjectPool(const LockFreeFixedObjectPool&) = delete;
+    LockFreeFixedObjectPool& operator=(const LockFreeFixedObjectPool&) = delete;
+};
+
+
+/// ThreadPoolExecutor runs tasks for parallel_for_each on a set of worker
+/// threads which persist between calls. The calling thread also runs tasks.
+class ThreadPoolExecutor
+{
+public:
+    /// Starts the given number of worker threads in addition to the calling
+    /// thread. By default one less than the hardware concurrency is used.
+    ThreadPoolExecutor();
+    ThreadPoolExecutor(size_t num_threads);
+    ~ThreadPoolExecutor();
+
+    /// Returns the number of threads tasks are run on, including the caller
+    size_t num_workers() const;
+
+    /// Calls task(i) for each i in [0, num_tasks) across all threads,
+    /// returning once every call has completed. Must not be called
+    /// concurrently or from inside a task.
+    template <typename F>
+    void run(size_t num_tasks, const F& task);
+
+private:
+    typedef std::function<void(size_t)> Task;
+
+    void run_tasks(size_t num_tasks, const Task& task);
+
+    /// Claims and runs tasks until none remain
+    void execute(size_t num_tasks, const Task& task);
+
+    void worker_main();
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    /// signalled when new tasks are available or the threads should exit
+    std::condition_variable work_cv_;
+    /// signalled when a worker finishes running tasks
+    std::condition_variable done_cv_;
+    /// the current tasks, valid while generation_ is unchanged
+    const Task* task_;
+    size_t num_tasks_;
+    /// index of the next task to claim
+    std::atomic<size_t> next_task_;
+    /// incremented each time run is called
+    uint64_t generation_;
+    /// number of worker threads running tasks
+    size_t num_busy_;
+    bool quit_;
+
+    ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+    ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+};
+
+#include "concurrent_object_pool.inl"
+
+#endif // _BITS_CONCURRENT_OBJECT_POOL_HPP_
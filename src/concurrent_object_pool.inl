@@ -0,0 +1,432 @@
+// Header guards an include is for code completion in IDEs
+// Don't include this file directly!
+#ifndef _BITS_CONCURRENT_OBJECT_POOL_INL_
+#define _BITS_CONCURRENT_OBJECT_POOL_INL_
+
+#ifndef _BITS_CONCURRENT_OBJECT_POOL_HPP_
+#include "concurrent_object_pool.hpp"
+#endif
+
+template <typename T, typename Traits>
+ConcurrentObjectPool<T, Traits>::ThreadCache::ThreadCache(ConcurrentObjectPool& pool)
+    : pool_(pool), entries_(new T*[pool.cache_size_]), num_entries_(0)
+{
+}
+
+template <typename T, typename Traits>
+ConcurrentObjectPool<T, Traits>::ThreadCache::~ThreadCache()
+{
+    flush();
+    delete[] entries_;
+}
+
+template <typename T, typename Traits>
+template <class... P>
+T* ConcurrentObjectPool<T, Traits>::ThreadCache::new_object(P&&... params)
+{
+    if (num_entries_ == 0)
+    {
+        // refill half of the cache from the pool
+        const index_t count = std::max<index_t>(pool_.cache_size_ / 2, 1);
+        num_entries_ = pool_.reserve_entries(entries_, count);
+        if (num_entries_ == 0)
+        {
+            return nullptr;
+        }
+    }
+    T* ptr = entries_[--num_entries_];
+    return pool_.pool_.construct_reserved(ptr, std::forward<P>(params)...);
+}
+
+template <typename T, typename Traits>
+void ConcurrentObjectPool<T, Traits>::ThreadCache::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        pool_.pool_.destruct_reserved(ptr);
+        if (num_entries_ == pool_.cache_size_)
+        {
+            // return the most recently cached half to the pool
+            const index_t count = std::max<index_t>(pool_.cache_size_ / 2, 1);
+            num_entries_ -= count;
+            pool_.release_entries(entries_ + num_entries_, count);
+        }
+        entries_[num_entries_++] = const_cast<T*>(ptr);
+    }
+}
+
+template <typename T, typename Traits>
+void ConcurrentObjectPool<T, Traits>::ThreadCache::flush()
+{
+    if (num_entries_ != 0)
+    {
+        pool_.release_entries(entries_, num_entries_);
+        num_entries_ = 0;
+    }
+}
+
+template <typename T, typename Traits>
+ConcurrentObjectPool<T, Traits>::ConcurrentObjectPool(
+    index_t entries_per_block, index_t cache_size)
+    : pool_(static_cast<typename DynamicObjectPool<T, Traits>::index_t>(entries_per_block)),
+      cache_size_(std::max<index_t>(cache_size, 1))
+{
+}
+
+template <typename T, typename Traits>
+detail::index_t ConcurrentObjectPool<T, Traits>::reserve_entries(T** entries, index_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pool_.reserve_entries(entries, count);
+}
+
+template <typename T, typename Traits>
+void ConcurrentObjectPool<T, Traits>::release_entries(T* const* entries, index_t count)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool_.release_entries(entries, count);
+}
+
+template <typename T, typename Traits>
+void ConcurrentObjectPool<T, Traits>::reclaim_memory()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool_.reclaim_memory();
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ConcurrentObjectPool<T, Traits>::for_each(const F func) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pool_.for_each(func);
+}
+
+template <typename T, typename Traits>
+ObjectPoolStats ConcurrentObjectPool<T, Traits>::calc_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ObjectPoolStats stats = pool_.calc_stats();
+    // entries held by thread caches are in use by the pool but not objects
+    stats.num_allocations = 0;
+    pool_.for_each([&stats](const T*)
+        {
+            ++stats.num_allocations;
+        });
+    return stats;
+}
+
+template <typename T, typename Traits>
+ThreadOwnedObjectPool<T, Traits>::ThreadOwnedObjectPool(index_t entries_per_block)
+    : pool_(static_cast<typename DynamicObjectPool<T, Traits>::index_t>(entries_per_block)),
+      owner_(std::this_thread::get_id()),
+      remote_head_(nullptr)
+{
+}
+
+template <typename T, typename Traits>
+ThreadOwnedObjectPool<T, Traits>::~ThreadOwnedObjectPool()
+{
+    collect();
+}
+
+template <typename T, typename Traits>
+void ThreadOwnedObjectPool<T, Traits>::take_ownership()
+{
+    owner_ = std::this_thread::get_id();
+}
+
+template <typename T, typename Traits>
+bool ThreadOwnedObjectPool<T, Traits>::is_owner() const
+{
+    return owner_ == std::this_thread::get_id();
+}
+
+template <typename T, typename Traits>
+T* ThreadOwnedObjectPool<T, Traits>::load_link(const T* ptr)
+{
+    // deleted entries may not be aligned for a pointer
+    T* next;
+    memcpy(&next, static_cast<const void*>(ptr), sizeof(next));
+    return next;
+}
+
+template <typename T, typename Traits>
+void ThreadOwnedObjectPool<T, Traits>::store_link(T* ptr, T* next)
+{
+    memcpy(static_cast<void*>(ptr), &next, sizeof(next));
+}
+
+template <typename T, typename Traits>
+template <class... P>
+T* ThreadOwnedObjectPool<T, Traits>::new_object(P&&... params)
+{
+    assert(is_owner());
+    if (remote_head_.load(std::memory_order_relaxed) != nullptr)
+    {
+        collect();
+    }
+    return pool_.new_object(std::forward<P>(params)...);
+}
+
+template <typename T, typename Traits>
+void ThreadOwnedObjectPool<T, Traits>::delete_object(const T* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (is_owner())
+    {
+        pool_.delete_object(ptr);
+        return;
+    }
+    // destruct here and leave the entry reserved for the owner to collect
+    pool_.destruct_reserved(ptr);
+    T* entry = const_cast<T*>(ptr);
+    T* head = remote_head_.load(std::memory_order_relaxed);
+    do
+    {
+        store_link(entry, head);
+    } while (!remote_head_.compare_exchange_weak(
+        head, entry, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <typename T, typename Traits>
+size_t ThreadOwnedObjectPool<T, Traits>::collect()
+{
+    assert(is_owner());
+    // take the whole list at once, so no other consumer can cause ABA
+    T* entry = remote_head_.exchange(nullptr, std::memory_order_acquire);
+    collected_.clear();
+    while (entry)
+    {
+        collected_.push_back(entry);
+        entry = load_link(entry);
+    }
+    if (!collected_.empty())
+    {
+        // sorting by address groups the entries by block, so each block's
+        // free list is updated once
+        std::sort(collected_.begin(), collected_.end());
+        pool_.release_entries(collected_.data(), static_cast<index_t>(collected_.size()));
+    }
+    return collected_.size();
+}
+
+template <typename T, typename Traits>
+void ThreadOwnedObjectPool<T, Traits>::delete_all()
+{
+    collect();
+    pool_.delete_all();
+}
+
+template <typename T, typename Traits>
+void ThreadOwnedObjectPool<T, Traits>::reclaim_memory()
+{
+    collect();
+    pool_.reclaim_memory();
+}
+
+template <typename T, typename Traits>
+typename ThreadOwnedObjectPool<T, Traits>::Handle ThreadOwnedObjectPool<T, Traits>::get_handle(
+    const T* ptr) const
+{
+    assert(is_owner());
+    return pool_.get_handle(ptr);
+}
+
+template <typename T, typename Traits>
+T* ThreadOwnedObjectPool<T, Traits>::get_object(Handle handle) const
+{
+    assert(is_owner());
+    return pool_.get_object(handle);
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ThreadOwnedObjectPool<T, Traits>::for_each(const F func) const
+{
+    assert(is_owner());
+    pool_.for_each(func);
+}
+
+template <typename T, typename Traits>
+ObjectPoolStats ThreadOwnedObjectPool<T, Traits>::calc_stats() const
+{
+    ObjectPoolStats stats = pool_.calc_stats();
+    // remotely deleted entries are in use by the pool until collected
+    stats.num_allocations = 0;
+    pool_.for_each([&stats](const T*)
+        {
+            ++stats.num_allocations;
+        });
+    return stats;
+}
+
+template <typename T, typename Traits>
+void ThreadOwnedObjectPool<T, Traits>::set_owner(void* owner)
+{
+    pool_.set_owner(owner);
+}
+
+template <typename T, typename Traits>
+void* ThreadOwnedObjectPool<T, Traits>::find_owner(const T* ptr)
+{
+    return DynamicObjectPool<T, Traits>::find_owner(ptr);
+}
+
+template <typename T>
+LockFreeFixedObjectPool<T>::LockFreeFixedObjectPool(index_t max_entries)
+    : free_head_(0), links_(nullptr), memory_(nullptr), max_entries_(max_entries)
+{
+    static_assert(sizeof(index_t) == 4, "free list head packs a 32 bit index and counter");
+    const size_t entry_align = alignof(T);
+    // links and entries share a single allocation
+    const size_t links_size = detail::align_to(sizeof(link_t) * max_entries, entry_align);
+    const size_t entries_size = sizeof(T) * max_entries;
+    if (uint8_t* ptr = reinterpret_cast<uint8_t*>(detail::aligned_malloc(
+            links_size + entries_size, std::max<size_t>(entry_align, detail::MIN_BLOCK_ALIGN))))
+    {
+        links_ = reinterpret_cast<link_t*>(ptr);
+        memory_ = reinterpret_cast<T*>(ptr + links_size);
+        for (index_t i = 0; i < max_entries; ++i)
+        {
+            new (links_ + i) link_t(0);
+        }
+        init_free_list();
+    }
+    else
+    {
+        // an empty free list, so new_object returns nullptr
+        free_head_.store(make_head(max_entries_, 0));
+    }
+}
+
+template <typename T>
+LockFreeFixedObjectPool<T>::~LockFreeFixedObjectPool()
+{
+    assert(calc_stats().num_allocations == 0);
+    detail::aligned_free(links_);
+}
+
+template <typename T>
+detail::index_t LockFreeFixedObjectPool<T>::head_index(uint64_t head)
+{
+    return static_cast<index_t>(head);
+}
+
+template <typename T>
+uint64_t LockFreeFixedObjectPool<T>::make_head(index_t index, uint64_t prev_head)
+{
+    // increment the counter in the high bits, letting it wrap
+    return ((prev_head >> 32) + 1) << 32 | index;
+}
+
+template <typename T>
+void LockFreeFixedObjectPool<T>::init_free_list()
+{
+    for (index_t i = 0; i < max_entries_; ++i)
+    {
+        links_[i].store(i + 1, std::memory_order_relaxed);
+    }
+    free_head_.store(make_head(0, free_head_.load()));
+}
+
+template <typename T>
+template <class... P>
+T* LockFreeFixedObjectPool<T>::new_object(P&&... params)
+{
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+    index_t index;
+    for (;;)
+    {
+        index = head_index(head);
+        if (index == max_entries_)
+        {
+            return nullptr;
+        }
+        // this link may be stale if another thread pops this entry first, in
+        // which case the counter will have changed and the exchange fails
+        const index_t next = links_[index].load(std::memory_order_relaxed);
+        if (free_head_.compare_exchange_weak(head, make_head(next, head),
+                std::memory_order_acquire, std::memory_order_acquire))
+        {
+            break;
+        }
+    }
+    // flag index as used by assigning it's own index
+    links_[index].store(index, std::memory_order_relaxed);
+    T* ptr = memory_ + index;
+    new (ptr) T(std::forward<P>(params)...);
+    return ptr;
+}
+
+template <typename T>
+void LockFreeFixedObjectPool<T>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        assert(ptr >= memory_ && ptr < memory_ + max_entries_);
+        const index_t index = static_cast<index_t>(ptr - memory_);
+        assert(links_[index].load(std::memory_order_relaxed) == index);
+        ptr->~T();
+        uint64_t head = free_head_.load(std::memory_order_relaxed);
+        do
+        {
+            links_[index].store(head_index(head), std::memory_order_relaxed);
+        } while (!free_head_.compare_exchange_weak(head, make_head(index, head),
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+}
+
+template <typename T>
+void LockFreeFixedObjectPool<T>::delete_all()
+{
+    if (!std::is_trivially_destructible<T>::value)
+    {
+        for_each([](T* ptr)
+            {
+                ptr->~T();
+            });
+    }
+    if (links_)
+    {
+        init_free_list();
+    }
+}
+
+template <typename T>
+template <typename F>
+void LockFreeFixedObjectPool<T>::for_each(const F func) const
+{
+    // nothing to visit if the constructor failed to allocate
+    const index_t num_entries = links_ ? max_entries_ : 0;
+    for (index_t i = 0; i != num_entries; ++i)
+    {
+        if (links_[i].load(std::memory_order_relaxed) == i)
+        {
+            func(memory_ + i);
+        }
+    }
+}
+
+template <typename T>
+ObjectPoolStats LockFreeFixedObjectPool<T>::calc_stats() const
+{
+    ObjectPoolStats stats;
+    stats.num_blocks = 1;
+    for_each([&stats](const T*)
+        {
+            ++stats.num_allocations;
+        });
+    return stats;
+}
+
+template <typename F>
+void ThreadPoolExecutor::run(size_t num_tasks, const F& task)
+{
+    run_tasks(num_tasks, Task(std::cref(task)));
+}
+
+#endif // _BITS_CONCURRENT_OBJECT_POOL_INL_
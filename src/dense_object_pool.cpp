@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#include "dense_object_pool.hpp"
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace tests
+{
+
+template <typename T>
+void denseNewAndDelete()
+{
+    typedef DenseObjectPool<T> PoolT;
+    typedef typename PoolT::Handle Handle;
+    PoolT pool(64);
+    CHECK(pool.get_object(Handle()) == nullptr);
+    std::vector<Handle> handles;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        handles.push_back(pool.new_object(i));
+        CHECK(pool.get_object(handles.back()) != nullptr);
+    }
+    CHECK(pool.get_object(pool.new_object(64u)) == nullptr);
+    CHECK(pool.calc_stats().failed_allocations == 1u);
+    CHECK(pool.size() == 64u);
+
+    // delete every other object, the rest stay packed at the start
+    for (uint32_t i = 0; i < 64; i += 2)
+    {
+        pool.delete_object(handles[i]);
+        CHECK(pool.get_object(handles[i]) == nullptr);
+    }
+    CHECK(pool.size() == 32u);
+    CHECK(pool.calc_stats().num_allocations == 32u);
+    for (uint32_t i = 1; i < 64; i += 2)
+    {
+        T* p = pool.get_object(handles[i]);
+        REQUIRE(p != nullptr);
+        CHECK(*p->value_ == i);
+        CHECK(p >= pool.data());
+        CHECK(p < pool.data() + pool.size());
+        CHECK(pool.get_object(pool.get_handle(p)) == p);
+    }
+    uint32_t sum = 0;
+    pool.for_each([&sum](const T* p)
+        {
+            sum += *p->value_;
+        });
+    CHECK(sum == 32u * 32u);
+
+    // freed slots are reused, but old handles stay stale
+    Handle h = pool.new_object(100u);
+    CHECK(h.index == handles[62].index);
+    CHECK(pool.get_object(handles[62]) == nullptr);
+    CHECK(*pool.get_object(h)->value_ == 100u);
+    CHECK(pool.get_object(h) == pool.data() + 32);
+
+    // deleting the last object needs no move
+    pool.delete_object(h);
+    CHECK(pool.size() == 32u);
+    pool.delete_all();
+    CHECK(pool.size() == 0u);
+    CHECK(pool.get_object(handles[1]) == nullptr);
+    CHECK(pool.calc_stats().num_allocations == 0u);
+    CHECK(pool.calc_stats().total_allocations == 65u);
+}
+
+/// Object owning heap memory, moved by its move constructor
+struct DenseOwned
+{
+    explicit DenseOwned(uint32_t value) : value_(new uint32_t(value)) {}
+    std::unique_ptr<uint32_t> value_;
+};
+
+TEST_CASE("DenseObjectPool new and delete", "[densepool]")
+{
+    denseNewAndDelete<DenseOwned>();
+}
+
+TEST_CASE("DenseObjectPool relocatable objects", "[densepool]")
+{
+    static_assert(ObjectPoolRelocatable<uint32_t>::value, "trivially copyable");
+    DenseObjectPool<uint32_t> pool(16);
+    std::vector<DenseObjectPool<uint32_t>::Handle> handles;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        handles.push_back(pool.new_object(i));
+    }
+    pool.delete_object(handles[0]);
+    pool.delete_object(handles[5]);
+    CHECK(pool.data()[0] == 15u);
+    CHECK(pool.data()[5] == 14u);
+    CHECK(*pool.get_object(handles[15]) == 15u);
+    CHECK(*pool.get_object(handles[14]) == 14u);
+    pool.delete_all();
+}
+
+/// Object aligned to a page
+struct alignas(4096) DensePage
+{
+    uint32_t value_;
+};
+
+TEST_CASE("DenseObjectPool over aligned objects", "[densepool]")
+{
+    DenseObjectPool<DensePage> pool(4);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        DensePage page;
+        page.value_ = i;
+        pool.new_object(page);
+    }
+    CHECK((reinterpret_cast<uintptr_t>(pool.data()) % alignof(DensePage)) == 0u);
+    CHECK(pool.data()[3].value_ == 3u);
+    pool.delete_all();
+}
+
+} // namespace tests
+
+#endif // UNIT_TESTS
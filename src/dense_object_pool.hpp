@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef _BITS_DENSE_OBJECT_POOL_HPP_
+#define _BITS_DENSE_OBJECT_POOL_HPP_
+
+#include "object_pool.hpp"
+
+/// DenseObjectPool is a fixed size pool which keeps its live objects packed
+/// at the start of a single array, so for_each visits them at full memory
+/// bandwidth without occupancy checks.
+///
+/// Deleting an object moves the last object into its place (swap and pop),
+/// so object addresses are not stable. Objects are instead identified by
+/// handles to slots in a sparse table, which maps each slot to the object's
+/// current position. Pointers from get_object and for_each are only valid
+/// until the next delete. Objects are moved with memcpy if
+/// ObjectPoolRelocatable, otherwise move constructed.
+template <typename T>
+class DenseObjectPool
+{
+public:
+    typedef detail::index_t index_t;
+    typedef T value_t;
+    typedef ObjectPoolHandle Handle;
+
+    DenseObjectPool(index_t max_entries);
+    ~DenseObjectPool();
+
+    /// Constructs a new object at the end of the live objects, returning a
+    /// handle to it, or a default constructed handle if there is no
+    /// available space.
+    template <class... P>
+    Handle new_object(P&&... params);
+
+    /// Deletes the object referred to by the handle, which must be live,
+    /// moving the last object into its place.
+    void delete_object(Handle handle);
+
+    /// Delete all current allocations
+    void delete_all();
+
+    /// Returns the object referred to by the handle, or nullptr if the object
+    /// has since been deleted. The pointer is invalidated by the next delete.
+    T* get_object(Handle handle) const;
+
+    /// Returns a handle to the given live object
+    Handle get_handle(const T* ptr) const;
+
+    /// Returns the live objects, which are contiguous
+    T* data() const;
+
+    /// Returns the number of live objects
+    index_t size() const;
+
+    /// Calls the given function for all live objects in order
+    template <typename F>
+    void for_each(const F func) const;
+
+    /// Returns object pool stats in constant time
+    ObjectPoolStats calc_stats() const;
+
+private:
+    typedef std::integral_constant<bool, ObjectPoolRelocatable<T>::value> relocatable_t;
+
+    /// Sparse table entry for a stable object identifier
+    struct Slot
+    {
+        /// position of the object if live, otherwise the next free slot
+        index_t dense_;
+        /// incremented when the slot's object is deleted
+        detail::generation_t generation_;
+    };
+
+    /// Returns the size of the single allocation holding everything
+    static size_t alloc_size(index_t max_entries);
+
+    /// Returns the slot index of a handle if it refers to a live object,
+    /// otherwise max_entries_.
+    index_t live_slot(Handle handle) const;
+
+    /// Moves the object at src to uninitialised memory at dst
+    static void relocate(T* dst, T* src, std::true_type);
+    static void relocate(T* dst, T* src, std::false_type);
+
+    /// Links every slot into the free list
+    void init_free_list();
+
+    /// live objects, then unconstructed storage
+    T* objects_;
+    /// slot of the object at each position
+    index_t* dense_to_slot_;
+    /// sparse slot table
+    Slot* slots_;
+    /// first free slot, max_entries_ if full
+    index_t free_head_;
+    /// number of live objects
+    index_t size_;
+    const index_t max_entries_;
+    detail::PoolCounters counters_;
+
+    DenseObjectPool(const DenseObjectPool&) = delete;
+    DenseObjectPool& operator=(const DenseObjectPool&) = delete;
+};
+
+#include "dense_object_pool.inl"
+
+#endif // _BITS_DENSE_OBJECT_POOL_HPP_
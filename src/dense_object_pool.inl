@@ -0,0 +1,206 @@
+// Header guards an include is for code completion in IDEs
+// Don't include this file directly!
+#ifndef _BITS_DENSE_OBJECT_POOL_INL_
+#define _BITS_DENSE_OBJECT_POOL_INL_
+
+#ifndef _BITS_DENSE_OBJECT_POOL_HPP_
+#include "dense_object_pool.hpp"
+#endif
+
+template <typename T>
+size_t DenseObjectPool<T>::alloc_size(index_t max_entries)
+{
+    return detail::align_to(sizeof(T) * max_entries, alignof(Slot)) +
+           sizeof(Slot) * max_entries + sizeof(index_t) * max_entries;
+}
+
+template <typename T>
+DenseObjectPool<T>::DenseObjectPool(index_t max_entries)
+    : objects_(nullptr),
+      dense_to_slot_(nullptr),
+      slots_(nullptr),
+      free_head_(max_entries),
+      size_(0),
+      max_entries_(max_entries)
+{
+    // objects, slots and positions share a single allocation
+    if (uint8_t* ptr = reinterpret_cast<uint8_t*>(detail::aligned_malloc(
+            std::max<size_t>(alloc_size(max_entries), 1),
+            std::max<size_t>(detail::MIN_BLOCK_ALIGN, alignof(T)))))
+    {
+        objects_ = reinterpret_cast<T*>(ptr);
+        slots_ = reinterpret_cast<Slot*>(
+            ptr + detail::align_to(sizeof(T) * max_entries, alignof(Slot)));
+        dense_to_slot_ = reinterpret_cast<index_t*>(slots_ + max_entries);
+        for (index_t i = 0; i != max_entries; ++i)
+        {
+            slots_[i].generation_ = 0;
+        }
+        init_free_list();
+    }
+}
+
+template <typename T>
+DenseObjectPool<T>::~DenseObjectPool()
+{
+    assert(size_ == 0);
+    detail::aligned_free(objects_);
+}
+
+template <typename T>
+void DenseObjectPool<T>::init_free_list()
+{
+    for (index_t i = 0; i != max_entries_; ++i)
+    {
+        slots_[i].dense_ = i + 1;
+    }
+    free_head_ = objects_ ? 0 : max_entries_;
+}
+
+template <typename T>
+void DenseObjectPool<T>::relocate(T* dst, T* src, std::true_type)
+{
+    std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), sizeof(T));
+}
+
+template <typename T>
+void DenseObjectPool<T>::relocate(T* dst, T* src, std::false_type)
+{
+    new (dst) T(std::move(*src));
+    src->~T();
+}
+
+template <typename T>
+template <class... P>
+ObjectPoolHandle DenseObjectPool<T>::new_object(P&&... params)
+{
+    const index_t slot = free_head_;
+    if (slot == max_entries_)
+    {
+        counters_.failed(1);
+        return Handle();
+    }
+    // append the object and point its slot at it
+    free_head_ = slots_[slot].dense_;
+    const index_t dense = size_++;
+    slots_[slot].dense_ = dense;
+    dense_to_slot_[dense] = slot;
+    new (objects_ + dense) T(std::forward<P>(params)...);
+    counters_.allocated(1);
+
+    Handle handle;
+    handle.block = 0;
+    handle.index = slot;
+    handle.generation = slots_[slot].generation_;
+    return handle;
+}
+
+template <typename T>
+void DenseObjectPool<T>::delete_object(Handle handle)
+{
+    const index_t slot = live_slot(handle);
+    assert(slot != max_entries_);
+    const index_t dense = slots_[slot].dense_;
+    const index_t last = --size_;
+    objects_[dense].~T();
+    if (dense != last)
+    {
+        // fill the hole with the last object
+        relocate(objects_ + dense, objects_ + last, relocatable_t());
+        const index_t moved_slot = dense_to_slot_[last];
+        dense_to_slot_[dense] = moved_slot;
+        slots_[moved_slot].dense_ = dense;
+    }
+    // invalidate handles and free the slot
+    ++slots_[slot].generation_;
+    slots_[slot].dense_ = free_head_;
+    free_head_ = slot;
+    counters_.freed(1);
+}
+
+template <typename T>
+void DenseObjectPool<T>::delete_all()
+{
+    for (index_t dense = 0; dense != size_; ++dense)
+    {
+        objects_[dense].~T();
+        ++slots_[dense_to_slot_[dense]].generation_;
+    }
+    size_ = 0;
+    init_free_list();
+    counters_.freed(counters_.num_allocations);
+}
+
+template <typename T>
+detail::index_t DenseObjectPool<T>::live_slot(Handle handle) const
+{
+    if (handle.block == 0 && handle.index < max_entries_)
+    {
+        const Slot& slot = slots_[handle.index];
+        if (slot.generation_ == handle.generation && slot.dense_ < size_ &&
+            dense_to_slot_[slot.dense_] == handle.index)
+        {
+            return handle.index;
+        }
+    }
+    return max_entries_;
+}
+
+template <typename T>
+T* DenseObjectPool<T>::get_object(Handle handle) const
+{
+    const index_t slot = live_slot(handle);
+    return slot != max_entries_ ? objects_ + slots_[slot].dense_ : nullptr;
+}
+
+template <typename T>
+ObjectPoolHandle DenseObjectPool<T>::get_handle(const T* ptr) const
+{
+    assert(ptr >= objects_ && ptr < objects_ + size_);
+    const index_t slot = dense_to_slot_[ptr - objects_];
+    Handle handle;
+    handle.block = 0;
+    handle.index = slot;
+    handle.generation = slots_[slot].generation_;
+    return handle;
+}
+
+template <typename T>
+T* DenseObjectPool<T>::data() const
+{
+    return objects_;
+}
+
+template <typename T>
+detail::index_t DenseObjectPool<T>::size() const
+{
+    return size_;
+}
+
+template <typename T>
+template <typename F>
+void DenseObjectPool<T>::for_each(const F func) const
+{
+    for (T *ptr = objects_, *end = objects_ + size_; ptr != end; ++ptr)
+    {
+        func(ptr);
+    }
+}
+
+template <typename T>
+ObjectPoolStats DenseObjectPool<T>::calc_stats() const
+{
+    ObjectPoolStats stats;
+    stats.num_blocks = 1;
+    stats.peak_blocks = 1;
+    stats.bytes_reserved = alloc_size(max_entries_);
+    stats.bytes_metadata = alloc_size(max_entries_) - sizeof(T) * max_entries_;
+    stats.num_allocations = counters_.num_allocations;
+    stats.high_water_mark = counters_.high_water_mark;
+    stats.total_allocations = counters_.total_allocations;
+    stats.total_frees = counters_.total_frees;
+    stats.failed_allocations = counters_.failed_allocations;
+    return stats;
+}
+
+#endif // _BITS_DENSE_OBJECT_POOL_INL_
@@ -20,10 +20,40 @@
 #include "object_pool.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
 #include <limits>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OBJECT_POOL_X86_64 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define OBJECT_POOL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OBJECT_POOL_TARGET_AVX2
+#endif
 
 namespace detail
 {
@@ -48,303 +78,2319 @@ void aligned_free(void* ptr)
 #endif
 }
 
-/// Returns true if the pointer is of the given alignment
-inline bool is_aligned_to(const void* ptr, size_t align)
+void* huge_page_malloc(size_t size, size_t align)
 {
-    return (reinterpret_cast<uintptr_t>(ptr) & (align - 1)) == 0;
+#if defined(__linux__)
+    size = align_to(size, HUGE_PAGE_SIZE);
+    void* ptr = virtual_alloc(size, std::max(align, HUGE_PAGE_SIZE));
+    if (ptr)
+    {
+        virtual_advise_huge_pages(ptr, size);
+    }
+    return ptr;
+#else
+    return aligned_malloc(size, align);
+#endif
 }
 
-} // namespace detail
-
-
-//
-// Tests
-//
-
-#if UNIT_TESTS
-
-#include "catch.hpp"
+void huge_page_free(void* ptr, size_t size)
+{
+#if defined(__linux__)
+    virtual_free(ptr, align_to(size, HUGE_PAGE_SIZE));
+#else
+    (void)size;
+    aligned_free(ptr);
+#endif
+}
 
-namespace tests
+void virtual_advise_huge_pages(void* ptr, size_t size)
 {
+#if defined(MADV_HUGEPAGE)
+    madvise(ptr, size, MADV_HUGEPAGE);
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
 
-using detail::is_aligned_to;
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_get_mempolicy)
+#define OBJECT_POOL_NUMA 1
+/// Number of bits in node masks passed to the kernel
+const unsigned long NUMA_MASK_BITS = 1024;
+const unsigned long NUMA_MASK_WORD_BITS = sizeof(unsigned long) * 8;
+#endif
 
-template <typename PoolT>
-void singleNewAndDelete(PoolT& mp)
+int numa_num_nodes()
 {
-    uint32_t* p = mp.new_object(0xaabbccdd);
-    REQUIRE(p != nullptr);
-    CHECK(is_aligned_to(p, 4));
-    // should be aligned to the cache line size
-    // CHECK(is_aligned_to(p, MIN_BLOCK_ALIGN));
-    CHECK(*p == 0xaabbccdd);
-    mp.delete_object(p);
+#if OBJECT_POOL_NUMA
+    static const int num_nodes = []
+        {
+            unsigned long mask[NUMA_MASK_BITS / NUMA_MASK_WORD_BITS] = {};
+            if (syscall(SYS_get_mempolicy, nullptr, mask, NUMA_MASK_BITS, nullptr,
+                    MPOL_F_MEMS_ALLOWED) != 0)
+            {
+                return 1;
+            }
+            int highest = 0;
+            for (unsigned long node = 0; node != NUMA_MASK_BITS; ++node)
+            {
+                if (mask[node / NUMA_MASK_WORD_BITS] & (1ul << (node % NUMA_MASK_WORD_BITS)))
+                {
+                    highest = static_cast<int>(node);
+                }
+            }
+            return highest + 1;
+        }();
+    return num_nodes;
+#else
+    return 1;
+#endif
 }
 
-template <typename PoolT>
-void doubleNewAndDelete(PoolT& mp)
+int numa_current_node()
 {
-    uint32_t* p1 = mp.new_object(0x11223344);
-    REQUIRE(p1 != nullptr);
-    CHECK(is_aligned_to(p1, 4));
-    uint32_t* p2 = mp.new_object(0x55667788);
-    REQUIRE(p2 != nullptr);
-    CHECK(is_aligned_to(p2, 4));
-    CHECK(p2 == p1 + 1);
-    CHECK(*p1 == 0x11223344);
-    mp.delete_object(p1);
-    CHECK(*p2 == 0x55667788);
-    mp.delete_object(p2);
+#if OBJECT_POOL_NUMA && defined(SYS_getcpu)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    {
+        return static_cast<int>(node);
+    }
+#endif
+    return 0;
 }
 
-template <typename PoolT>
-void blockFillAndFree(PoolT& mp, size_t size)
+bool numa_bind(void* ptr, size_t size, int node)
 {
-    std::vector<uint32_t*> v;
-    for (size_t i = 0; i < size; ++i)
+#if OBJECT_POOL_NUMA
+    if (node < 0 || static_cast<unsigned long>(node) >= NUMA_MASK_BITS)
     {
-        uint32_t* p = mp.new_object(1 << i);
-        REQUIRE(p != nullptr);
-        CHECK(*p == 1u << i);
-        v.push_back(p);
+        return false;
+    }
+    // mbind works on whole pages
+    const uintptr_t page_size = virtual_page_size();
+    const uintptr_t begin =
+        (reinterpret_cast<uintptr_t>(ptr) + page_size - 1) & ~(page_size - 1);
+    const uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(page_size - 1);
+    if (begin >= end)
+    {
+        return false;
     }
+    unsigned long mask[NUMA_MASK_BITS / NUMA_MASK_WORD_BITS] = {};
+    mask[node / NUMA_MASK_WORD_BITS] = 1ul << (node % NUMA_MASK_WORD_BITS);
+    return syscall(SYS_mbind, begin, end - begin, MPOL_PREFERRED, mask, NUMA_MASK_BITS,
+               MPOL_MF_MOVE)
+        == 0;
+#else
+    (void)ptr;
+    (void)size;
+    (void)node;
+    return false;
+#endif
+}
 
-    for (size_t i = 0; i < size; ++i)
+int numa_node_of(const void* ptr)
+{
+#if OBJECT_POOL_NUMA
+    int node = 0;
+    if (syscall(SYS_get_mempolicy, &node, nullptr, 0, ptr, MPOL_F_NODE | MPOL_F_ADDR) == 0)
     {
-        mp.delete_object(v[i]);
+        return node;
     }
+#else
+    (void)ptr;
+#endif
+    return 0;
 }
 
-template <typename PoolT>
-void iterateFullBlocks(PoolT& mp, const size_t size, const size_t expected_blocks)
+void virtual_discard(void* ptr, size_t size, bool lazy)
 {
-    const size_t half_size = size >> 1;
-    std::vector<uint32_t*> v;
-    size_t i;
-    for (i = 0; i < size; ++i)
+#if defined(_WIN32)
+    (void)lazy;
+    VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE);
+#else
+#if defined(MADV_FREE)
+    if (lazy && madvise(ptr, size, MADV_FREE) == 0)
     {
-        uint32_t* p = mp.new_object(1 << i);
-        REQUIRE(p != nullptr);
-        CHECK(*p == 1u << i);
-        v.push_back(p);
+        return;
     }
+#else
+    (void)lazy;
+#endif
+    madvise(ptr, size, MADV_DONTNEED);
+#endif
+}
+
+size_t virtual_page_size()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page_size;
+#endif
+}
+
+void* virtual_reserve(size_t size)
+{
+#if defined(_WIN32)
+    return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    void* ptr = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return ptr != MAP_FAILED ? ptr : nullptr;
+#endif
+}
+
+void virtual_release(void* ptr, size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
 
+void* virtual_alloc(size_t size, size_t align)
+{
+    const size_t page_size = virtual_page_size();
+    size = align_to(size, page_size);
+    align = std::max(align, page_size);
+#if defined(_WIN32)
+    return aligned_malloc(size, align);
+#else
+    // over-allocate then unmap the unaligned head and tail
+    const size_t map_size = size + align - page_size;
+    void* map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == size);
-        CHECK(stats.num_blocks == expected_blocks);
+        return nullptr;
+    }
+    uint8_t* map_begin = static_cast<uint8_t*>(map);
+    uint8_t* ptr = reinterpret_cast<uint8_t*>(
+        align_to(reinterpret_cast<uintptr_t>(map_begin), align));
+    if (ptr != map_begin)
+    {
+        munmap(map_begin, static_cast<size_t>(ptr - map_begin));
+    }
+    const size_t tail_size = static_cast<size_t>(map_begin + map_size - (ptr + size));
+    if (tail_size != 0)
+    {
+        munmap(ptr + size, tail_size);
     }
+    return ptr;
+#endif
+}
 
-    // check values
-    i = 0;
-    for (auto itr = v.begin(), end = v.end(); itr != end; ++itr)
+void virtual_free(void* ptr, size_t size)
+{
+#if defined(_WIN32)
+    (void)size;
+    aligned_free(ptr);
+#else
+    munmap(ptr, align_to(size, virtual_page_size()));
+#endif
+}
+
+bool virtual_commit(void* ptr, size_t size)
+{
+#if defined(_WIN32)
+    return VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+#else
+    return mprotect(ptr, size, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+void virtual_decommit(void* ptr, size_t size)
+{
+#if defined(_WIN32)
+    VirtualFree(ptr, size, MEM_DECOMMIT);
+#else
+    // MADV_DONTNEED drops the pages so recommitting gives zeroed memory
+    madvise(ptr, size, MADV_DONTNEED);
+    mprotect(ptr, size, PROT_NONE);
+#endif
+}
+
+/// Returns true if the pointer is of the given alignment
+inline bool is_aligned_to(const void* ptr, size_t align)
+{
+    return (reinterpret_cast<uintptr_t>(ptr) & (align - 1)) == 0;
+}
+
+namespace
+{
+
+const uintptr_t BLOCK_MAP_EMPTY = 0;
+const uintptr_t BLOCK_MAP_ERASED = 1;
+const size_t BLOCK_MAP_MIN_SLOTS = 64;
+
+/// Open addressing hash set of registered blocks. Each key is a block start
+/// with the log2 of its alignment in the low bits, which are zero as blocks
+/// are aligned to at least MIN_BLOCK_ALIGN.
+///
+/// Lookups take no lock. Writers hold the mutex and make the sequence count
+/// odd while changing slots, and readers retry if it changed under them.
+/// Tables outgrown by the set are kept rather than freed, as a reader may
+/// still be probing them, so they never total more than the current table.
+struct BlockMap
+{
+    std::mutex mutex;
+    std::atomic<uint32_t> sequence;
+    std::atomic<std::atomic<uintptr_t>*> slots;
+    std::atomic<size_t> mask;
+    /// Bit k is set while any block aligned to 2^k is registered
+    std::atomic<uint64_t> aligns;
+    size_t num_aligned[64];
+    /// Slots which are not empty, including erased ones
+    size_t num_used;
+    size_t num_live;
+    std::vector<std::unique_ptr<std::atomic<uintptr_t>[]> > tables;
+
+    BlockMap() : sequence(0), slots(nullptr), mask(0), aligns(0), num_used(0), num_live(0)
     {
-        CHECK(**itr == 1u << i);
-        ++i;
+        std::fill(num_aligned, num_aligned + 64, size_t(0));
     }
 
-    // delete every second entry
-    for (i = 1; i < size; i += 2)
+    static size_t hash(uintptr_t key)
     {
-        uint32_t* p = v[i];
-        v[i] = nullptr;
-        mp.delete_object(p);
+        return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ull) >> 32);
     }
 
-    // check allocation count is reduced but block count is the same
+    static uintptr_t make_key(const void* block, uint32_t align_log2)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == half_size);
-        CHECK(stats.num_blocks == expected_blocks);
+        return reinterpret_cast<uintptr_t>(block) | align_log2;
     }
 
-    // check remaining objects
-    i = 0;
-    mp.for_each([&i](const uint32_t* itr)
-        {
-            CHECK(*itr == 1u << i);
-            i += 2;
-        });
-    /*
-       for (i = 0; i < size; i += 2)
-       {
-       CHECK(*v[i] == 1u << i);
-       }
-       */
+    /// Starts and ends a change readers must not see half done
+    void begin_write()
+    {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
 
-    // allocate 16 new entries (fill first block)
-    for (i = 1; i < half_size; i += 2)
+    void end_write()
     {
-        CHECK(v[i] == nullptr);
-        v[i] = mp.new_object(1 << i);
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
     }
 
-    // check allocation and block count
+    /// Stores a key in the first empty or erased slot of its probe sequence
+    static bool place(std::atomic<uintptr_t>* table, size_t table_mask, uintptr_t key)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == size - (half_size >> 1));
-        CHECK(stats.num_blocks == expected_blocks);
+        for (size_t i = hash(key) & table_mask;; i = (i + 1) & table_mask)
+        {
+            const uintptr_t slot = table[i].load(std::memory_order_relaxed);
+            if (slot == BLOCK_MAP_EMPTY || slot == BLOCK_MAP_ERASED)
+            {
+                table[i].store(key, std::memory_order_relaxed);
+                return slot == BLOCK_MAP_EMPTY;
+            }
+        }
     }
 
-    // delete objects in second block
-    for (i = half_size; i < size; ++i)
+    /// Moves the live keys to a table with room for twice as many, or
+    /// rehashes in place to drop erased slots if the live keys are few
+    bool rehash()
     {
-        uint32_t* p = v[i];
-        v[i] = nullptr;
-        mp.delete_object(p);
+        std::atomic<uintptr_t>* old_slots = slots.load(std::memory_order_relaxed);
+        const size_t old_size = old_slots ? mask.load(std::memory_order_relaxed) + 1 : 0;
+        const size_t size =
+            std::max(old_size, std::max(BLOCK_MAP_MIN_SLOTS, next_pow2((num_live + 1) * 4)));
+        std::vector<uintptr_t> keys;
+        keys.reserve(num_live);
+        for (size_t i = 0; i != old_size; ++i)
+        {
+            const uintptr_t slot = old_slots[i].load(std::memory_order_relaxed);
+            if (slot != BLOCK_MAP_EMPTY && slot != BLOCK_MAP_ERASED)
+            {
+                keys.push_back(slot);
+            }
+        }
+        std::atomic<uintptr_t>* new_slots = old_slots;
+        if (size > old_size)
+        {
+            new_slots = new (std::nothrow) std::atomic<uintptr_t>[size];
+            if (!new_slots)
+            {
+                return false;
+            }
+            tables.emplace_back(new_slots);
+        }
+        begin_write();
+        for (size_t i = 0; i != size; ++i)
+        {
+            new_slots[i].store(BLOCK_MAP_EMPTY, std::memory_order_relaxed);
+        }
+        for (uintptr_t key : keys)
+        {
+            place(new_slots, size - 1, key);
+        }
+        slots.store(new_slots, std::memory_order_relaxed);
+        mask.store(size - 1, std::memory_order_relaxed);
+        num_used = keys.size();
+        end_write();
+        return true;
     }
 
-    // check that the empty block was freed
+    bool insert(const void* block, uint32_t align_log2)
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == half_size);
-        CHECK(stats.num_blocks == expected_blocks);
+        std::lock_guard<std::mutex> lock(mutex);
+        // keep at least half the slots empty so misses end quickly
+        const size_t size = slots.load(std::memory_order_relaxed)
+            ? mask.load(std::memory_order_relaxed) + 1
+            : 0;
+        if ((num_used + 1) * 2 > size && !rehash() && num_used == size)
+        {
+            return false;
+        }
+        begin_write();
+        num_used += place(slots.load(std::memory_order_relaxed),
+            mask.load(std::memory_order_relaxed), make_key(block, align_log2));
+        ++num_live;
+        if (num_aligned[align_log2]++ == 0)
+        {
+            aligns.fetch_or(uint64_t(1) << align_log2, std::memory_order_relaxed);
+        }
+        end_write();
+        return true;
     }
 
-    for (auto p : v)
+    void erase(const void* block, uint32_t align_log2)
     {
-        mp.delete_object(p);
+        std::lock_guard<std::mutex> lock(mutex);
+        std::atomic<uintptr_t>* table = slots.load(std::memory_order_relaxed);
+        const size_t table_mask = mask.load(std::memory_order_relaxed);
+        const uintptr_t key = make_key(block, align_log2);
+        size_t i = hash(key) & table_mask;
+        while (table[i].load(std::memory_order_relaxed) != key)
+        {
+            i = (i + 1) & table_mask;
+        }
+        begin_write();
+        table[i].store(BLOCK_MAP_ERASED, std::memory_order_relaxed);
+        --num_live;
+        if (--num_aligned[align_log2] == 0)
+        {
+            aligns.fetch_and(~(uint64_t(1) << align_log2), std::memory_order_relaxed);
+        }
+        end_write();
     }
 
+    /// Returns the log2 alignment of the smallest registered block whose
+    /// aligned range contains ptr, or 0 if there is none. A larger block's
+    /// range can only contain ptr past the block's end.
+    uint32_t find(const void* ptr) const
     {
-        auto stats = mp.calc_stats();
-        CHECK(stats.num_allocations == 0u);
-        CHECK(stats.num_blocks == expected_blocks);
+        for (;;)
+        {
+            const uint32_t begin = sequence.load(std::memory_order_acquire);
+            uint32_t found = 0;
+            std::atomic<uintptr_t>* table = slots.load(std::memory_order_relaxed);
+            const size_t table_mask = mask.load(std::memory_order_relaxed);
+            for (uint64_t bits = aligns.load(std::memory_order_relaxed); table && bits && !found;
+                 bits &= bits - 1)
+            {
+                const uint32_t align_log2 = count_trailing_zeros(bits);
+                const uintptr_t block =
+                    reinterpret_cast<uintptr_t>(ptr) & ~((uintptr_t(1) << align_log2) - 1);
+                const uintptr_t key = block | align_log2;
+                for (size_t i = hash(key) & table_mask;; i = (i + 1) & table_mask)
+                {
+                    const uintptr_t slot = table[i].load(std::memory_order_relaxed);
+                    if (slot == key)
+                    {
+                        found = align_log2;
+                        break;
+                    }
+                    if (slot == BLOCK_MAP_EMPTY)
+                    {
+                        break;
+                    }
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint32_t end = sequence.load(std::memory_order_relaxed);
+            if (begin == end && (begin & 1) == 0)
+            {
+                return found;
+            }
+        }
     }
-}
+};
 
-TEST_CASE("FixedObjectPool single new and delete", "[fixedpool]")
+/// Never destroyed so pools with static storage duration can still use it
+BlockMap& block_map()
 {
-    FixedObjectPool<uint32_t> mp(64);
-    singleNewAndDelete(mp);
+    static BlockMap* map = new BlockMap();
+    return *map;
 }
 
-TEST_CASE("DynamicObjectPool single new and delete", "[dynamicpool]")
+} // namespace
+
+bool register_block(const void* block, size_t align)
 {
-    DynamicObjectPool<uint32_t> mp(64);
-    singleNewAndDelete(mp);
+    assert(align >= MIN_BLOCK_ALIGN && (align & (align - 1)) == 0);
+    assert(is_aligned_to(block, align));
+    return block_map().insert(block, count_trailing_zeros(align));
 }
 
-TEST_CASE("FixedObjectPool double new and delete", "[fixedpool]")
+void unregister_block(const void* block, size_t align)
 {
-    FixedObjectPool<uint32_t> mp(64);
-    doubleNewAndDelete(mp);
+    block_map().erase(block, count_trailing_zeros(align));
 }
 
-TEST_CASE("Dynamic pool double new and delete", "[dynamicpool]")
+size_t find_block_align(const void* ptr)
 {
-    DynamicObjectPool<uint32_t> mp(64);
-    doubleNewAndDelete(mp);
+    const uint32_t align_log2 = block_map().find(ptr);
+    return align_log2 ? size_t(1) << align_log2 : 0;
 }
 
-TEST_CASE("FixedObjectPool block fill and free", "[fixedpool]")
+namespace
 {
-    FixedObjectPool<uint32_t> mp(64);
-    blockFillAndFree(mp, 64);
-}
 
-TEST_CASE("DynamicObjectPool block fill and free", "[dynamicpool]")
+/// Compares a single index at a time
+template <typename I>
+void scan_occupancy_scalar(const I* indices, size_t first, size_t count, bitmap_word_t* words)
 {
-    DynamicObjectPool<uint32_t> mp(64);
-    blockFillAndFree(mp, 64);
+    for (size_t i = 0; i < count; i += 64)
+    {
+        const size_t word_count = std::min<size_t>(64, count - i);
+        bitmap_word_t word = 0;
+        for (size_t j = 0; j < word_count; ++j)
+        {
+            const size_t index = first + i + j;
+            word |= bitmap_word_t(indices[index] == index) << j;
+        }
+        words[i / 64] = word;
+    }
 }
 
-TEST_CASE("DynamicObjectPool double block fill and free", "[dynamicpool]")
+#if OBJECT_POOL_X86_64
+
+/// Compares 4 indices at a time, SSE2 is always available on x86-64
+void scan_occupancy_sse2(
+    const uint32_t* indices, size_t first, size_t count, bitmap_word_t* words)
 {
-    DynamicObjectPool<uint32_t> mp(64);
-    blockFillAndFree(mp, 128);
+    const __m128i step = _mm_set1_epi32(4);
+    __m128i iota = _mm_setr_epi32(static_cast<int>(first), static_cast<int>(first + 1),
+        static_cast<int>(first + 2), static_cast<int>(first + 3));
+    size_t i = 0;
+    for (; i + 64 <= count; i += 64)
+    {
+        bitmap_word_t word = 0;
+        for (size_t j = 0; j < 64; j += 4)
+        {
+            const __m128i v =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + first + i + j));
+            const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, iota)));
+            word |= static_cast<bitmap_word_t>(mask) << j;
+            iota = _mm_add_epi32(iota, step);
+        }
+        words[i / 64] = word;
+    }
+    if (i < count)
+    {
+        scan_occupancy_scalar(indices, first + i, count - i, words + i / 64);
+    }
 }
 
-TEST_CASE("DynamicObjectPool delete all", "[dynamicpool")
+/// Compares 16 byte indices at a time. Byte indices only address blocks of
+/// up to 255 entries so the iota never wraps.
+void scan_occupancy_sse2(
+    const uint8_t* indices, size_t first, size_t count, bitmap_word_t* words)
 {
-    std::vector<uint32_t*> v(128, nullptr);
+    const __m128i step = _mm_set1_epi8(16);
+    __m128i iota = _mm_add_epi8(_mm_set1_epi8(static_cast<char>(first)),
+        _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    size_t i = 0;
+    for (; i + 64 <= count; i += 64)
+    {
+        bitmap_word_t word = 0;
+        for (size_t j = 0; j < 64; j += 16)
+        {
+            const __m128i v =
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + first + i + j));
+            const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, iota));
+            word |= static_cast<bitmap_word_t>(mask) << j;
+            iota = _mm_add_epi8(iota, step);
+        }
+        words[i / 64] = word;
+    }
+    if (i < count)
+    {
+        scan_occupancy_scalar(indices, first + i, count - i, words + i / 64);
+    }
+}
+
+/// Compares 16 indices at a time in two 8 wide compares, packing the results
+/// to bytes for a single movemask
+void scan_occupancy_sse2(
+    const uint16_t* indices, size_t first, size_t count, bitmap_word_t* words)
+{
+    const __m128i step = _mm_set1_epi16(16);
+    __m128i iota_lo = _mm_add_epi16(_mm_set1_epi16(static_cast<short>(first)),
+        _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+    __m128i iota_hi = _mm_add_epi16(iota_lo, _mm_set1_epi16(8));
+    size_t i = 0;
+    for (; i + 64 <= count; i += 64)
+    {
+        bitmap_word_t word = 0;
+        for (size_t j = 0; j < 64; j += 16)
+        {
+            const uint16_t* p = indices + first + i + j;
+            const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 8));
+            const __m128i eq =
+                _mm_packs_epi16(_mm_cmpeq_epi16(lo, iota_lo), _mm_cmpeq_epi16(hi, iota_hi));
+            word |= static_cast<bitmap_word_t>(_mm_movemask_epi8(eq)) << j;
+            iota_lo = _mm_add_epi16(iota_lo, step);
+            iota_hi = _mm_add_epi16(iota_hi, step);
+        }
+        words[i / 64] = word;
+    }
+    if (i < count)
+    {
+        scan_occupancy_scalar(indices, first + i, count - i, words + i / 64);
+    }
+}
+
+/// Compares 16 indices at a time in two 8 wide compares
+OBJECT_POOL_TARGET_AVX2
+void scan_occupancy_avx2(
+    const uint32_t* indices, size_t first, size_t count, bitmap_word_t* words)
+{
+    const __m256i step = _mm256_set1_epi32(16);
+    __m256i iota_lo = _mm256_setr_epi32(static_cast<int>(first), static_cast<int>(first + 1),
+        static_cast<int>(first + 2), static_cast<int>(first + 3), static_cast<int>(first + 4),
+        static_cast<int>(first + 5), static_cast<int>(first + 6), static_cast<int>(first + 7));
+    __m256i iota_hi = _mm256_add_epi32(iota_lo, _mm256_set1_epi32(8));
+    size_t i = 0;
+    for (; i + 64 <= count; i += 64)
+    {
+        bitmap_word_t word = 0;
+        for (size_t j = 0; j < 64; j += 16)
+        {
+            const uint32_t* p = indices + first + i + j;
+            const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 8));
+            const int mask_lo =
+                _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(lo, iota_lo)));
+            const int mask_hi =
+                _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(hi, iota_hi)));
+            word |= static_cast<bitmap_word_t>(mask_lo | (mask_hi << 8)) << j;
+            iota_lo = _mm256_add_epi32(iota_lo, step);
+            iota_hi = _mm256_add_epi32(iota_hi, step);
+        }
+        words[i / 64] = word;
+    }
+    if (i < count)
+    {
+        scan_occupancy_scalar(indices, first + i, count - i, words + i / 64);
+    }
+}
+
+/// Checks CPUID for AVX2 support, including OS support for saving YMM state
+bool cpu_supports_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // OBJECT_POOL_X86_64
+
+/// The scan function for each index width
+struct ScanOccupancyFns
+{
+    void (*scan8)(const uint8_t*, size_t, size_t, bitmap_word_t*);
+    void (*scan16)(const uint16_t*, size_t, size_t, bitmap_word_t*);
+    void (*scan32)(const uint32_t*, size_t, size_t, bitmap_word_t*);
+    void (*scan64)(const uint64_t*, size_t, size_t, bitmap_word_t*);
+};
+
+/// Returns the scan functions for the given instruction set, with scan32 set
+/// to nullptr if this CPU does not support it. Instruction sets without a
+/// kernel for a width fall back to the next best one.
+ScanOccupancyFns scan_occupancy_fns(ScanIsa isa)
+{
+    ScanOccupancyFns fns = {scan_occupancy_scalar<uint8_t>, scan_occupancy_scalar<uint16_t>,
+        nullptr, scan_occupancy_scalar<uint64_t>};
+    switch (isa)
+    {
+    case ScanIsa::Scalar:
+        fns.scan32 = scan_occupancy_scalar<uint32_t>;
+        break;
+#if OBJECT_POOL_X86_64
+    case ScanIsa::SSE2:
+        fns.scan8 = scan_occupancy_sse2;
+        fns.scan16 = scan_occupancy_sse2;
+        fns.scan32 = scan_occupancy_sse2;
+        break;
+    case ScanIsa::AVX2:
+        if (cpu_supports_avx2())
+        {
+            fns.scan8 = scan_occupancy_sse2;
+            fns.scan16 = scan_occupancy_sse2;
+            fns.scan32 = scan_occupancy_avx2;
+        }
+        break;
+#endif
+    default:
+        break;
+    }
+    return fns;
+}
+
+/// The currently selected instruction set, the best supported by default
+ScanIsa& selected_scan_isa()
+{
+    static ScanIsa isa = scan_occupancy_fns(ScanIsa::AVX2).scan32
+                             ? ScanIsa::AVX2
+                             : scan_occupancy_fns(ScanIsa::SSE2).scan32 ? ScanIsa::SSE2
+                                                                        : ScanIsa::Scalar;
+    return isa;
+}
+
+/// The currently selected scan functions
+ScanOccupancyFns& selected_scan_fns()
+{
+    static ScanOccupancyFns fns = scan_occupancy_fns(selected_scan_isa());
+    return fns;
+}
+
+} // anonymous namespace
+
+void scan_occupancy(const uint8_t* indices, size_t first, size_t count, bitmap_word_t* words)
+{
+    selected_scan_fns().scan8(indices, first, count, words);
+}
+
+void scan_occupancy(const uint16_t* indices, size_t first, size_t count, bitmap_word_t* words)
+{
+    selected_scan_fns().scan16(indices, first, count, words);
+}
+
+void scan_occupancy(const uint32_t* indices, size_t first, size_t count, bitmap_word_t* words)
+{
+    selected_scan_fns().scan32(indices, first, count, words);
+}
+
+void scan_occupancy(const uint64_t* indices, size_t first, size_t count, bitmap_word_t* words)
+{
+    selected_scan_fns().scan64(indices, first, count, words);
+}
+
+ScanIsa get_scan_isa()
+{
+    return selected_scan_isa();
+}
+
+bool set_scan_isa(ScanIsa isa)
+{
+    const ScanOccupancyFns fns = scan_occupancy_fns(isa);
+    if (fns.scan32)
+    {
+        selected_scan_isa() = isa;
+        selected_scan_fns() = fns;
+        return true;
+    }
+    return false;
+}
+
+} // namespace detail
+
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <map>
+#include <set>
+#include <vector>
+
+namespace tests
+{
+
+using detail::is_aligned_to;
+
+template <typename PoolT>
+void singleNewAndDelete(PoolT& mp)
+{
+    uint32_t* p = mp.new_object(0xaabbccdd);
+    REQUIRE(p != nullptr);
+    CHECK(is_aligned_to(p, 4));
+    // should be aligned to the cache line size
+    // CHECK(is_aligned_to(p, MIN_BLOCK_ALIGN));
+    CHECK(*p == 0xaabbccdd);
+    mp.delete_object(p);
+}
+
+template <typename PoolT>
+void doubleNewAndDelete(PoolT& mp)
+{
+    uint32_t* p1 = mp.new_object(0x11223344);
+    REQUIRE(p1 != nullptr);
+    CHECK(is_aligned_to(p1, 4));
+    uint32_t* p2 = mp.new_object(0x55667788);
+    REQUIRE(p2 != nullptr);
+    CHECK(is_aligned_to(p2, 4));
+    CHECK(p2 == p1 + 1);
+    CHECK(*p1 == 0x11223344);
+    mp.delete_object(p1);
+    CHECK(*p2 == 0x55667788);
+    mp.delete_object(p2);
+}
+
+template <typename PoolT>
+void blockFillAndFree(PoolT& mp, size_t size)
+{
+    std::vector<uint32_t*> v;
+    for (size_t i = 0; i < size; ++i)
+    {
+        uint32_t* p = mp.new_object(1 << i);
+        REQUIRE(p != nullptr);
+        CHECK(*p == 1u << i);
+        v.push_back(p);
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        mp.delete_object(v[i]);
+    }
+}
+
+template <typename PoolT>
+void iterateFullBlocks(PoolT& mp, const size_t size, const size_t expected_blocks)
+{
+    const size_t half_size = size >> 1;
+    std::vector<uint32_t*> v;
+    size_t i;
+    for (i = 0; i < size; ++i)
+    {
+        uint32_t* p = mp.new_object(1 << i);
+        REQUIRE(p != nullptr);
+        CHECK(*p == 1u << i);
+        v.push_back(p);
+    }
+
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == size);
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+
+    // check values
+    i = 0;
+    for (auto itr = v.begin(), end = v.end(); itr != end; ++itr)
+    {
+        CHECK(**itr == 1u << i);
+        ++i;
+    }
+
+    // delete every second entry
+    for (i = 1; i < size; i += 2)
+    {
+        uint32_t* p = v[i];
+        v[i] = nullptr;
+        mp.delete_object(p);
+    }
+
+    // check allocation count is reduced but block count is the same
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == half_size);
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+
+    // check remaining objects
+    i = 0;
+    mp.for_each([&i](const uint32_t* itr)
+        {
+            CHECK(*itr == 1u << i);
+            i += 2;
+        });
+    /*
+       for (i = 0; i < size; i += 2)
+       {
+       CHECK(*v[i] == 1u << i);
+       }
+       */
+
+    // allocate 16 new entries (fill first block)
+    for (i = 1; i < half_size; i += 2)
+    {
+        CHECK(v[i] == nullptr);
+        v[i] = mp.new_object(1 << i);
+    }
+
+    // check allocation and block count
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == size - (half_size >> 1));
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+
+    // delete objects in second block
+    for (i = half_size; i < size; ++i)
+    {
+        uint32_t* p = v[i];
+        v[i] = nullptr;
+        mp.delete_object(p);
+    }
+
+    // check that the empty block was freed
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == half_size);
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+
+    for (auto p : v)
+    {
+        mp.delete_object(p);
+    }
+
+    {
+        auto stats = mp.calc_stats();
+        CHECK(stats.num_allocations == 0u);
+        CHECK(stats.num_blocks == expected_blocks);
+    }
+}
+
+template <typename PoolT>
+void handleNewAndDelete(PoolT& mp)
+{
+    typedef typename PoolT::Handle Handle;
+    // default constructed handles never resolve
+    CHECK(mp.get_object(Handle()) == nullptr);
+    uint32_t* p1 = mp.new_object(0x11223344);
+    REQUIRE(p1 != nullptr);
+    CHECK(mp.get_object(Handle()) == nullptr);
+    Handle h1 = mp.get_handle(p1);
+    CHECK(mp.get_object(h1) == p1);
+    mp.delete_object(p1);
+    CHECK(mp.get_object(h1) == nullptr);
+    // the entry is reused but the old handle stays stale
+    uint32_t* p2 = mp.new_object(0x55667788);
+    REQUIRE(p2 == p1);
+    Handle h2 = mp.get_handle(p2);
+    CHECK(mp.get_object(h1) == nullptr);
+    CHECK(mp.get_object(h2) == p2);
+    CHECK(*mp.get_object(h2) == 0x55667788);
+    // delete all invalidates handles too
+    mp.delete_all();
+    CHECK(mp.get_object(h2) == nullptr);
+}
+
+TEST_CASE("FixedObjectPool single new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    singleNewAndDelete(mp);
+}
+
+TEST_CASE("DynamicObjectPool single new and delete", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    singleNewAndDelete(mp);
+}
+
+TEST_CASE("FixedObjectPool double new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    doubleNewAndDelete(mp);
+}
+
+TEST_CASE("Dynamic pool double new and delete", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    doubleNewAndDelete(mp);
+}
+
+TEST_CASE("FixedObjectPool block fill and free", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    blockFillAndFree(mp, 64);
+}
+
+TEST_CASE("DynamicObjectPool block fill and free", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    blockFillAndFree(mp, 64);
+}
+
+TEST_CASE("DynamicObjectPool double block fill and free", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    blockFillAndFree(mp, 128);
+}
+
+TEST_CASE("DynamicObjectPool delete all", "[dynamicpool")
+{
+    std::vector<uint32_t*> v(128, nullptr);
     DynamicObjectPool<uint32_t> mp(32);
     CHECK(mp.calc_stats().num_blocks == 1u);
     CHECK(mp.calc_stats().num_allocations == 0u);
     mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 0; i < 64; ++i)
+    {
+        mp.new_object(1 << i);
+    }
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 0; i < 64; ++i)
+    {
+        v[i] = mp.new_object(1 << i);
+    }
+    for (size_t i = 0; i < 32; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 32u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 0; i < 128; ++i)
+    {
+        v[i] = mp.new_object(1 << i);
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 128u);
+    for (size_t i = 32; i < 96; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+    for (size_t i = 0; i < 128; ++i)
+    {
+        v[i] = mp.new_object(1 << i);
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 128u);
+    for (size_t i = 0; i < 32; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 96u);
+    for (size_t i = 96; i < 128; ++i)
+    {
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.delete_all();
+    CHECK(mp.calc_stats().num_blocks == 2u);
     CHECK(mp.calc_stats().num_allocations == 0u);
     mp.reclaim_memory();
     CHECK(mp.calc_stats().num_blocks == 1u);
     CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("DynamicObjectPool delete from moved blocks", "[dynamicpool]")
+{
+    std::vector<uint32_t*> v(128, nullptr);
+    DynamicObjectPool<uint32_t> mp(32);
+    for (size_t i = 0; i < 128; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+    }
+    CHECK(mp.calc_stats().num_blocks == 4u);
+    // empty the first two blocks so reclaim moves the last two blocks forward
     for (size_t i = 0; i < 64; ++i)
     {
-        mp.new_object(1 << i);
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    // deleting objects in the moved blocks must find their new owner
+    for (size_t i = 64; i < 128; i += 2)
+    {
+        CHECK(*v[i] == i);
+        mp.delete_object(v[i]);
+        v[i] = nullptr;
+    }
+    CHECK(mp.calc_stats().num_allocations == 32u);
+    // freed entries are reused before a new block is added
+    for (size_t i = 0; i < 32; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        REQUIRE(v[i] != nullptr);
+    }
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    // deleting a null pointer is a no-op
+    mp.delete_object(nullptr);
+    CHECK(mp.calc_stats().num_allocations == 64u);
+    mp.delete_all();
+}
+
+TEST_CASE("FixedObjectPool handles", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    handleNewAndDelete(mp);
+}
+
+TEST_CASE("DynamicObjectPool handles", "[dynamicpool]")
+{
+    DynamicObjectPool<uint32_t> mp(64);
+    handleNewAndDelete(mp);
+}
+
+TEST_CASE("DynamicObjectPool handles across reclaimed blocks", "[dynamicpool]")
+{
+    typedef DynamicObjectPool<uint32_t>::Handle Handle;
+    std::vector<uint32_t*> v(96, nullptr);
+    std::vector<Handle> h(96);
+    DynamicObjectPool<uint32_t> mp(32);
+    for (size_t i = 0; i < 96; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        h[i] = mp.get_handle(v[i]);
+    }
+    // free the middle block so reclaim moves the last block and destroys one
+    for (size_t i = 32; i < 64; ++i)
+    {
+        mp.delete_object(v[i]);
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 2u);
+    for (size_t i = 0; i < 96; ++i)
+    {
+        if (i >= 32 && i < 64)
+        {
+            CHECK(mp.get_object(h[i]) == nullptr);
+        }
+        else
+        {
+            // handles survive the block being moved by reclaim
+            CHECK(mp.get_object(h[i]) == v[i]);
+        }
+    }
+    // a new block reuses the reclaimed block id but not its handles
+    for (size_t i = 32; i < 64; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+    }
+    CHECK(mp.calc_stats().num_blocks == 3u);
+    for (size_t i = 32; i < 64; ++i)
+    {
+        CHECK(mp.get_object(h[i]) == nullptr);
+        CHECK(mp.get_object(mp.get_handle(v[i])) == v[i]);
+    }
+    mp.delete_all();
+}
+
+template <typename PoolT>
+void batchNewAndDelete(PoolT& mp, uint32_t size)
+{
+    std::vector<uint32_t*> v(size, nullptr);
+    CHECK(mp.new_objects(size, v.data(), 7u) == size);
+    std::set<uint32_t*> unique(v.begin(), v.end());
+    CHECK(unique.size() == size);
+    for (auto p : v)
+    {
+        CHECK(*p == 7u);
+    }
+    CHECK(mp.calc_stats().num_allocations == size);
+
+    // delete every other object in one batch then refill the gaps
+    std::vector<uint32_t*> odd;
+    for (uint32_t i = 1; i < size; i += 2)
+    {
+        odd.push_back(v[i]);
+    }
+    mp.delete_objects(odd.data(), static_cast<detail::index_t>(odd.size()));
+    CHECK(mp.calc_stats().num_allocations == size - odd.size());
+    std::vector<uint32_t*> refill(odd.size(), nullptr);
+    CHECK(mp.new_objects(static_cast<detail::index_t>(refill.size()), refill.data(), 9u) ==
+          refill.size());
+    CHECK(std::set<uint32_t*>(refill.begin(), refill.end()) ==
+          std::set<uint32_t*>(odd.begin(), odd.end()));
+    uint32_t sum = 0;
+    mp.for_each([&sum](const uint32_t* p)
+        {
+            sum += *p;
+        });
+    CHECK(sum == 7u * (size - odd.size()) + 9u * odd.size());
+
+    // delete the evens singly and the refilled odds in a batch
+    for (uint32_t i = 0; i < size; i += 2)
+    {
+        mp.delete_object(v[i]);
+    }
+    mp.delete_objects(refill.data(), static_cast<detail::index_t>(refill.size()));
+    ObjectPoolStats stats = mp.calc_stats();
+    CHECK(stats.num_allocations == 0u);
+    CHECK(stats.total_allocations == size + refill.size());
+    CHECK(stats.total_frees == size + refill.size());
+}
+
+TEST_CASE("FixedObjectPool batch new and delete", "[fixedpool]")
+{
+    FixedObjectPool<uint32_t> mp(64);
+    batchNewAndDelete(mp, 64);
+    // a full pool creates as many objects as fit
+    std::vector<uint32_t*> v(80, nullptr);
+    CHECK(mp.new_objects(48, v.data()) == 48u);
+    CHECK(mp.new_objects(32, v.data() + 48) == 16u);
+    CHECK(mp.calc_stats().failed_allocations == 16u);
+    mp.delete_objects(v.data(), 64);
+    CHECK(mp.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("DynamicObjectPool batch new and delete", "[dynamicpool]")
+{
+    {
+        DynamicObjectPool<uint32_t> mp(32);
+        batchNewAndDelete(mp, 128);
+        CHECK(mp.calc_stats().num_blocks == 4u);
+    }
+    {
+        // runs spanning blocks and a partly filled block are all freed
+        DynamicObjectPool<uint32_t> mp(32);
+        std::vector<uint32_t*> v(100, nullptr);
+        CHECK(mp.new_objects(10, v.data(), 1u) == 10u);
+        CHECK(mp.new_objects(90, v.data() + 10, 2u) == 90u);
+        CHECK(mp.calc_stats().num_blocks == 4u);
+        mp.delete_objects(v.data() + 5, 60);
+        CHECK(mp.calc_stats().num_allocations == 40u);
+        // freed space in the first block is reused before the last block
+        uint32_t* p = mp.new_object(3u);
+        CHECK(std::find(v.begin() + 5, v.begin() + 65, p) != v.begin() + 65);
+        mp.delete_object(p);
+        mp.delete_objects(v.data(), 5);
+        mp.delete_objects(v.data() + 65, 35);
+        CHECK(mp.calc_stats().num_allocations == 0u);
+    }
+    {
+        // a full reservation creates as many objects as fit
+        DynamicObjectPool<uint32_t> mp(32, detail::virtual_page_size());
+        const uint32_t capacity = 32;
+        std::vector<uint32_t*> v(capacity + 8, nullptr);
+        CHECK(mp.new_objects(capacity + 8, v.data()) == capacity);
+        mp.delete_objects(v.data(), capacity);
+        CHECK(mp.calc_stats().num_allocations == 0u);
+    }
+}
+
+TEST_CASE("FixedObjectPool stats", "[fixedpool]")
+{
+    typedef detail::ObjectPoolBlock<uint32_t, ObjectPoolTraits> Block;
+    FixedObjectPool<uint32_t> mp(64);
+    std::vector<uint32_t*> v;
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    CHECK(mp.new_object(0u) == nullptr);
+    for (size_t i = 0; i < 16; ++i)
+    {
+        mp.delete_object(v[i]);
+    }
+    mp.delete_object(nullptr);
+    ObjectPoolStats stats = mp.calc_stats();
+    CHECK(stats.num_blocks == 1u);
+    CHECK(stats.num_allocations == 48u);
+    CHECK(stats.high_water_mark == 64u);
+    CHECK(stats.peak_blocks == 1u);
+    CHECK(stats.bytes_reserved == Block::alloc_size(64));
+    CHECK(stats.bytes_metadata == Block::alloc_size(64) - 64 * sizeof(uint32_t));
+    CHECK(stats.total_allocations == 64u);
+    CHECK(stats.total_frees == 16u);
+    CHECK(stats.failed_allocations == 1u);
+    mp.delete_all();
+    stats = mp.calc_stats();
+    CHECK(stats.num_allocations == 0u);
+    CHECK(stats.high_water_mark == 64u);
+    CHECK(stats.total_frees == 64u);
+}
+
+TEST_CASE("DynamicObjectPool stats", "[dynamicpool]")
+{
+    std::vector<uint32_t*> v;
+    DynamicObjectPool<uint32_t> mp(32);
+    for (uint32_t i = 0; i < 96; ++i)
+    {
+        v.push_back(mp.new_object(i));
+    }
+    for (size_t i = 32; i < 96; ++i)
+    {
+        mp.delete_object(v[i]);
+    }
+    mp.reclaim_memory();
+    uint32_t* reserved[8];
+    CHECK(mp.reserve_entries(reserved, 8) == 8u);
+    ObjectPoolStats stats = mp.calc_stats();
+    CHECK(stats.num_blocks == 2u);
+    // reserved entries count as allocations
+    CHECK(stats.num_allocations == 40u);
+    CHECK(stats.high_water_mark == 96u);
+    CHECK(stats.peak_blocks == 3u);
+    CHECK(stats.bytes_reserved > stats.bytes_metadata);
+    CHECK(stats.total_allocations == 104u);
+    CHECK(stats.total_frees == 64u);
+    CHECK(stats.failed_allocations == 0u);
+    mp.release_entries(reserved, 8);
+    mp.delete_all();
+    stats = mp.calc_stats();
+    CHECK(stats.num_allocations == 0u);
+    CHECK(stats.total_frees == 104u);
+    // a full reservation counts failed allocations
+    DynamicObjectPool<uint32_t> full(32, detail::virtual_page_size());
+    for (uint32_t i = 0; i < 32; ++i)
+    {
+        v[i] = full.new_object(i);
+    }
+    CHECK(full.new_object(0u) == nullptr);
+    CHECK(full.reserve_entries(reserved, 8) == 0u);
+    stats = full.calc_stats();
+    CHECK(stats.failed_allocations == 9u);
+    CHECK(stats.bytes_reserved == detail::virtual_page_size());
+    full.delete_all();
+}
+
+TEST_CASE("DynamicObjectPool reserved block fill and free", "[dynamicpool]")
+{
+    {
+        DynamicObjectPool<uint32_t> mp(64, 1 << 20);
+        blockFillAndFree(mp, 128);
+        handleNewAndDelete(mp);
+    }
+    {
+        DynamicObjectPool<uint32_t> mp(64, 1 << 20);
+        iterateFullBlocks(mp, 128, 2);
+    }
+}
+
+TEST_CASE("DynamicObjectPool reserved blocks are contiguous", "[dynamicpool]")
+{
+    const size_t page_size = detail::virtual_page_size();
+    std::vector<uint32_t*> v(96, nullptr);
+    DynamicObjectPool<uint32_t> mp(32, 3 * page_size);
+    for (size_t i = 0; i < 96; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        REQUIRE(v[i] != nullptr);
+    }
+    CHECK(mp.calc_stats().num_blocks == 3u);
+    // each block starts a page after the previous one
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(v[0]);
+    CHECK(reinterpret_cast<const uint8_t*>(v[32]) == base + page_size);
+    CHECK(reinterpret_cast<const uint8_t*>(v[64]) == base + 2 * page_size);
+    // the reservation is full
+    CHECK(mp.new_object(0u) == nullptr);
+    // decommit the last two blocks and check they are recommitted in place
+    for (size_t i = 32; i < 96; ++i)
+    {
+        mp.delete_object(v[i]);
+    }
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    for (size_t i = 32; i < 96; ++i)
+    {
+        uint32_t* p = mp.new_object(static_cast<uint32_t>(i));
+        REQUIRE(p != nullptr);
+        CHECK(p == v[i]);
+        CHECK(*p == i);
+    }
+    CHECK(mp.calc_stats().num_allocations == 96u);
+    mp.delete_all();
+}
+
+/// Pool configuration backed by huge pages
+struct HugePageTraits : ObjectPoolTraits
+{
+    static const bool huge_pages = true;
+};
+
+TEST_CASE("FixedObjectPool huge pages", "[fixedpool]")
+{
+    {
+        FixedObjectPool<uint32_t, HugePageTraits> mp(64);
+        blockFillAndFree(mp, 64);
+        handleNewAndDelete(mp);
+    }
+    {
+        FixedObjectPool<uint32_t, HugePageTraits> mp(64);
+        iterateFullBlocks(mp, 64, 1);
+    }
+    {
+        // a block larger than a huge page
+        FixedObjectPool<uint64_t, HugePageTraits> mp(1 << 20);
+        uint64_t* p = mp.new_object(1u);
+        REQUIRE(p != nullptr);
+        CHECK(is_aligned_to(p, alignof(uint64_t)));
+        mp.delete_object(p);
+    }
+}
+
+TEST_CASE("DynamicObjectPool huge pages", "[dynamicpool]")
+{
+    {
+        DynamicObjectPool<uint32_t, HugePageTraits> mp(64);
+        iterateFullBlocks(mp, 128, 2);
+    }
+    {
+        DynamicObjectPool<uint32_t, HugePageTraits> mp(64, 1 << 20);
+        iterateFullBlocks(mp, 128, 2);
+        mp.reclaim_memory();
+        CHECK(mp.calc_stats().num_blocks == 1u);
+        blockFillAndFree(mp, 128);
+    }
+}
+
+#if defined(__linux__)
+/// Returns true if the page containing ptr is resident in physical memory
+bool is_page_resident(const void* ptr)
+{
+    const uintptr_t page_size = detail::virtual_page_size();
+    void* page = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(ptr) & ~(page_size - 1));
+    unsigned char resident = 0;
+    REQUIRE(mincore(page, page_size, &resident) == 0);
+    return (resident & 1) != 0;
+}
+#endif
+
+template <typename PoolT>
+void reclaimDiscard(PoolT& mp, ObjectPoolReclaim mode)
+{
+    typedef typename PoolT::Handle Handle;
+    // blocks span several pages so there are whole pages to discard
+    const size_t block_size = 4096;
+    std::vector<uint32_t*> v(3 * block_size, nullptr);
+    std::vector<Handle> h(v.size());
+    for (size_t i = 0; i < v.size(); ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        REQUIRE(v[i] != nullptr);
+        h[i] = mp.get_handle(v[i]);
+    }
+    // delete in reverse so the free lists hand entries back in address order
+    for (size_t i = v.size(); i-- != block_size;)
+    {
+        mp.delete_object(v[i]);
+    }
+#if defined(__linux__)
+    // a page in the middle of the second block's entries
+    const uint32_t* probe = v[block_size + block_size / 2];
+    CHECK(is_page_resident(probe));
+#endif
+    mp.reclaim_memory(mode);
+    // discarded blocks are kept
+    CHECK(mp.calc_stats().num_blocks == 3u);
+#if defined(__linux__)
+    // MADV_FREE leaves pages resident until there is memory pressure
+    if (mode == ObjectPoolReclaim::Discard)
+    {
+        CHECK(!is_page_resident(probe));
+    }
+#endif
+    CHECK(mp.calc_stats().num_allocations == block_size);
+    for (size_t i = 0; i < block_size; ++i)
+    {
+        CHECK(*v[i] == i);
+    }
+    // reused entries keep their addresses but not their handles
+    for (size_t i = block_size; i < v.size(); ++i)
+    {
+        CHECK(mp.get_object(h[i]) == nullptr);
+        uint32_t* p = mp.new_object(static_cast<uint32_t>(i));
+        CHECK(p == v[i]);
+        CHECK(*p == i);
+    }
+    CHECK(mp.calc_stats().num_blocks == 3u);
+    CHECK(mp.calc_stats().num_allocations == v.size());
+    mp.delete_all();
+    // discarding an entirely empty pool keeps every block too
+    mp.reclaim_memory(mode);
+    CHECK(mp.calc_stats().num_blocks == 3u);
+}
+
+TEST_CASE("DynamicObjectPool reclaim by discarding pages", "[dynamicpool]")
+{
+    {
+        DynamicObjectPool<uint32_t> mp(4096);
+        reclaimDiscard(mp, ObjectPoolReclaim::Discard);
+    }
+    {
+        DynamicObjectPool<uint32_t> mp(4096);
+        reclaimDiscard(mp, ObjectPoolReclaim::LazyDiscard);
+    }
+    {
+        DynamicObjectPool<uint32_t> mp(4096, 1 << 20);
+        reclaimDiscard(mp, ObjectPoolReclaim::Discard);
+    }
+}
+
+/// Non-trivially copyable object counting live instances
+struct Tracked
+{
+    explicit Tracked(uint32_t value) : value_(new uint32_t(value)) { ++s_live; }
+    Tracked(Tracked&& other) : value_(other.value_)
+    {
+        other.value_ = nullptr;
+        ++s_live;
+        ++s_moves;
+    }
+    ~Tracked()
+    {
+        delete value_;
+        --s_live;
+    }
+    uint32_t* value_;
+    static int s_live;
+    static int s_moves;
+};
+
+int Tracked::s_live = 0;
+int Tracked::s_moves = 0;
+
+/// As Tracked, but relocated with memcpy
+struct RelocatableTracked : Tracked
+{
+    explicit RelocatableTracked(uint32_t value) : Tracked(value) {}
+};
+
+} // namespace tests
+
+template <>
+struct ObjectPoolRelocatable<tests::RelocatableTracked> : std::true_type
+{
+};
+
+namespace tests
+{
+
+template <typename T>
+void compactSparseBlocks(bool expect_moves)
+{
+    typedef typename DynamicObjectPool<T>::Handle Handle;
+    DynamicObjectPool<T> mp(32);
+    std::vector<T*> v(256, nullptr);
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        v[i] = mp.new_object(i);
+    }
+    // keep every eighth object, four per block
+    std::map<T*, uint32_t> live;
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        if (i % 8 == 0)
+        {
+            live[v[i]] = i;
+        }
+        else
+        {
+            mp.delete_object(v[i]);
+        }
+    }
+    const Handle h = mp.get_handle(v[8 * 31]);
+    mp.reclaim_memory();
+    CHECK(mp.calc_stats().num_blocks == 8u);
+    const int moves_before = T::s_moves;
+
+    std::map<T*, uint32_t> moved;
+    const size_t num_moved = mp.compact([&live, &moved](T* old_ptr, T* new_ptr)
+        {
+            auto itr = live.find(old_ptr);
+            REQUIRE(itr != live.end());
+            CHECK(*new_ptr->value_ == itr->second);
+            moved[new_ptr] = itr->second;
+            live.erase(itr);
+        });
+    // the survivors of seven blocks move into the remaining block
+    CHECK(num_moved == 32u - 4u);
+    CHECK(mp.calc_stats().num_blocks == 1u);
+    CHECK(mp.calc_stats().num_allocations == 32u);
+    CHECK(T::s_live == 32);
+    CHECK((T::s_moves != moves_before) == expect_moves);
+    CHECK(mp.get_object(h) == nullptr);
+
+    // every surviving object is visited with its original value
+    moved.insert(live.begin(), live.end());
+    size_t count = 0;
+    mp.for_each([&moved, &count](T* p)
+        {
+            auto itr = moved.find(p);
+            REQUIRE(itr != moved.end());
+            CHECK(*p->value_ == itr->second);
+            ++count;
+        });
+    CHECK(count == 32u);
+
+    // compacting a dense pool moves nothing
+    CHECK(mp.compact() == 0u);
+    mp.delete_all();
+    CHECK(T::s_live == 0);
+}
+
+TEST_CASE("DynamicObjectPool compact", "[dynamicpool]")
+{
+    compactSparseBlocks<Tracked>(true);
+    compactSparseBlocks<RelocatableTracked>(false);
+    {
+        // reserved entries are not moved
+        DynamicObjectPool<uint32_t> mp(32);
+        std::vector<uint32_t*> v(64, nullptr);
+        CHECK(mp.new_objects(64, v.data(), 5u) == 64u);
+        mp.delete_objects(v.data() + 1, 63);
+        uint32_t* reserved = nullptr;
+        CHECK(mp.reserve_entries(&reserved, 1) == 1u);
+        CHECK(mp.compact() == 0u);
+        CHECK(mp.calc_stats().num_blocks == 1u);
+        mp.release_entries(&reserved, 1);
+        mp.delete_all();
+    }
+}
+
+template <typename PoolT>
+void iterateOnNodes(PoolT& mp, const size_t size)
+{
+    std::vector<uint32_t*> v(size, nullptr);
+    for (size_t i = 0; i < size; ++i)
+    {
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        REQUIRE(v[i] != nullptr);
+    }
+    // every object is visited exactly once across all nodes
+    const int num_nodes = detail::numa_num_nodes();
+    size_t count = 0;
+    for (int node = 0; node < num_nodes; ++node)
+    {
+        mp.for_each_on_node(node, [&count, node](const uint32_t* p)
+            {
+                CHECK(detail::numa_node_of(p) == node);
+                ++count;
+            });
+    }
+    CHECK(count == size);
+    mp.for_each_on_node(num_nodes, [](const uint32_t*)
+        {
+            FAIL("no blocks should be on a node which does not exist");
+        });
+    mp.delete_all();
+}
+
+TEST_CASE("NUMA queries degrade gracefully", "[numa]")
+{
+    const int num_nodes = detail::numa_num_nodes();
+    CHECK(num_nodes >= 1);
+    CHECK(detail::numa_current_node() >= 0);
+    CHECK(detail::numa_current_node() < num_nodes);
+    int value = 0;
+    CHECK(detail::numa_node_of(&value) >= 0);
+    CHECK(detail::numa_node_of(&value) < num_nodes);
+}
+
+TEST_CASE("DynamicObjectPool NUMA placement", "[dynamicpool]")
+{
+    typedef DynamicObjectPool<uint32_t> PoolT;
+    {
+        PoolT mp(64);
+        CHECK(mp.numa_node() == PoolT::NUMA_NODE_ANY);
+        iterateOnNodes(mp, 256);
     }
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
-    mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 1u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
-    for (size_t i = 0; i < 64; ++i)
     {
-        v[i] = mp.new_object(1 << i);
+        PoolT mp(64, 0, PoolT::NUMA_NODE_CALLER);
+        CHECK(mp.numa_node() == PoolT::NUMA_NODE_CALLER);
+        iterateOnNodes(mp, 256);
     }
-    for (size_t i = 0; i < 32; ++i)
     {
-        mp.delete_object(v[i]);
-        v[i] = nullptr;
+        // the last node exists on every machine
+        const int node = detail::numa_num_nodes() - 1;
+        PoolT mp(1024, 1 << 20);
+        mp.set_numa_node(node);
+        CHECK(mp.numa_node() == node);
+        iterateOnNodes(mp, 4096);
+        size_t count = 0;
+        mp.new_object(0u);
+        mp.for_each_on_node(node, [&count](const uint32_t*)
+            {
+                ++count;
+            });
+        CHECK(count == 1u);
+        mp.delete_all();
     }
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 1u);
-    CHECK(mp.calc_stats().num_allocations == 32u);
-    mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 1u);
-    CHECK(mp.calc_stats().num_allocations == 0u);
-    for (size_t i = 0; i < 128; ++i)
     {
-        v[i] = mp.new_object(1 << i);
+        // heap blocks for a node get pages of their own, even when smaller
+        // than a page, and are recorded on the requested node
+        const int node = detail::numa_num_nodes() - 1;
+        PoolT mp(16, 0, node);
+        iterateOnNodes(mp, 256);
+        const uint32_t* p = mp.new_object(0u);
+        CHECK(detail::numa_node_of(p) == node);
+        size_t count = 0;
+        mp.for_each_on_node(node, [&count](const uint32_t*)
+            {
+                ++count;
+            });
+        CHECK(count == 1u);
+        mp.delete_all();
+        mp.reclaim_memory();
+        // mapped and heap blocks in one pool are each freed correctly
+        for (uint32_t i = 0; i < 64; ++i)
+        {
+            if (i == 32)
+            {
+                mp.set_numa_node(PoolT::NUMA_NODE_ANY);
+            }
+            REQUIRE(mp.new_object(i) != nullptr);
+        }
+        CHECK(mp.calc_stats().num_blocks == 4u);
+        mp.delete_all();
+        mp.reclaim_memory();
     }
-    CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 128u);
-    for (size_t i = 32; i < 96; ++i)
+}
+
+/// Pool configuration with an occupancy bitmap
+struct BitmapTraits : ObjectPoolTraits
+{
+    static const bool occupancy_bitmap = true;
+};
+
+template <typename PoolT>
+void iterateSparse(PoolT& mp, const size_t size)
+{
+    std::vector<uint32_t*> v(size, nullptr);
+    for (size_t i = 0; i < size; ++i)
     {
-        mp.delete_object(v[i]);
-        v[i] = nullptr;
+        v[i] = mp.new_object(static_cast<uint32_t>(i));
+        REQUIRE(v[i] != nullptr);
     }
-    CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
+    // keep every 37th entry so most bitmap words are partially empty
+    size_t expected = 0;
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (i % 37 != 0)
+        {
+            mp.delete_object(v[i]);
+            v[i] = nullptr;
+        }
+        else
+        {
+            ++expected;
+        }
+    }
+    CHECK(mp.calc_stats().num_allocations == expected);
+    size_t count = 0;
+    uint32_t next = 0;
+    mp.for_each([&count, &next](const uint32_t* p)
+        {
+            CHECK(*p == next);
+            next += 37;
+            ++count;
+        });
+    CHECK(count == expected);
+    // refill and check everything is visited
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (v[i] == nullptr)
+        {
+            v[i] = mp.new_object(static_cast<uint32_t>(i));
+        }
+    }
+    count = 0;
+    mp.for_each([&count](const uint32_t*)
+        {
+            ++count;
+        });
+    CHECK(count == size);
+    CHECK(mp.calc_stats().num_allocations == size);
     mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 2u);
     CHECK(mp.calc_stats().num_allocations == 0u);
-    for (size_t i = 0; i < 128; ++i)
+    mp.for_each([](const uint32_t*)
+        {
+            FAIL("no objects should remain");
+        });
+}
+
+TEST_CASE("FixedObjectPool occupancy bitmap", "[fixedpool]")
+{
     {
-        v[i] = mp.new_object(1 << i);
+        FixedObjectPool<uint32_t, BitmapTraits> mp(64);
+        singleNewAndDelete(mp);
+        doubleNewAndDelete(mp);
+        handleNewAndDelete(mp);
+        iterateFullBlocks(mp, 64, 1);
     }
-    CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 128u);
-    for (size_t i = 0; i < 32; ++i)
     {
-        mp.delete_object(v[i]);
-        v[i] = nullptr;
+        FixedObjectPool<uint32_t, BitmapTraits> mp(1000);
+        iterateSparse(mp, 1000);
     }
-    CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 96u);
-    for (size_t i = 96; i < 128; ++i)
     {
-        mp.delete_object(v[i]);
-        v[i] = nullptr;
+        FixedObjectPool<uint32_t> mp(1000);
+        iterateSparse(mp, 1000);
+    }
+}
+
+TEST_CASE("DynamicObjectPool occupancy bitmap", "[dynamicpool]")
+{
+    {
+        DynamicObjectPool<uint32_t, BitmapTraits> mp(64);
+        singleNewAndDelete(mp);
+        doubleNewAndDelete(mp);
+        handleNewAndDelete(mp);
+        iterateFullBlocks(mp, 128, 2);
+    }
+    {
+        DynamicObjectPool<uint32_t, BitmapTraits> mp(100);
+        iterateSparse(mp, 1000);
+    }
+}
+
+TEST_CASE("Pools with odd entry counts", "[block]")
+{
+    // an odd number of generations leaves the bitmap needing alignment
+    {
+        FixedObjectPool<uint32_t> mp(63);
+        iterateSparse(mp, 63);
+    }
+    {
+        FixedObjectPool<uint32_t, BitmapTraits> mp(63);
+        iterateSparse(mp, 63);
+    }
+    {
+        DynamicObjectPool<uint32_t> mp(63);
+        iterateSparse(mp, 200);
+    }
+    {
+        DynamicObjectPool<uint32_t, BitmapTraits> mp(63);
+        iterateSparse(mp, 200);
+    }
+}
+
+template <typename Traits>
+void blockRuns(detail::index_t size)
+{
+    typedef detail::ObjectPoolBlock<uint32_t, Traits> Block;
+    Block* block = Block::create(size, detail::MIN_BLOCK_ALIGN);
+    // pseudo random runs, including ones crossing words and chunks
+    std::vector<bool> live(size);
+    uint32_t seed = 12345;
+    bool state = false;
+    for (detail::index_t i = 0; i < size; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 5 == 0 || i == 63 || i == 64 || i == 256)
+        {
+            state = !state;
+        }
+        live[i] = state || i == size - 1;
+        block->new_object(i);
+    }
+    for (detail::index_t i = 0; i < size; ++i)
+    {
+        if (!live[i])
+        {
+            block->delete_object(block->memory_offset() + i);
+        }
+    }
+    std::vector<bool> visited(size);
+    detail::index_t prev_last = 0;
+    bool first_run = true;
+    block->for_each_run([&](detail::index_t first, detail::index_t last)
+        {
+            REQUIRE(first < last);
+            REQUIRE(last <= size);
+            // runs are maximal and in order
+            CHECK((first_run || first > prev_last));
+            CHECK((last == size || !live[last]));
+            for (detail::index_t i = first; i != last; ++i)
+            {
+                CHECK(live[i]);
+                visited[i] = true;
+            }
+            prev_last = last;
+            first_run = false;
+        });
+    CHECK(visited == live);
+    // occupancy words match the live entries
+    std::vector<bool> occupied(size);
+    detail::index_t next_first = 0;
+    block->for_each_occupancy_word([&](detail::index_t first, detail::bitmap_word_t word)
+        {
+            CHECK(first == next_first);
+            next_first = first + 64;
+            for (detail::index_t i = 0; i < 64; ++i)
+            {
+                if (word & (detail::bitmap_word_t(1) << i))
+                {
+                    REQUIRE((first + i) < size);
+                    occupied[first + i] = true;
+                }
+            }
+        });
+    CHECK(occupied == live);
+    block->delete_all();
+    block->for_each_run([](detail::index_t, detail::index_t)
+        {
+            FAIL("no runs should remain");
+        });
+    Block::destroy(block);
+}
+
+TEST_CASE("Block runs of live entries", "[block]")
+{
+    blockRuns<ObjectPoolTraits>(1000);
+    blockRuns<ObjectPoolTraits>(512);
+    blockRuns<BitmapTraits>(1000);
+    blockRuns<BitmapTraits>(128);
+}
+
+template <size_t Align>
+struct alignas(Align) OverAligned
+{
+    uint32_t value;
+    explicit OverAligned(uint32_t v) : value(v) {}
+};
+
+template <typename PoolT>
+void overAlignedEntries(PoolT& mp, uint32_t size)
+{
+    typedef typename PoolT::value_t ValueT;
+    std::vector<ValueT*> v;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        ValueT* p = mp.new_object(i);
+        REQUIRE(p != nullptr);
+        CHECK(is_aligned_to(p, alignof(ValueT)));
+        CHECK(mp.get_object(mp.get_handle(p)) == p);
+        v.push_back(p);
+    }
+    for (uint32_t i = 0; i < size; ++i)
+    {
+        CHECK(v[i]->value == i);
+    }
+    uint32_t count = 0;
+    mp.for_each([&count](const ValueT* p)
+        {
+            CHECK(is_aligned_to(p, alignof(ValueT)));
+            ++count;
+        });
+    CHECK(count == size);
+    for (ValueT* p : v)
+    {
+        mp.delete_object(p);
     }
-    CHECK(mp.calc_stats().num_blocks == 4u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 2u);
-    CHECK(mp.calc_stats().num_allocations == 64u);
-    mp.delete_all();
-    CHECK(mp.calc_stats().num_blocks == 2u);
     CHECK(mp.calc_stats().num_allocations == 0u);
-    mp.reclaim_memory();
-    CHECK(mp.calc_stats().num_blocks == 1u);
+}
+
+TEST_CASE("FixedObjectPool over aligned entries", "[fixedpool]")
+{
+    {
+        FixedObjectPool<OverAligned<32> > mp(100);
+        overAlignedEntries(mp, 100);
+    }
+    {
+        FixedObjectPool<OverAligned<256>, BitmapTraits> mp(100);
+        overAlignedEntries(mp, 100);
+    }
+    {
+        FixedObjectPool<OverAligned<4096> > mp(8);
+        overAlignedEntries(mp, 8);
+    }
+}
+
+TEST_CASE("DynamicObjectPool over aligned entries", "[dynamicpool]")
+{
+    {
+        DynamicObjectPool<OverAligned<32> > mp(30);
+        overAlignedEntries(mp, 100);
+    }
+    {
+        DynamicObjectPool<OverAligned<128>, BitmapTraits> mp(30);
+        overAlignedEntries(mp, 100);
+    }
+    {
+        DynamicObjectPool<OverAligned<4096> > mp(3);
+        overAlignedEntries(mp, 10);
+    }
+    {
+        // reserved blocks are page aligned
+        DynamicObjectPool<OverAligned<4096> > mp(3, 1 << 20);
+        overAlignedEntries(mp, 10);
+    }
+}
+
+struct PaddedTraits : ObjectPoolTraits
+{
+    static const bool cache_line_padding = true;
+};
+
+struct PaddedBitmapTraits : PaddedTraits
+{
+    static const bool occupancy_bitmap = true;
+};
+
+template <typename PoolT>
+void paddedEntries(PoolT& mp, uint32_t size)
+{
+    std::vector<uint32_t*> v(size);
+    REQUIRE(mp.new_objects(size, v.data(), 7u) == size);
+    std::set<uintptr_t> lines;
+    for (uint32_t* p : v)
+    {
+        // every object starts its own cache line
+        CHECK(is_aligned_to(p, 64));
+        CHECK(*p == 7u);
+        CHECK(mp.get_object(mp.get_handle(p)) == p);
+        lines.insert(reinterpret_cast<uintptr_t>(p) / 64);
+    }
+    CHECK(lines.size() == size);
+    uint32_t count = 0;
+    mp.for_each([&count, &lines](const uint32_t* p)
+        {
+            CHECK(lines.count(reinterpret_cast<uintptr_t>(p) / 64) == 1u);
+            ++count;
+        });
+    CHECK(count == size);
+    // padding is not counted as entry storage
+    const ObjectPoolStats stats = mp.calc_stats();
+    const size_t bytes_entries = stats.bytes_reserved - stats.bytes_metadata;
+    CHECK(bytes_entries >= size_t(size) * 64);
+    mp.delete_objects(v.data(), size);
     CHECK(mp.calc_stats().num_allocations == 0u);
 }
 
+TEST_CASE("FixedObjectPool cache line padding", "[fixedpool]")
+{
+    {
+        FixedObjectPool<uint32_t, PaddedTraits> mp(100);
+        paddedEntries(mp, 100);
+        singleNewAndDelete(mp);
+        handleNewAndDelete(mp);
+    }
+    {
+        FixedObjectPool<uint32_t, PaddedBitmapTraits> mp(64);
+        paddedEntries(mp, 64);
+    }
+    {
+        FixedObjectPool<uint32_t, PaddedBitmapTraits> mp(64);
+        iterateFullBlocks(mp, 64, 1);
+    }
+    {
+        // entries larger than a cache line are padded to whole lines
+        FixedObjectPool<OverAligned<128>, PaddedTraits> mp(10);
+        overAlignedEntries(mp, 10);
+    }
+}
+
+TEST_CASE("DynamicObjectPool cache line padding", "[dynamicpool]")
+{
+    {
+        DynamicObjectPool<uint32_t, PaddedTraits> mp(30);
+        paddedEntries(mp, 100);
+        singleNewAndDelete(mp);
+        handleNewAndDelete(mp);
+    }
+    {
+        DynamicObjectPool<uint32_t, PaddedBitmapTraits> mp(64);
+        paddedEntries(mp, 100);
+    }
+    {
+        DynamicObjectPool<uint32_t, PaddedBitmapTraits> mp(64);
+        iterateFullBlocks(mp, 128, 2);
+    }
+    {
+        DynamicObjectPool<uint32_t, PaddedTraits> mp(30, 1 << 20);
+        paddedEntries(mp, 100);
+    }
+}
+
+template <typename I>
+void scanMatchesScalar(size_t size)
+{
+    using detail::ScanIsa;
+    using detail::bitmap_word_t;
+    const ScanIsa isas[] = {ScanIsa::Scalar, ScanIsa::SSE2, ScanIsa::AVX2};
+    // pseudo random occupancy
+    std::vector<I> indices(size);
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        indices[i] = static_cast<I>((seed >> 16) % 3 == 0 ? i : i + 1);
+    }
+    const size_t ranges[][2] = {
+        {0, size}, {0, 64}, {3, 61}, {17, 200}, {size - 100, 100}, {64, 129}};
+    for (auto range : ranges)
+    {
+        bitmap_word_t expected[16] = {};
+        bitmap_word_t actual[16] = {};
+        REQUIRE(detail::set_scan_isa(ScanIsa::Scalar));
+        detail::scan_occupancy(indices.data(), range[0], range[1], expected);
+        for (auto isa : isas)
+        {
+            if (detail::set_scan_isa(isa))
+            {
+                detail::scan_occupancy(indices.data(), range[0], range[1], actual);
+                for (size_t i = 0; i < (range[1] + 63) / 64; ++i)
+                {
+                    CHECK(actual[i] == expected[i]);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Occupancy scan instruction sets match scalar", "[scan]")
+{
+    using detail::ScanIsa;
+    const ScanIsa isas[] = {ScanIsa::Scalar, ScanIsa::SSE2, ScanIsa::AVX2};
+    const ScanIsa default_isa = detail::get_scan_isa();
+    scanMatchesScalar<uint8_t>(255);
+    scanMatchesScalar<uint16_t>(1000);
+    scanMatchesScalar<uint32_t>(1000);
+    scanMatchesScalar<uint64_t>(1000);
+    for (auto isa : isas)
+    {
+        if (detail::set_scan_isa(isa))
+        {
+            // pools behave the same with every instruction set
+            FixedObjectPool<uint32_t> mp(1000);
+            iterateSparse(mp, 1000);
+            FixedObjectPool<uint32_t, ObjectPoolIndexTraits<255>> mp8(255);
+            iterateSparse(mp8, 255);
+            FixedObjectPool<uint32_t, ObjectPoolIndexTraits<1000>> mp16(1000);
+            iterateSparse(mp16, 1000);
+        }
+    }
+    REQUIRE(detail::set_scan_isa(default_isa));
+}
+
+// the narrowest index type that can address the capacity is selected
+static_assert(std::is_same<ObjectPoolIndexTraits<255>::index_type, uint8_t>::value, "");
+static_assert(std::is_same<ObjectPoolIndexTraits<256>::index_type, uint16_t>::value, "");
+static_assert(std::is_same<ObjectPoolIndexTraits<65535>::index_type, uint16_t>::value, "");
+static_assert(std::is_same<ObjectPoolIndexTraits<65536>::index_type, uint32_t>::value, "");
+static_assert(
+    std::is_same<ObjectPoolIndexTraits<0x100000000ull>::index_type, uint64_t>::value, "");
+// handles only widen for 64 bit indices
+static_assert(std::is_same<FixedObjectPool<uint32_t, ObjectPoolIndexTraits<255>>::Handle,
+                  ObjectPoolHandle>::value,
+    "");
+static_assert(std::is_same<decltype(DynamicObjectPool<uint32_t,
+                               ObjectPoolIndexTraits<0x100000000ull>>::Handle::index),
+                  uint64_t>::value,
+    "");
+
+struct BitmapIndex8Traits : ObjectPoolIndexTraits<255, BitmapTraits>
+{
+};
+
+struct Index64Traits : ObjectPoolTraits
+{
+    typedef uint64_t index_type;
+};
+
+TEST_CASE("Narrow index block metadata", "[block]")
+{
+    typedef detail::ObjectPoolBlock<uint32_t, ObjectPoolTraits> Block32;
+    typedef detail::ObjectPoolBlock<uint32_t, ObjectPoolIndexTraits<255>> Block8;
+    typedef detail::ObjectPoolBlock<uint32_t, ObjectPoolIndexTraits<1000>> Block16;
+    CHECK(Block8::metadata_size(255) < Block32::metadata_size(255));
+    CHECK(Block16::metadata_size(1000) < Block32::metadata_size(1000));
+    CHECK(Block8::storage_size(255) <= Block32::storage_size(255));
+}
+
+TEST_CASE("FixedObjectPool index widths", "[fixedpool]")
+{
+    {
+        FixedObjectPool<uint32_t, ObjectPoolIndexTraits<64>> mp(64);
+        singleNewAndDelete(mp);
+        doubleNewAndDelete(mp);
+        handleNewAndDelete(mp);
+        iterateFullBlocks(mp, 64, 1);
+    }
+    {
+        // every index value including the largest is a valid entry
+        FixedObjectPool<uint32_t, ObjectPoolIndexTraits<255>> mp(255);
+        iterateSparse(mp, 255);
+        std::vector<uint32_t*> v(256, nullptr);
+        CHECK(mp.new_objects(255, v.data()) == 255u);
+        CHECK(mp.new_object() == nullptr);
+        mp.for_each([&mp](uint32_t* p)
+            {
+                CHECK(mp.get_object(mp.get_handle(p)) == p);
+            });
+        mp.delete_all();
+    }
+    {
+        FixedObjectPool<uint32_t, BitmapIndex8Traits> mp(255);
+        iterateSparse(mp, 255);
+    }
+    {
+        FixedObjectPool<uint32_t, ObjectPoolIndexTraits<1000>> mp(1000);
+        iterateSparse(mp, 1000);
+    }
+    {
+        FixedObjectPool<uint32_t, Index64Traits> mp(1000);
+        handleNewAndDelete(mp);
+        iterateSparse(mp, 1000);
+    }
+}
+
+TEST_CASE("DynamicObjectPool index widths", "[dynamicpool]")
+{
+    {
+        DynamicObjectPool<uint32_t, ObjectPoolIndexTraits<64>> mp(64);
+        singleNewAndDelete(mp);
+        doubleNewAndDelete(mp);
+        handleNewAndDelete(mp);
+        iterateFullBlocks(mp, 128, 2);
+    }
+    {
+        // counts across blocks are wider than the per block index
+        DynamicObjectPool<uint32_t, ObjectPoolIndexTraits<255>> mp(255);
+        batchNewAndDelete(mp, 1000);
+    }
+    {
+        DynamicObjectPool<uint32_t, ObjectPoolIndexTraits<255>> mp(255);
+        iterateSparse(mp, 1000);
+    }
+    {
+        DynamicObjectPool<uint32_t, BitmapIndex8Traits> mp(100);
+        iterateSparse(mp, 1000);
+    }
+    {
+        DynamicObjectPool<uint32_t, ObjectPoolIndexTraits<1000>> mp(1000);
+        batchNewAndDelete(mp, 3000);
+    }
+    {
+        DynamicObjectPool<uint32_t, Index64Traits> mp(64);
+        handleNewAndDelete(mp);
+        iterateSparse(mp, 1000);
+    }
+}
+
+template <typename Traits>
+void blockHighWater(detail::index_t size)
+{
+    typedef detail::ObjectPoolBlock<uint32_t, Traits> Block;
+    typedef typename Block::index_t index_t;
+    // stale metadata which would read as live entries if it were trusted
+    std::vector<uint8_t> storage(Block::alloc_size(size) + Block::block_align(), 0xff);
+    uint8_t* memory = storage.data() +
+        (detail::align_to(reinterpret_cast<uintptr_t>(storage.data()), Block::block_align()) -
+            reinterpret_cast<uintptr_t>(storage.data()));
+    index_t* stale_indices = reinterpret_cast<index_t*>(memory + sizeof(Block));
+    for (detail::index_t i = 0; i < size; ++i)
+    {
+        stale_indices[i] = static_cast<index_t>(i);
+    }
+    Block* block = Block::create_at(memory, size, 5);
+    const uint32_t* entries = block->memory_offset();
+    CHECK(block->num_allocations() == 0u);
+    block->for_each([](const uint32_t*)
+        {
+            FAIL("unused entries are free");
+        });
+    block->for_each_run([](index_t, index_t)
+        {
+            FAIL("unused entries are free");
+        });
+    CHECK(block->get_object(0, 5) == nullptr);
+    CHECK(block->get_object(0, 0xffffffff) == nullptr);
+
+    // entries are used in order and start at the initial generation
+    uint32_t* p0 = block->new_object(0u);
+    uint32_t* p1 = block->new_object(1u);
+    uint32_t* p2 = block->new_object(2u);
+    CHECK(p0 == entries);
+    CHECK(p1 == entries + 1);
+    CHECK(p2 == entries + 2);
+    CHECK(block->generation_of(0) == 5u);
+    CHECK(block->get_object(0, 5) == p0);
+    CHECK(block->num_allocations() == 3u);
+    block->delete_object(p1);
+    CHECK(block->new_object(3u) == p1);
+    CHECK(block->new_object(4u) == entries + 3);
+    size_t count = 0;
+    block->for_each([&count](const uint32_t*)
+        {
+            ++count;
+        });
+    CHECK(count == 4u);
+    block->for_each_in_range([](const uint32_t*)
+        {
+            FAIL("entries past the high water index are free");
+        },
+        64, 128);
+
+    // delete_all reuses entries from the start with a newer generation
+    const detail::generation_t generation = block->generation_of(0);
+    block->delete_all();
+    CHECK(block->num_allocations() == 0u);
+    uint32_t* p = block->new_object(5u);
+    CHECK(p == p0);
+    CHECK(block->get_object(0, generation) == nullptr);
+    CHECK(block->generation_of(0) > generation);
+    CHECK(block->get_object(0, block->generation_of(0)) == p);
+    CHECK(block->next_generation() > block->generation_of(0));
+    block->delete_object(p);
+    Block::destroy_at(block);
+}
+
+TEST_CASE("Block high water index", "[block]")
+{
+    blockHighWater<ObjectPoolTraits>(1000);
+    blockHighWater<BitmapTraits>(1000);
+    blockHighWater<ObjectPoolIndexTraits<255>>(255);
+    blockHighWater<BitmapIndex8Traits>(255);
+}
+
 TEST_CASE("FixedObjectPool iterate full block", "[fixedpool]")
 {
     FixedObjectPool<uint32_t> mp(64);
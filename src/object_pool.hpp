@@ -20,33 +20,93 @@
 #ifndef _BITS_OBJECT_POOL_HPP_
 #define _BITS_OBJECT_POOL_HPP_
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <memory>
+#include <type_traits>
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 /// Internal details - look below this namespace for public classes!
 namespace detail
 {
 /// Default index type, this dictates the maximum number of entries in a
-/// single pool block.
+/// single pool block. Pools may use another entry index type through their
+/// Traits, block counts and identifiers always use this type.
 typedef uint32_t index_t;
 
+/// The narrowest unsigned type able to index a block of Capacity entries.
+/// An index equal to the number of entries marks the end of the free list,
+/// so Capacity itself must be representable.
+template <uint64_t Capacity>
+struct IndexForCapacity
+{
+    typedef typename std::conditional<(Capacity <= UINT8_MAX), uint8_t,
+        typename std::conditional<(Capacity <= UINT16_MAX), uint16_t,
+            typename std::conditional<(Capacity <= UINT32_MAX), uint32_t,
+                uint64_t>::type>::type>::type type;
+};
+
+/// The index type stored in handles, the entry index type widened to at
+/// least index_t so narrow pools share ObjectPoolHandle
+template <typename IndexT>
+struct HandleIndex
+{
+    typedef typename std::conditional<(sizeof(IndexT) > sizeof(index_t)), IndexT, index_t>::type
+        type;
+};
+
+/// Generation counter type. Each entry's generation is incremented when it
+/// is deleted so handles to deleted objects can be detected.
+typedef uint32_t generation_t;
+
+/// Occupancy bitmap word type
+typedef uint64_t bitmap_word_t;
+
 /// Base object pool block. This contains a list of indices of free and used
-/// entries and the storage for the entries themselves. Everything is allocated
-/// in a single allocation in the static create function, and indices_begin()
-/// and memory_begin() methods will return pointers offset from this for their
-/// respective data.
-template <typename T>
+/// entries, a generation counter per entry, an optional occupancy bitmap and
+/// the storage for the entries themselves. Everything is allocated in a
+/// single allocation in the static create function, and indices_begin(),
+/// generations_begin(), bitmap_begin() and memory_begin() methods will return
+/// pointers offset from this for their respective data.
+template <typename T, typename Traits>
 class ObjectPoolBlock
 {
+public:
+    /// Entry index type, see ObjectPoolTraits::index_type
+    typedef typename Traits::index_type index_t;
+
+private:
+    static_assert(std::is_unsigned<index_t>::value, "index_type must be an unsigned integer");
+
+    typedef std::integral_constant<bool, Traits::occupancy_bitmap> has_bitmap_t;
+    typedef std::integral_constant<bool, Traits::huge_pages> huge_pages_t;
+
     /// Index of the first free entry
     index_t free_head_index_;
+    /// Entries from this index on have not been used since the block was
+    /// created or last had delete_all called. They are implicitly free, each
+    /// followed by the next in the free list, and their indices, generations
+    /// and occupancy bits are only initialised on first use.
+    index_t high_water_index_;
     const index_t entries_per_block_;
+    /// Index of this block in the owning pool's block list
+    detail::index_t owner_index_;
+    /// Stable identifier of this block used by handles
+    detail::index_t block_id_;
+    /// Generation entries start at when first used
+    generation_t initial_generation_;
+    /// Pool owning this block, for pools found from their objects
+    void* pool_;
 
     /// Constructor and destructor are private as create and destroy should
     /// be used instead.
-    ObjectPoolBlock(index_t entries_per_block);
+    ObjectPoolBlock(index_t entries_per_block, generation_t generation);
     ~ObjectPoolBlock();
 
     ObjectPoolBlock(const ObjectPoolBlock&) = delete;
@@ -55,16 +115,147 @@ class ObjectPoolBlock
     /// returns start of indices
     index_t* indices_begin() const;
 
+    /// returns start of generation counters
+    generation_t* generations_begin() const;
+
+    /// returns start of the occupancy bitmap if the block has one
+    bitmap_word_t* bitmap_begin() const;
+
+    /// returns the number of occupancy bitmap words for the given entries
+    static size_t num_bitmap_words(index_t entries_per_block);
+
+    /// set and clear occupancy bits if the block has a bitmap
+    void set_occupied(index_t index, std::true_type);
+    void set_occupied(index_t index, std::false_type);
+    void clear_occupied(index_t index, std::true_type);
+    void clear_occupied(index_t index, std::false_type);
+
+    /// clears an occupancy word when the first entry it covers is first used
+    void init_occupied_word(index_t index, std::true_type);
+    void init_occupied_word(index_t index, std::false_type);
+
+    /// Returns the entry after the given free entry in the free list. If it
+    /// is the high water index, the entry is initialised and the mark raised.
+    index_t next_free(index_t* indices, index_t index);
+
+    /// for_each and num_allocations using either the bitmap or the indices
+    template <typename F>
+    void for_each(const F func, index_t first, index_t last, std::true_type) const;
+    template <typename F>
+    void for_each(const F func, index_t first, index_t last, std::false_type) const;
+    index_t num_allocations(std::true_type) const;
+    index_t num_allocations(std::false_type) const;
+
+    /// for_each_run using either the bitmap or the indices
+    template <typename F>
+    void for_each_run(const F func, std::true_type) const;
+    template <typename F>
+    void for_each_run(const F func, std::false_type) const;
+
+    /// for_each_occupancy_word using either the bitmap or the indices
+    template <typename F>
+    void for_each_occupancy_word(const F& func, std::true_type) const;
+    template <typename F>
+    void for_each_occupancy_word(const F& func, std::false_type) const;
+
+    /// Finds the run boundaries in occupancy words for entries from base,
+    /// carrying the start of an unfinished run in run_first, or
+    /// entries_per_block_ if not in a run.
+    template <typename F>
+    void runs_in_words(const F& func, const bitmap_word_t* words, index_t num_words,
+        index_t base, index_t& run_first) const;
+
     /// returns start of pool memory
     T* memory_begin() const;
 
+    /// returns the entry at index given the start of pool memory, entries
+    /// are EntrySize apart
+    static T* entry_at(T* memory, index_t index);
+
+    /// allocate and free block storage, with huge pages if configured
+    static void* alloc_storage(size_t size, size_t align, std::true_type);
+    static void* alloc_storage(size_t size, size_t align, std::false_type);
+    static void free_storage(void* ptr, size_t size, std::true_type);
+    static void free_storage(void* ptr, size_t size, std::false_type);
+    static size_t storage_align(std::true_type);
+    static size_t storage_align(std::false_type);
+    static void advise_storage(void* ptr, size_t size, std::true_type);
+    static void advise_storage(void* ptr, size_t size, std::false_type);
+
 public:
+    /// Returns the size in bytes of a single allocation containing the
+    /// block header, indices and storage for the given number of entries.
+    static size_t alloc_size(index_t entries_per_block);
+
+    /// Returns the size in bytes create allocates, which is alloc_size
+    /// rounded up to a whole huge page if huge pages are used.
+    static size_t storage_size(index_t entries_per_block);
+
+    /// Returns the size in bytes of everything but entry storage
+    static size_t metadata_size(index_t entries_per_block);
+
+    /// Returns the alignment block storage must have for entries to be
+    /// aligned, the larger of MIN_BLOCK_ALIGN and the entry alignment.
+    static size_t block_align();
+
     /// Creates to ObjectPoolBlock object and storage in a single aligned
-    /// allocation.
-    static ObjectPoolBlock<T>* create(index_t entries_per_block);
+    /// allocation. The alignment must be a power of two of at least
+    /// block_align(). All entries start at the given generation.
+    static ObjectPoolBlock<T, Traits>* create(
+        index_t entries_per_block, size_t align, generation_t generation = 0);
+
+    /// Constructs an ObjectPoolBlock in existing memory of at least
+    /// alloc_size() bytes aligned to block_align(), which must stay valid
+    /// until destroy_at is called.
+    static ObjectPoolBlock<T, Traits>* create_at(
+        void* memory, index_t entries_per_block, generation_t generation = 0);
+
+    /// Returns the block containing the given pointer. The block must have
+    /// been created with an alignment of at least alloc_size(), which is a
+    /// power of two given as block_align.
+    static ObjectPoolBlock<T, Traits>* from_pointer(const T* ptr, size_t block_align);
 
     /// Destroys the ObjectPoolBlock and associated storage.
-    static void destroy(ObjectPoolBlock<T>* ptr);
+    static void destroy(ObjectPoolBlock<T, Traits>* ptr);
+
+    /// Destroys an ObjectPoolBlock created by create_at without freeing its
+    /// memory.
+    static void destroy_at(ObjectPoolBlock<T, Traits>* ptr);
+
+    /// Returns the alignment memory passed to create_at should have to make
+    /// best use of the configured page size.
+    static size_t storage_align();
+
+    /// Advises the OS of the configured page size for memory which blocks
+    /// will be created in with create_at.
+    static void advise_storage(void* ptr, size_t size);
+
+    /// Takes an entry off the free list without constructing it. The entry is
+    /// not treated as allocated until construct_reserved is called. Returns
+    /// nullptr if there is no available space.
+    T* reserve_entry();
+
+    /// Returns a reserved entry which is not constructed to the free list.
+    void unreserve_entry(const T* ptr);
+
+    /// Takes up to count entries off the free list in a single pass without
+    /// constructing them, storing them in entries. The free list head is
+    /// only written once. Returns the number of entries reserved.
+    index_t reserve_entries(T** entries, index_t count);
+
+    /// Returns reserved entries which are not constructed to the free list,
+    /// writing the free list head once. All entries must be in this block.
+    void unreserve_entries(T* const* entries, index_t count);
+
+    /// Constructs an object in a reserved entry, flagging it as allocated.
+    /// Only the given entry's metadata is modified, so different entries
+    /// may be constructed concurrently if the block has no occupancy bitmap.
+    template <class... P>
+    T* construct_reserved(T* ptr, P&&... params);
+
+    /// Destructs an allocated object, leaving its entry reserved. Only the
+    /// given entry's metadata is modified.
+    void destruct_reserved(const T* ptr);
 
     /// Allocates a new object from this block. Returns nullptr if there is
     /// no available space.
@@ -74,44 +265,258 @@ public:
     /// Deletes the given pointer. The pointer must be owned by this block.
     void delete_object(const T* ptr);
 
-    /// Delete all current allocations and reinitialise the block
+    /// Constructs up to count objects from copies of params in a single pass
+    /// of the free list, storing them in out_ptrs. The free list head is only
+    /// written once. Returns the number of objects created.
+    template <class... P>
+    index_t new_objects(index_t count, T** out_ptrs, const P&... params);
+
+    /// Deletes count objects owned by this block in a single pass, writing
+    /// the free list head once.
+    void delete_objects(T* const* ptrs, index_t count);
+
+    /// Delete all current allocations and reset the high water index, in
+    /// time proportional to the high water index rather than the block size
     void delete_all();
 
+    /// Returns the physical pages wholly inside entry storage to the OS,
+    /// keeping the address range and block metadata. The block must be
+    /// empty. The pages read as zero or stale data until written again. If
+    /// lazy, the OS only takes the pages under memory pressure.
+    void discard_entries(bool lazy) const;
+
     /// Calls given function for all allocated entries
     template <typename F>
     void for_each(const F func) const;
 
+    /// Calls func(first, last) for each run of consecutive allocated
+    /// entries with indices in [first, last), found a word of occupancy at a
+    /// time.
+    template <typename F>
+    void for_each_run(const F func) const;
+
+    /// Calls func(first, word) for each word of occupancy bits, bit i set if
+    /// entry first + i is allocated, up to the high water index. Entries
+    /// past the last allocated one may have no word.
+    template <typename F>
+    void for_each_occupancy_word(const F func) const;
+
+    /// Calls given function for allocated entries with indices in
+    /// [first, last). Both must be multiples of 64, or last the number of
+    /// entries in the block.
+    template <typename F>
+    void for_each_in_range(const F func, index_t first, index_t last) const;
+
+    /// returns the number of entries in the block
+    index_t num_entries() const;
+
     /// returns start of pool memory
     const T* memory_offset() const;
 
     /// Calculates the number of allocated entries
     index_t num_allocations() const;
+
+    /// Gets and sets the index of this block in the owning pool's block list
+    detail::index_t owner_index() const;
+    void set_owner_index(detail::index_t index);
+
+    /// Gets and sets the stable identifier of this block used by handles
+    detail::index_t block_id() const;
+    void set_block_id(detail::index_t id);
+
+    /// Gets and sets the pool owning this block, nullptr unless set
+    void* pool() const;
+    void set_pool(void* pool);
+
+    /// Returns the entry index of the given pointer. The pointer must be
+    /// owned by this block.
+    index_t index_of(const T* ptr) const;
+
+    /// Returns the current generation of the given entry index
+    generation_t generation_of(index_t index) const;
+
+    /// Returns the allocated object at the given entry index if it is in
+    /// range and its generation matches, otherwise nullptr.
+    T* get_object(uint64_t index, generation_t generation) const;
+
+    /// Returns a generation greater than that of any entry in this block
+    generation_t next_generation() const;
+
+    /// Moves up to max_count live objects from this block into free entries
+    /// of dst, calling func(old_ptr, new_ptr) after each move. Moved entries
+    /// are freed and their generations advanced. Returns the number moved.
+    template <typename F>
+    index_t move_objects_to(ObjectPoolBlock& dst, index_t max_count, const F func);
+
+private:
+    /// move an object to uninitialised memory, destructing the original
+    static void relocate(T* dst, T* src, std::true_type);
+    static void relocate(T* dst, T* src, std::false_type);
+};
+
+/// Allocation counters maintained by the pools so stats are constant time
+struct PoolCounters
+{
+    size_t num_allocations = 0;
+    size_t high_water_mark = 0;
+    size_t total_allocations = 0;
+    size_t total_frees = 0;
+    size_t failed_allocations = 0;
+
+    void allocated(size_t count)
+    {
+        num_allocations += count;
+        total_allocations += count;
+        high_water_mark = std::max(high_water_mark, num_allocations);
+    }
+
+    void freed(size_t count)
+    {
+        assert(count <= num_allocations);
+        num_allocations -= count;
+        total_frees += count;
+    }
+
+    void failed(size_t count) { failed_allocations += count; }
 };
 
 } // namespace detail
 
 
+/// Default object pool configuration. To change the configuration derive
+/// from this and hide the members to be changed, then pass the derived type
+/// as the pool's Traits template parameter.
+struct ObjectPoolTraits
+{
+    /// Track occupancy with one bit per entry as well as the free list
+    /// indices. for_each and calc_stats then skip 64 free entries at a time,
+    /// so iterating a sparse pool costs in proportion to its live objects
+    /// rather than its capacity.
+    static const bool occupancy_bitmap = false;
+
+    /// Back block storage with transparent huge pages where the OS supports
+    /// them, reducing TLB misses when iterating large pools. Each block is
+    /// mapped separately and rounded up to a whole huge page, so use large
+    /// blocks or a DynamicObjectPool reservation, which is advised as a whole.
+    static const bool huge_pages = false;
+
+    /// Align and pad each entry to whole cache lines so no two objects share
+    /// a line. Objects written by different threads then never invalidate
+    /// each other's cache lines (false sharing), at the cost of the padding
+    /// for types smaller than a cache line.
+    static const bool cache_line_padding = false;
+
+    /// Unsigned integer type of the free list entry per slot, which limits
+    /// the number of entries in a block to its maximum value. Narrower types
+    /// shrink block metadata and keep more of the free list in cache, wider
+    /// ones allow FixedObjectPools of more than 4G entries. See
+    /// ObjectPoolIndexTraits to choose the narrowest type for a capacity.
+    typedef uint32_t index_type;
+};
+
+
+/// Traits using the narrowest index type able to hold Capacity entries per
+/// block: uint8_t up to 255 entries, uint16_t up to 65535 and so on. Other
+/// configuration is inherited from Base.
+template <uint64_t Capacity, typename Base = ObjectPoolTraits>
+struct ObjectPoolIndexTraits : Base
+{
+    typedef typename detail::IndexForCapacity<Capacity>::type index_type;
+};
+
+
+/// Whether T can be relocated by copying its bytes, without calling the
+/// move constructor or the destructor of the original. Defaults to trivially
+/// copyable types. Specialise to std::true_type for types such as those only
+/// owning heap memory through pointers, which are safe to memcpy as long as
+/// the original is never destructed.
+template <typename T>
+struct ObjectPoolRelocatable : std::is_trivially_copyable<T>
+{
+};
+
+
+/// How DynamicObjectPool::reclaim_memory treats empty blocks
+enum class ObjectPoolReclaim
+{
+    /// Destroy empty blocks, returning their memory to the allocator. One
+    /// empty block is kept.
+    Free,
+    /// Keep empty blocks and their metadata but return the physical pages
+    /// of their entry storage to the OS immediately (MADV_DONTNEED). Blocks
+    /// keep their addresses and are reused without reinitialisation.
+    Discard,
+    /// As Discard, but the OS only takes the pages under memory pressure
+    /// (MADV_FREE), making reuse cheaper still.
+    LazyDiscard
+};
+
+
 /// Object pool statistics structure used for returning information about
 /// pool usage.
 struct ObjectPoolStats
 {
+    /// blocks currently allocated
     size_t num_blocks = 0;
+    /// entries currently in use, including entries reserved but not
+    /// constructed
     size_t num_allocations = 0;
+    /// the largest num_allocations has been
+    size_t high_water_mark = 0;
+    /// the largest num_blocks has been
+    size_t peak_blocks = 0;
+    /// bytes of memory allocated or committed for blocks
+    size_t bytes_reserved = 0;
+    /// bytes of block headers, indices, generations, bitmaps and pool
+    /// bookkeeping, i.e. everything but entry storage
+    size_t bytes_metadata = 0;
+    /// entries allocated over the pool's lifetime
+    size_t total_allocations = 0;
+    /// entries freed over the pool's lifetime
+    size_t total_frees = 0;
+    /// requested entries which could not be allocated
+    size_t failed_allocations = 0;
+};
+
+
+/// Handle to an object allocated from a FixedObjectPool or
+/// DynamicObjectPool. A handle remains safe to store after its object is
+/// deleted; resolving it through the pool returns nullptr from then on.
+/// Default constructed handles never resolve to an object. Pools with 64 bit
+/// entry indices use 64 bit handle indices, all others ObjectPoolHandle.
+template <typename IndexT>
+struct BasicObjectPoolHandle
+{
+    detail::index_t block = ~detail::index_t(0);
+    IndexT index = 0;
+    detail::generation_t generation = 0;
 };
 
+typedef BasicObjectPoolHandle<detail::index_t> ObjectPoolHandle;
+
 
 /// FixedObjectPool contains a single ObjectPoolBlock, it will not grow
 /// beyond the max number of entries given at construction time.
-template <typename T>
+///
+/// The block is aligned to the next power of two of its size and registered
+/// with a pointer back to the pool, so from_pointer can find the pool owning
+/// an object without any other reference to it.
+template <typename T, typename Traits = ObjectPoolTraits>
 class FixedObjectPool
 {
 public:
-    typedef detail::index_t index_t;
+    typedef typename Traits::index_type index_t;
     typedef T value_t;
+    typedef BasicObjectPoolHandle<typename detail::HandleIndex<index_t>::type> Handle;
 
+    /// If the block can't be registered the pool has no entries
     FixedObjectPool(index_t max_entries);
     ~FixedObjectPool();
 
+    /// Returns the pool owning the given live object, which must be from a
+    /// FixedObjectPool of this type
+    static FixedObjectPool* from_pointer(const T* ptr);
+
     /// Constructs a new object from the pool. Returns nullptr if there is no
     /// available space.
     template <class... P>
@@ -120,19 +525,57 @@ public:
     /// Deletes the given pointer. The pointer must be owned by the pool.
     void delete_object(const T* ptr);
 
+    /// Constructs up to count new objects, each from copies of params, and
+    /// stores them in out_ptrs. Entries are taken from the free list in one
+    /// pass. Returns the number of objects created, which is less than count
+    /// if there is no more space.
+    template <class... P>
+    index_t new_objects(index_t count, T** out_ptrs, const P&... params);
+
+    /// Deletes count objects, returning their entries to the free list in
+    /// one pass. The pointers must be live objects owned by the pool.
+    void delete_objects(T* const* ptrs, index_t count);
+
     /// Delete all current allocations
     void delete_all();
 
+    /// Returns a handle to the given pointer. The pointer must be a live
+    /// object owned by the pool.
+    Handle get_handle(const T* ptr) const;
+
+    /// Returns the object referred to by the handle, or nullptr if the object
+    /// has since been deleted.
+    T* get_object(Handle handle) const;
+
     /// Calls the given function for all allocated entries
     template <typename F>
     void for_each(const F func) const;
 
-    /// Calculates object pool stats
+    /// Calls the given function for all allocated entries, splitting the
+    /// block into ranges of entries which are run by the given executor.
+    /// The function may be called concurrently for different entries.
+    ///
+    /// An executor must provide:
+    ///   size_t num_workers() const
+    ///     the number of tasks work should be split into.
+    ///   template <typename F> void run(size_t num_tasks, const F& task)
+    ///     calls task(i) for each i in [0, num_tasks), possibly in parallel,
+    ///     returning once every call has completed.
+    /// ThreadPoolExecutor in concurrent_object_pool.hpp is a simple
+    /// implementation using std::thread.
+    template <typename F, typename E>
+    void parallel_for_each(const F func, E& executor) const;
+
+    /// Returns object pool stats in constant time
     ObjectPoolStats calc_stats() const;
 
 private:
-    typedef detail::ObjectPoolBlock<T> Block;
+    typedef detail::ObjectPoolBlock<T, Traits> Block;
     Block* block_;
+    detail::PoolCounters counters_;
+
+    /// Returns the block alignment, at least the block's size
+    static size_t calc_block_align(index_t max_entries);
 
     FixedObjectPool(const FixedObjectPool&) = delete;
     FixedObjectPool& operator=(const FixedObjectPool&) = delete;
@@ -140,14 +583,36 @@ private:
 
 
 /// DynamicObjectPool contains a dynamic array of ObjectPoolBlocks.
-template <typename T>
+///
+/// Each block is aligned to the next power of two of its size so the block
+/// owning any pointer can be found by masking the pointer's low bits, which
+/// makes delete_object constant time regardless of the number of blocks.
+///
+/// By default each block is a separate heap allocation. If a reserve size is
+/// given the pool instead reserves that much virtual address space up front
+/// and commits blocks into it as needed, so blocks are contiguous, growing
+/// never copies the pool's bookkeeping and new_object returns nullptr once
+/// the reservation is full.
+template <typename T, typename Traits = ObjectPoolTraits>
 class DynamicObjectPool
 {
 public:
-    typedef detail::index_t index_t;
+    typedef typename Traits::index_type index_t;
     typedef T value_t;
-
-    DynamicObjectPool(index_t entries_per_block);
+    typedef BasicObjectPoolHandle<typename detail::HandleIndex<index_t>::type> Handle;
+
+    /// NUMA node values for set_numa_node. NUMA_NODE_ANY leaves blocks on
+    /// whichever node first touches them, NUMA_NODE_CALLER places each block
+    /// on the node of the thread which adds it.
+    static const int NUMA_NODE_ANY = -1;
+    static const int NUMA_NODE_CALLER = -2;
+
+    /// Creates a pool with the given number of entries per block. If
+    /// reserve_size is non-zero, at least that many bytes of address space
+    /// are reserved for blocks and no more blocks are added once it is used.
+    /// New blocks are placed on the given NUMA node, see set_numa_node.
+    DynamicObjectPool(
+        index_t entries_per_block, size_t reserve_size = 0, int numa_node = NUMA_NODE_ANY);
     ~DynamicObjectPool();
 
     /// Constructs a new object from the pool. Returns nullptr if there is no
@@ -158,21 +623,114 @@ public:
     /// Deletes the given pointer. The pointer must be owned by the pool.
     void delete_object(const T* ptr);
 
+    /// Constructs up to count new objects, each from copies of params, and
+    /// stores them in out_ptrs. Each block with free space is visited once
+    /// and its entries taken in a single pass of its free list. Returns the
+    /// number of objects created, which is less than count only if a block
+    /// could not be allocated.
+    template <class... P>
+    detail::index_t new_objects(detail::index_t count, T** out_ptrs, const P&... params);
+
+    /// Deletes count objects. Consecutive pointers in the same block are
+    /// returned to its free list together, updating the block's free count
+    /// and the first free block once per run, so deleting objects in the
+    /// order new_objects created them costs one update per block. The
+    /// pointers must be live objects owned by the pool.
+    void delete_objects(T* const* ptrs, detail::index_t count);
+
     /// Delete all current allocations
     void delete_all();
 
-    /// Reclaim unused object pool blocks
-    void reclaim_memory();
+    /// Reclaim unused object pool blocks. When freeing, blocks in a reserved
+    /// address range are decommitted, keeping their addresses for reuse.
+    void reclaim_memory(ObjectPoolReclaim mode = ObjectPoolReclaim::Free);
+
+    /// Moves live objects out of the sparsest blocks into free entries of
+    /// the densest blocks on the same NUMA node, then frees the emptied
+    /// blocks as reclaim_memory does. func(old_ptr, new_ptr) is called after
+    /// each object is moved so references to it can be updated; old_ptr no
+    /// longer points to an object. Handles to moved objects become stale.
+    /// Objects are moved with memcpy if ObjectPoolRelocatable, otherwise
+    /// move constructed and the original destructed. Entries reserved but
+    /// not constructed stay where they are. Returns the number of objects
+    /// moved.
+    template <typename F>
+    size_t compact(const F func);
+
+    /// Compacts the pool without reporting moved objects, for pools whose
+    /// objects are only reached through for_each.
+    size_t compact();
+
+    /// Takes up to count free entries without constructing them, adding
+    /// blocks as needed, and stores them in entries. Returns the number of
+    /// entries reserved, which is only less than count if a block could not
+    /// be allocated. Reserved entries are not visited by for_each.
+    detail::index_t reserve_entries(T** entries, detail::index_t count);
+
+    /// Returns reserved entries which are not constructed to the pool.
+    void release_entries(T* const* entries, detail::index_t count);
+
+    /// Constructs an object in a reserved entry. Only the entry's own
+    /// metadata is modified, so without an occupancy bitmap different
+    /// entries may be constructed concurrently with each other.
+    template <class... P>
+    T* construct_reserved(T* ptr, P&&... params);
+
+    /// Destructs an allocated object, leaving its entry reserved. As with
+    /// construct_reserved, different entries may be destructed concurrently.
+    void destruct_reserved(const T* ptr);
+
+    /// Returns a handle to the given pointer. The pointer must be a live
+    /// object owned by the pool.
+    Handle get_handle(const T* ptr) const;
+
+    /// Returns the object referred to by the handle, or nullptr if the object
+    /// has since been deleted.
+    T* get_object(Handle handle) const;
 
     /// Calls the given function for all allocated entries
     template <typename F>
     void for_each(const F func) const;
 
-    /// Calculates object pool stats
+    /// Sets the NUMA node new blocks are placed on, or NUMA_NODE_ANY or
+    /// NUMA_NODE_CALLER. Placement is a preference, falling back to other
+    /// nodes when the node is out of memory. Existing blocks are not moved.
+    /// Has no effect on machines or platforms without NUMA support.
+    void set_numa_node(int node);
+
+    /// Returns the NUMA node new blocks are placed on
+    int numa_node() const;
+
+    /// Registers the pool's blocks, now and as they are added, with a
+    /// pointer to the given owner, so find_owner can find it from any of
+    /// their objects without a pointer per object. May only be called once,
+    /// before any objects are allocated. A block which can't be registered
+    /// fails to be added, as if it could not be allocated.
+    void set_owner(void* owner);
+
+    /// Returns the owner set on the pool holding the given live object
+    static void* find_owner(const T* ptr);
+
+    /// Calls the given function for all allocated entries in blocks on the
+    /// given NUMA node, so workers can process node local memory. Without
+    /// NUMA support every block is on node 0.
+    template <typename F>
+    void for_each_on_node(int node, const F func) const;
+
+    /// Calls the given function for all allocated entries, splitting blocks
+    /// between tasks run by the given executor so each task has a similar
+    /// number of live objects. The function may be called concurrently for
+    /// different entries. See FixedObjectPool for executor requirements.
+    template <typename F, typename E>
+    void parallel_for_each(const F func, E& executor) const;
+
+    /// Returns object pool stats in constant time. Entries taken by
+    /// reserve_entries count as allocations until released, whether or not
+    /// they are constructed.
     ObjectPoolStats calc_stats() const;
 
 private:
-    typedef detail::ObjectPoolBlock<T> Block;
+    typedef detail::ObjectPoolBlock<T, Traits> Block;
 
     /// The BlockInfo struct keeps regularly accessed block information
     /// packed together for better memory locality.
@@ -180,24 +738,78 @@ private:
     {
         /// cache the number of free entries for this block
         index_t num_free_;
-        /// cache the offset of object memory from the start of the block
-        const T* offset_;
+        /// the NUMA node the block's memory is on, narrow so the flag below
+        /// doesn't grow the struct
+        int16_t numa_node_;
+        /// true if the block was mapped for its NUMA node rather than
+        /// allocated from the heap
+        bool mapped_;
         /// pointer to the block itself
         Block* block_;
     };
 
     /// storage for block info records
     BlockInfo* block_info_;
+    /// blocks indexed by their stable block id, nullptr for unused ids
+    Block** block_ids_;
+    /// number of block ids in use or previously used
+    detail::index_t num_block_ids_;
+    /// starting generation for new blocks, newer than any reclaimed block
+    detail::generation_t generation_base_;
     /// number of blocks allocated
-    index_t num_blocks_;
+    detail::index_t num_blocks_;
+    /// the largest num_blocks_ has been
+    detail::index_t peak_blocks_;
     /// index of the first block info with space
-    index_t free_block_index_;
+    detail::index_t free_block_index_;
     /// the number of entries in each block
     const index_t entries_per_block_;
+    /// the alignment of each block, a power of two no smaller than the block
+    /// and, if the pool has a reservation, no smaller than a page
+    const size_t block_align_;
+    /// start of the reserved address range, nullptr if blocks are allocated
+    /// from the heap or the reservation failed
+    void* reserve_memory_;
+    /// size in bytes of the reserved address range, 0 if blocks are
+    /// allocated from the heap
+    size_t reserve_size_;
+    /// first block address in the reserved range, aligned to block_align_
+    uint8_t* reserve_begin_;
+    /// the number of blocks that fit in the reserved range. The block with
+    /// id i lives at reserve_begin_ + i * block_align_.
+    detail::index_t max_blocks_;
+    /// the NUMA node new blocks are placed on
+    int numa_node_;
+    /// the owner blocks point back to, nullptr if they are not registered
+    void* owner_;
+    /// allocation counters for stats
+    detail::PoolCounters counters_;
+
+    /// Returns the block alignment for the given block size
+    static size_t calc_block_align(index_t entries_per_block, size_t reserve_size);
 
     /// Adds a new block and updates the free_block_index.
     BlockInfo* add_block();
 
+    /// Returns the size of a reserved or mapped block rounded up to whole
+    /// pages
+    size_t block_commit_size() const;
+
+    /// Creates a block with the given id, placed on the given NUMA node if
+    /// it isn't negative. Returns nullptr on failure.
+    Block* create_block(detail::index_t id, int node);
+
+    /// Destroys a block, decommitting its memory if it is in the reservation.
+    void destroy_block(const BlockInfo& info);
+
+    /// Returns the first block with a free entry, adding a block if needed.
+    /// Returns nullptr if a new block could not be allocated.
+    BlockInfo* find_free_block();
+
+    /// Adds entries returned to the given block to its free count and
+    /// updates the first free block index.
+    void add_free_entries(const Block* block, index_t count);
+
     DynamicObjectPool(const DynamicObjectPool&) = delete;
     DynamicObjectPool& operator=(const DynamicObjectPool&) = delete;
 };
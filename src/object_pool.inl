@@ -12,73 +12,324 @@ namespace detail
 {
 
 const uint32_t MIN_BLOCK_ALIGN = 64;
+const size_t CACHE_LINE_SIZE = 64;
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/// Alignment of pool entries, a whole cache line if Padded
+template <typename T, bool Padded>
+struct EntryAlign
+    : std::integral_constant<size_t,
+          (Padded && std::alignment_of<T>::value < CACHE_LINE_SIZE) ? CACHE_LINE_SIZE
+                                                                   : std::alignment_of<T>::value>
+{
+};
+
+/// Distance between pool entries, sizeof(T) rounded up to the entry alignment
+template <typename T, bool Padded>
+struct EntrySize
+    : std::integral_constant<size_t,
+          (sizeof(T) + EntryAlign<T, Padded>::value - 1) / EntryAlign<T, Padded>::value
+              * EntryAlign<T, Padded>::value>
+{
+};
 
 void* aligned_malloc(size_t size, size_t align);
 void aligned_free(void* ptr);
 
+/// Allocates memory backed by transparent huge pages where supported, the
+/// size is rounded up to a whole huge page
+void* huge_page_malloc(size_t size, size_t align);
+/// Frees memory allocated by huge_page_malloc with the same size
+void huge_page_free(void* ptr, size_t size);
+/// Advises the OS to back a range of address space with huge pages
+void virtual_advise_huge_pages(void* ptr, size_t size);
+
+/// Returns the number of NUMA nodes memory can be allocated on, 1 if the
+/// platform has no NUMA support
+int numa_num_nodes();
+/// Returns the NUMA node of the CPU the calling thread is running on
+int numa_current_node();
+/// Sets the preferred NUMA node of the pages fully inside the given range,
+/// moving any already touched pages. Returns false if this is unsupported.
+bool numa_bind(void* ptr, size_t size, int node);
+/// Returns the NUMA node of the page containing ptr, 0 if unknown
+int numa_node_of(const void* ptr);
+
+/// Returns the physical pages of a page aligned range to the OS while
+/// keeping it accessible. If lazy, the OS may keep them until under memory
+/// pressure.
+void virtual_discard(void* ptr, size_t size, bool lazy);
+
+/// Returns the virtual memory page size
+size_t virtual_page_size();
+/// Reserves an inaccessible range of address space, returns nullptr on failure
+void* virtual_reserve(size_t size);
+/// Releases a range reserved by virtual_reserve
+void virtual_release(void* ptr, size_t size);
+/// Maps readable and writable pages not shared with any other allocation,
+/// aligned to at least align. Returns nullptr on failure.
+void* virtual_alloc(size_t size, size_t align);
+/// Frees memory allocated by virtual_alloc with the same size
+void virtual_free(void* ptr, size_t size);
+/// Makes a page aligned part of a reserved range readable and writable
+bool virtual_commit(void* ptr, size_t size);
+/// Returns the physical memory backing a committed range to the OS and makes
+/// it inaccessible again, keeping the address range reserved
+void virtual_decommit(void* ptr, size_t size);
+
+/// Registers a block aligned to align, a power of two of at least
+/// MIN_BLOCK_ALIGN, so find_block_align can find it from pointers into it.
+/// Returns false if out of memory.
+bool register_block(const void* block, size_t align);
+/// Unregisters a block registered with the same alignment
+void unregister_block(const void* block, size_t align);
+/// Returns the alignment of the registered block containing ptr, 0 if none.
+/// Takes no lock and one hash lookup for each distinct alignment in use.
+size_t find_block_align(const void* ptr);
+
+/// Instruction sets scan_occupancy can use
+enum class ScanIsa
+{
+    Scalar,
+    SSE2,
+    AVX2
+};
+
+/// Sets bit j of the given bitmap words for each j in [0, count) where
+/// indices[first + j] == first + j, i.e. for each allocated entry. Uses the
+/// best instruction set supported by the CPU unless overridden by
+/// set_scan_isa. There is an overload for each index width; 64 bit indices
+/// are always compared one at a time.
+void scan_occupancy(const uint8_t* indices, size_t first, size_t count, bitmap_word_t* words);
+void scan_occupancy(const uint16_t* indices, size_t first, size_t count, bitmap_word_t* words);
+void scan_occupancy(const uint32_t* indices, size_t first, size_t count, bitmap_word_t* words);
+void scan_occupancy(const uint64_t* indices, size_t first, size_t count, bitmap_word_t* words);
+
+/// Returns the instruction set currently used by scan_occupancy
+ScanIsa get_scan_isa();
+
+/// Selects the instruction set used by scan_occupancy. Returns false and
+/// leaves the selection unchanged if the CPU does not support it.
+bool set_scan_isa(ScanIsa isa);
+
+/// Number of entries scan_occupancy is called with at a time when a block
+/// has no occupancy bitmap
+const size_t SCAN_CHUNK_ENTRIES = 256;
+
 // Aligns n to align. N will be unchanged if it is already aligned
 inline size_t align_to(size_t n, size_t align)
 {
     return (1 + (n - 1) / align) * align;
 }
 
-template <typename T>
-ObjectPoolBlock<T>* ObjectPoolBlock<T>::create(index_t entries_per_block)
+// Returns the smallest power of two greater than or equal to n
+inline size_t next_pow2(size_t n)
 {
-    // the header size
-    const size_t header_size = sizeof(ObjectPoolBlock<T>);
-#if _MSC_VER <= 1800
-    const size_t entry_align = __alignof(T);
+    size_t pow2 = 1;
+    while (pow2 < n)
+    {
+        pow2 <<= 1;
+    }
+    return pow2;
+}
+
+// Returns the number of trailing zero bits in a non-zero word
+inline uint32_t count_trailing_zeros(bitmap_word_t word)
+{
+    assert(word != 0);
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(word));
+#endif
+}
+
+// Returns the number of set bits in a word
+inline uint32_t count_bits(bitmap_word_t word)
+{
+#if defined(_MSC_VER)
+    return static_cast<uint32_t>(__popcnt64(word));
 #else
-    const size_t entry_align = alignof(T);
+    return static_cast<uint32_t>(__builtin_popcountll(word));
 #endif
-    // extend indices size by alignment of T
-    // const size_t indices_size = align_to(sizeof(index_t) * entries_per_block, entry_align);
+}
+
+template <typename T, typename Traits>
+size_t ObjectPoolBlock<T, Traits>::num_bitmap_words(index_t entries_per_block)
+{
+    const size_t bits = sizeof(bitmap_word_t) * 8;
+    return Traits::occupancy_bitmap ? (entries_per_block + bits - 1) / bits : 0;
+}
+
+template <typename T, typename Traits>
+size_t ObjectPoolBlock<T, Traits>::alloc_size(index_t entries_per_block)
+{
+    // the header size
+    const size_t header_size = sizeof(ObjectPoolBlock<T, Traits>);
     const size_t indices_size = align_to(sizeof(index_t) * entries_per_block, sizeof(index_t));
-    // align block to cache line size, or entry alignment if larger
-    const size_t entries_size = sizeof(T) * entries_per_block;
-    // block size includes indices + entry alignment + entries
-    const size_t block_size = header_size + indices_size + entries_size;
-    ObjectPoolBlock<T>* ptr =
-        reinterpret_cast<ObjectPoolBlock<T>*>(aligned_malloc(block_size, MIN_BLOCK_ALIGN));
-    if (ptr)
-    {
-        new (ptr) ObjectPoolBlock(entries_per_block);
-        assert(reinterpret_cast<uint8_t*>(ptr->indices_begin())
-            == reinterpret_cast<uint8_t*>(ptr) + header_size);
-        assert(reinterpret_cast<uint8_t*>(ptr->memory_begin())
-            == reinterpret_cast<uint8_t*>(ptr) + header_size + indices_size);
-    }
+    const size_t generations_size = sizeof(generation_t) * entries_per_block;
+    // the bitmap words are aligned, matching bitmap_begin()
+    const size_t bitmap_offset =
+        align_to(header_size + indices_size + generations_size, sizeof(bitmap_word_t));
+    const size_t bitmap_size = sizeof(bitmap_word_t) * num_bitmap_words(entries_per_block);
+    // entries start at the entry alignment, matching memory_begin()
+    const size_t entries_offset =
+        align_to(bitmap_offset + bitmap_size, EntryAlign<T, Traits::cache_line_padding>::value);
+    const size_t entries_size = EntrySize<T, Traits::cache_line_padding>::value * entries_per_block;
+    // block size includes indices + generations + bitmap + entry alignment + entries
+    return entries_offset + entries_size;
+}
+
+template <typename T, typename Traits>
+size_t ObjectPoolBlock<T, Traits>::storage_size(index_t entries_per_block)
+{
+    const size_t size = alloc_size(entries_per_block);
+    return storage_align() == HUGE_PAGE_SIZE ? align_to(size, HUGE_PAGE_SIZE) : size;
+}
+
+template <typename T, typename Traits>
+size_t ObjectPoolBlock<T, Traits>::metadata_size(index_t entries_per_block)
+{
+    return alloc_size(entries_per_block)
+        - EntrySize<T, Traits::cache_line_padding>::value * entries_per_block;
+}
+
+template <typename T, typename Traits>
+size_t ObjectPoolBlock<T, Traits>::block_align()
+{
+    return std::max<size_t>(MIN_BLOCK_ALIGN, EntryAlign<T, Traits::cache_line_padding>::value);
+}
+
+template <typename T, typename Traits>
+ObjectPoolBlock<T, Traits>* ObjectPoolBlock<T, Traits>::create(
+    index_t entries_per_block, size_t align, generation_t generation)
+{
+    assert(align >= block_align() && (align & (align - 1)) == 0);
+    void* memory = alloc_storage(alloc_size(entries_per_block), align, huge_pages_t());
+    return memory ? create_at(memory, entries_per_block, generation) : nullptr;
+}
+
+template <typename T, typename Traits>
+void* ObjectPoolBlock<T, Traits>::alloc_storage(size_t size, size_t align, std::true_type)
+{
+    return huge_page_malloc(size, align);
+}
+
+template <typename T, typename Traits>
+void* ObjectPoolBlock<T, Traits>::alloc_storage(size_t size, size_t align, std::false_type)
+{
+    return aligned_malloc(size, align);
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::free_storage(void* ptr, size_t size, std::true_type)
+{
+    huge_page_free(ptr, size);
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::free_storage(void* ptr, size_t, std::false_type)
+{
+    aligned_free(ptr);
+}
+
+template <typename T, typename Traits>
+size_t ObjectPoolBlock<T, Traits>::storage_align()
+{
+    return storage_align(huge_pages_t());
+}
+
+template <typename T, typename Traits>
+size_t ObjectPoolBlock<T, Traits>::storage_align(std::true_type)
+{
+    return HUGE_PAGE_SIZE;
+}
+
+template <typename T, typename Traits>
+size_t ObjectPoolBlock<T, Traits>::storage_align(std::false_type)
+{
+    return block_align();
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::advise_storage(void* ptr, size_t size)
+{
+    advise_storage(ptr, size, huge_pages_t());
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::advise_storage(void* ptr, size_t size, std::true_type)
+{
+    virtual_advise_huge_pages(ptr, size);
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::advise_storage(void*, size_t, std::false_type)
+{
+}
+
+template <typename T, typename Traits>
+ObjectPoolBlock<T, Traits>* ObjectPoolBlock<T, Traits>::create_at(
+    void* memory, index_t entries_per_block, generation_t generation)
+{
+    assert((reinterpret_cast<uintptr_t>(memory) & (block_align() - 1)) == 0);
+    ObjectPoolBlock<T, Traits>* ptr = new (memory) ObjectPoolBlock(entries_per_block, generation);
+    assert(reinterpret_cast<uint8_t*>(ptr->indices_begin())
+        == reinterpret_cast<uint8_t*>(ptr) + sizeof(ObjectPoolBlock<T, Traits>));
+    assert(reinterpret_cast<uint8_t*>(entry_at(ptr->memory_begin(), entries_per_block))
+        == reinterpret_cast<uint8_t*>(ptr) + alloc_size(entries_per_block));
     return ptr;
 }
 
-template <typename T>
-void ObjectPoolBlock<T>::destroy(ObjectPoolBlock<T>* ptr)
+template <typename T, typename Traits>
+ObjectPoolBlock<T, Traits>* ObjectPoolBlock<T, Traits>::from_pointer(
+    const T* ptr, size_t block_align)
+{
+    // blocks are aligned to at least their own size so masking off the low
+    // bits of any pointer inside the block gives the start of the block
+    const uintptr_t mask = ~static_cast<uintptr_t>(block_align - 1);
+    return reinterpret_cast<ObjectPoolBlock<T, Traits>*>(reinterpret_cast<uintptr_t>(ptr) & mask);
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::destroy(ObjectPoolBlock<T, Traits>* ptr)
 {
+    const size_t size = alloc_size(ptr->entries_per_block_);
     ptr->~ObjectPoolBlock();
-    aligned_free(ptr);
+    free_storage(ptr, size, huge_pages_t());
 }
 
-template <typename T>
-ObjectPoolBlock<T>::ObjectPoolBlock(index_t entries_per_block)
-    : free_head_index_(0), entries_per_block_(entries_per_block)
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::destroy_at(ObjectPoolBlock<T, Traits>* ptr)
 {
-    index_t* indices = indices_begin();
-    for (index_t i = 0; i < entries_per_block; ++i)
-    {
-        indices[i] = i + 1;
-    }
+    ptr->~ObjectPoolBlock();
+}
+
+template <typename T, typename Traits>
+ObjectPoolBlock<T, Traits>::ObjectPoolBlock(index_t entries_per_block, generation_t generation)
+    : free_head_index_(0),
+      high_water_index_(0),
+      entries_per_block_(entries_per_block),
+      owner_index_(0),
+      block_id_(0),
+      initial_generation_(generation),
+      pool_(nullptr)
+{
+    // entry metadata is initialised as the high water index passes it, so
+    // creating a block does not touch it
 }
 
-template <typename T>
-void destruct_all(ObjectPoolBlock<T>&,
+template <typename T, typename Traits>
+void destruct_all(ObjectPoolBlock<T, Traits>&,
     typename std::enable_if<std::is_trivially_destructible<T>::value>::type* = 0)
 {
     // skip calling destructors for trivially destructible types
 }
 
-template <typename T>
-void destruct_all(ObjectPoolBlock<T>& t,
+template <typename T, typename Traits>
+void destruct_all(ObjectPoolBlock<T, Traits>& t,
     typename std::enable_if<!std::is_trivially_destructible<T>::value>::type* = 0)
 {
     // call destructors on all live objects in the pool
@@ -88,212 +339,1033 @@ void destruct_all(ObjectPoolBlock<T>& t,
         });
 }
 
-template <typename T>
-ObjectPoolBlock<T>::~ObjectPoolBlock()
+template <typename T, typename Traits>
+ObjectPoolBlock<T, Traits>::~ObjectPoolBlock()
 {
     // destruct any allocated objects
     destruct_all(*this);
 }
 
-template <typename T>
-index_t* ObjectPoolBlock<T>::indices_begin() const
+template <typename T, typename Traits>
+typename ObjectPoolBlock<T, Traits>::index_t* ObjectPoolBlock<T, Traits>::indices_begin() const
 {
     // calculcates the start of the indicies
-    return reinterpret_cast<index_t*>(const_cast<ObjectPoolBlock<T>*>(this + 1));
+    return reinterpret_cast<index_t*>(const_cast<ObjectPoolBlock<T, Traits>*>(this + 1));
+}
+
+template <typename T, typename Traits>
+generation_t* ObjectPoolBlock<T, Traits>::generations_begin() const
+{
+    // generations directly follow the indices
+    return reinterpret_cast<generation_t*>(indices_begin() + entries_per_block_);
+}
+
+template <typename T, typename Traits>
+bitmap_word_t* ObjectPoolBlock<T, Traits>::bitmap_begin() const
+{
+    // the bitmap follows the generations, aligned to the bitmap word size
+    const uintptr_t generations_end =
+        reinterpret_cast<uintptr_t>(generations_begin() + entries_per_block_);
+    return reinterpret_cast<bitmap_word_t*>(align_to(generations_end, sizeof(bitmap_word_t)));
+}
+
+template <typename T, typename Traits>
+T* ObjectPoolBlock<T, Traits>::memory_begin() const
+{
+    // pool memory follows the bitmap, aligned to the entry alignment
+    const uintptr_t bitmap_end =
+        reinterpret_cast<uintptr_t>(bitmap_begin() + num_bitmap_words(entries_per_block_));
+    return reinterpret_cast<T*>(
+        align_to(bitmap_end, EntryAlign<T, Traits::cache_line_padding>::value));
+}
+
+template <typename T, typename Traits>
+T* ObjectPoolBlock<T, Traits>::entry_at(T* memory, index_t index)
+{
+    return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(memory)
+        + static_cast<size_t>(index) * EntrySize<T, Traits::cache_line_padding>::value);
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::set_occupied(index_t index, std::true_type)
+{
+    bitmap_begin()[index / 64] |= bitmap_word_t(1) << (index % 64);
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::set_occupied(index_t, std::false_type)
+{
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::clear_occupied(index_t index, std::true_type)
+{
+    bitmap_begin()[index / 64] &= ~(bitmap_word_t(1) << (index % 64));
 }
 
-template <typename T>
-T* ObjectPoolBlock<T>::memory_begin() const
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::clear_occupied(index_t, std::false_type)
 {
-    // calculates the start of pool memory
-    return reinterpret_cast<T*>(indices_begin() + entries_per_block_);
 }
 
-template <typename T>
-const T* ObjectPoolBlock<T>::memory_offset() const
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::init_occupied_word(index_t index, std::true_type)
+{
+    if (index % 64 == 0)
+    {
+        bitmap_begin()[index / 64] = 0;
+    }
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::init_occupied_word(index_t, std::false_type)
+{
+}
+
+template <typename T, typename Traits>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::next_free(
+    index_t* indices, index_t index)
+{
+    if (index != high_water_index_)
+    {
+        // assert that this index is not in use
+        assert(indices[index] != index);
+        return indices[index];
+    }
+    // first use of this entry, the free list continues with the next one
+    generations_begin()[index] = initial_generation_;
+    init_occupied_word(index, has_bitmap_t());
+    high_water_index_ = static_cast<index_t>(index + 1);
+    return high_water_index_;
+}
+
+template <typename T, typename Traits>
+const T* ObjectPoolBlock<T, Traits>::memory_offset() const
 {
     return memory_begin();
 }
 
-template <typename T>
-template <class... P>
-T* ObjectPoolBlock<T>::new_object(P&&... params)
+template <typename T, typename Traits>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::num_entries() const
+{
+    return entries_per_block_;
+}
+
+template <typename T, typename Traits>
+T* ObjectPoolBlock<T, Traits>::reserve_entry()
 {
     // get the head of the free list
     const index_t index = free_head_index_;
     if (index != entries_per_block_)
     {
         index_t* indices = indices_begin();
-        // assert that this index is not in use
-        assert(indices[index] != index);
         // update head of the free list
-        free_head_index_ = indices[index];
-        // flag index as used by assigning it's own index
-        indices[index] = index;
-        // get object memory
-        T* ptr = memory_begin() + index;
-        // construct the entry
-        new (ptr) T(std::forward<P>(params)...);
-        return ptr;
+        free_head_index_ = next_free(indices, index);
+        // the entry is not flagged as used until it is constructed
+        indices[index] = entries_per_block_;
+        return entry_at(memory_begin(), index);
     }
     return nullptr;
 }
 
-template <typename T>
-void ObjectPoolBlock<T>::delete_object(const T* ptr)
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::unreserve_entry(const T* ptr)
+{
+    const index_t index = index_of(ptr);
+    index_t* indices = indices_begin();
+    // assert this index is not allocated
+    assert(indices[index] != index);
+    // store index of next free entry in this entry
+    indices[index] = free_head_index_;
+    free_head_index_ = index;
+}
+
+template <typename T, typename Traits>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::reserve_entries(
+    T** entries, index_t count)
+{
+    // walk the free list from a local head, writing the block's head once
+    index_t* indices = indices_begin();
+    T* memory = memory_begin();
+    index_t index = free_head_index_;
+    index_t num_reserved = 0;
+    for (; num_reserved != count && index != entries_per_block_; ++num_reserved)
+    {
+        const index_t next = next_free(indices, index);
+        indices[index] = entries_per_block_;
+        entries[num_reserved] = entry_at(memory, index);
+        index = next;
+    }
+    free_head_index_ = index;
+    return num_reserved;
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::unreserve_entries(T* const* entries, index_t count)
+{
+    // push the entries in order, so the last entry becomes the new head
+    index_t* indices = indices_begin();
+    index_t head = free_head_index_;
+    for (index_t i = 0; i != count; ++i)
+    {
+        const index_t index = index_of(entries[i]);
+        // assert this index is not allocated
+        assert(indices[index] != index);
+        indices[index] = head;
+        head = index;
+    }
+    free_head_index_ = head;
+}
+
+template <typename T, typename Traits>
+template <class... P>
+T* ObjectPoolBlock<T, Traits>::construct_reserved(T* ptr, P&&... params)
+{
+    const index_t index = index_of(ptr);
+    index_t* indices = indices_begin();
+    // assert that this index is not in use
+    assert(indices[index] != index);
+    // flag index as used by assigning it's own index
+    indices[index] = index;
+    set_occupied(index, has_bitmap_t());
+    // construct the entry
+    new (ptr) T(std::forward<P>(params)...);
+    return ptr;
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::destruct_reserved(const T* ptr)
+{
+    const index_t index = index_of(ptr);
+    index_t* indices = indices_begin();
+    // assert this index is allocated
+    assert(indices[index] == index);
+    // destruct this object
+    ptr->~T();
+    // invalidate any handles to this entry
+    ++generations_begin()[index];
+    // flag the entry as no longer used
+    indices[index] = entries_per_block_;
+    clear_occupied(index, has_bitmap_t());
+}
+
+template <typename T, typename Traits>
+template <class... P>
+T* ObjectPoolBlock<T, Traits>::new_object(P&&... params)
+{
+    if (T* ptr = reserve_entry())
+    {
+        return construct_reserved(ptr, std::forward<P>(params)...);
+    }
+    return nullptr;
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::delete_object(const T* ptr)
 {
     if (ptr)
     {
-        // assert that pointer is in range
-        const T* begin = memory_begin();
-        assert(ptr >= begin && ptr < (begin + entries_per_block_));
-        // destruct this object
-        ptr->~T();
-        // get the index of this pointer
-        const index_t index = static_cast<index_t>(ptr - begin);
-        index_t* indices = indices_begin();
+        destruct_reserved(ptr);
+        unreserve_entry(ptr);
+    }
+}
+
+template <typename T, typename Traits>
+template <class... P>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::new_objects(
+    index_t count, T** out_ptrs, const P&... params)
+{
+    // walk the free list from a local head, writing the block's head once
+    index_t* indices = indices_begin();
+    T* memory = memory_begin();
+    index_t index = free_head_index_;
+    index_t num_created = 0;
+    for (; num_created != count && index != entries_per_block_; ++num_created)
+    {
+        const index_t next = next_free(indices, index);
+        // flag index as used by assigning it's own index
+        indices[index] = index;
+        set_occupied(index, has_bitmap_t());
+        T* ptr = entry_at(memory, index);
+        new (ptr) T(params...);
+        out_ptrs[num_created] = ptr;
+        index = next;
+    }
+    free_head_index_ = index;
+    return num_created;
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::delete_objects(T* const* ptrs, index_t count)
+{
+    // push the entries in order, so the last entry becomes the new head
+    index_t* indices = indices_begin();
+    generation_t* generations = generations_begin();
+    index_t head = free_head_index_;
+    for (index_t i = 0; i != count; ++i)
+    {
+        const T* ptr = ptrs[i];
+        const index_t index = index_of(ptr);
         // assert this index is allocated
         assert(indices[index] == index);
-        // remove index from used list
+        ptr->~T();
+        // invalidate any handles to this entry
+        ++generations[index];
+        clear_occupied(index, has_bitmap_t());
+        indices[index] = head;
+        head = index;
+    }
+    free_head_index_ = head;
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each(const F func) const
+{
+    for_each(func, 0, high_water_index_, has_bitmap_t());
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each_run(const F func) const
+{
+    for_each_run(func, has_bitmap_t());
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::runs_in_words(const F& func, const bitmap_word_t* words,
+    index_t num_words, index_t base, index_t& run_first) const
+{
+    // the occupancy of the entry before the current word
+    bitmap_word_t carry = run_first != entries_per_block_ ? 1 : 0;
+    for (index_t i = 0; i != num_words; ++i, base += 64)
+    {
+        const bitmap_word_t word = words[i];
+        // set bits mark entries whose occupancy differs from the previous
+        // entry, which alternately start and end runs
+        bitmap_word_t edges = word ^ ((word << 1) | carry);
+        carry = word >> 63;
+        for (; edges != 0; edges &= edges - 1)
+        {
+            const index_t index = base + count_trailing_zeros(edges);
+            if (run_first != entries_per_block_)
+            {
+                func(run_first, index);
+                run_first = entries_per_block_;
+            }
+            else
+            {
+                run_first = index;
+            }
+        }
+    }
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each_run(const F func, std::true_type) const
+{
+    index_t run_first = entries_per_block_;
+    runs_in_words(func, bitmap_begin(),
+        static_cast<index_t>(num_bitmap_words(high_water_index_)), 0, run_first);
+    if (run_first != entries_per_block_)
+    {
+        func(run_first, high_water_index_);
+    }
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each_run(const F func, std::false_type) const
+{
+    const index_t* indices = indices_begin();
+    bitmap_word_t words[SCAN_CHUNK_ENTRIES / 64];
+    index_t run_first = entries_per_block_;
+    // chunk positions are size_t as narrow index types can't count past the block
+    for (size_t begin = 0; begin < high_water_index_; begin += SCAN_CHUNK_ENTRIES)
+    {
+        // build an occupancy bitmap for this chunk from the indices
+        const size_t count = std::min<size_t>(SCAN_CHUNK_ENTRIES, high_water_index_ - begin);
+        scan_occupancy(indices, begin, count, words);
+        runs_in_words(func, words, static_cast<index_t>((count + 63) / 64),
+            static_cast<index_t>(begin), run_first);
+    }
+    if (run_first != entries_per_block_)
+    {
+        func(run_first, high_water_index_);
+    }
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each_occupancy_word(const F func) const
+{
+    for_each_occupancy_word(func, has_bitmap_t());
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each_occupancy_word(const F& func, std::true_type) const
+{
+    const bitmap_word_t* bitmap = bitmap_begin();
+    for (size_t i = 0, count = num_bitmap_words(high_water_index_); i != count; ++i)
+    {
+        func(static_cast<index_t>(i * 64), bitmap[i]);
+    }
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each_occupancy_word(const F& func, std::false_type) const
+{
+    const index_t* indices = indices_begin();
+    bitmap_word_t words[SCAN_CHUNK_ENTRIES / 64];
+    for (size_t begin = 0; begin < high_water_index_; begin += SCAN_CHUNK_ENTRIES)
+    {
+        // build an occupancy bitmap for this chunk from the indices
+        const size_t count = std::min<size_t>(SCAN_CHUNK_ENTRIES, high_water_index_ - begin);
+        scan_occupancy(indices, begin, count, words);
+        for (size_t i = 0, num_words = (count + 63) / 64; i != num_words; ++i)
+        {
+            func(static_cast<index_t>(begin + i * 64), words[i]);
+        }
+    }
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each_in_range(const F func, index_t first, index_t last) const
+{
+    assert(first % 64 == 0 && (last % 64 == 0 || last == entries_per_block_));
+    assert(first <= last && last <= entries_per_block_);
+    // entries past the high water index are all free
+    last = std::min(last, high_water_index_);
+    if (first < last)
+    {
+        for_each(func, first, last, has_bitmap_t());
+    }
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each(
+    const F func, index_t first, index_t last, std::true_type) const
+{
+    const bitmap_word_t* bitmap = bitmap_begin();
+    T* memory = memory_begin();
+    for (size_t i = first / 64, count = (last + 63) / 64; i != count; ++i)
+    {
+        // visit each set bit, skipping whole words of free entries
+        for (bitmap_word_t word = bitmap[i]; word != 0; word &= word - 1)
+        {
+            func(entry_at(memory, static_cast<index_t>(i * 64 + count_trailing_zeros(word))));
+        }
+    }
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void ObjectPoolBlock<T, Traits>::for_each(
+    const F func, index_t first, index_t last, std::false_type) const
+{
+    const index_t* indices = indices_begin();
+    T* memory = memory_begin();
+    bitmap_word_t words[SCAN_CHUNK_ENTRIES / 64];
+    for (size_t begin = first; begin < last; begin += SCAN_CHUNK_ENTRIES)
+    {
+        // build an occupancy bitmap for this chunk from the indices
+        const size_t count = std::min<size_t>(SCAN_CHUNK_ENTRIES, last - begin);
+        scan_occupancy(indices, begin, count, words);
+        for (size_t i = 0, num_words = (count + 63) / 64; i != num_words; ++i)
+        {
+            for (bitmap_word_t word = words[i]; word != 0; word &= word - 1)
+            {
+                func(entry_at(
+                    memory, static_cast<index_t>(begin + i * 64 + count_trailing_zeros(word))));
+            }
+        }
+    }
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::discard_entries(bool lazy) const
+{
+    assert(num_allocations() == 0);
+    const uintptr_t page_size = virtual_page_size();
+    const uintptr_t begin =
+        (reinterpret_cast<uintptr_t>(memory_begin()) + page_size - 1) & ~(page_size - 1);
+    const uintptr_t end =
+        reinterpret_cast<uintptr_t>(entry_at(memory_begin(), entries_per_block_))
+        & ~(page_size - 1);
+    if (begin < end)
+    {
+        virtual_discard(reinterpret_cast<void*>(begin), end - begin, lazy);
+    }
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::delete_all()
+{
+    // entries are reused from a newer generation, invalidating any handles
+    initial_generation_ = next_generation();
+    // destruct any allocated objects
+    destruct_all(*this);
+    // every entry is free again, reinitialised as it is reused
+    free_head_index_ = 0;
+    high_water_index_ = 0;
+}
+
+template <typename T, typename Traits>
+index_t ObjectPoolBlock<T, Traits>::owner_index() const
+{
+    return owner_index_;
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::set_owner_index(detail::index_t index)
+{
+    owner_index_ = index;
+}
+
+template <typename T, typename Traits>
+index_t ObjectPoolBlock<T, Traits>::block_id() const
+{
+    return block_id_;
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::set_block_id(detail::index_t id)
+{
+    block_id_ = id;
+}
+
+template <typename T, typename Traits>
+void* ObjectPoolBlock<T, Traits>::pool() const
+{
+    return pool_;
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::set_pool(void* pool)
+{
+    pool_ = pool;
+}
+
+template <typename T, typename Traits>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::index_of(
+    const T* ptr) const
+{
+    const T* begin = memory_begin();
+    assert(ptr >= begin && ptr < entry_at(const_cast<T*>(begin), entries_per_block_));
+    return static_cast<index_t>(
+        (reinterpret_cast<const uint8_t*>(ptr) - reinterpret_cast<const uint8_t*>(begin))
+        / EntrySize<T, Traits::cache_line_padding>::value);
+}
+
+template <typename T, typename Traits>
+generation_t ObjectPoolBlock<T, Traits>::generation_of(index_t index) const
+{
+    assert(index < entries_per_block_);
+    return index < high_water_index_ ? generations_begin()[index] : initial_generation_;
+}
+
+template <typename T, typename Traits>
+T* ObjectPoolBlock<T, Traits>::get_object(uint64_t index, generation_t generation) const
+{
+    // the entry must be both allocated and of the same generation
+    if (index < high_water_index_ && indices_begin()[index] == index
+        && generations_begin()[index] == generation)
+    {
+        return entry_at(memory_begin(), static_cast<index_t>(index));
+    }
+    return nullptr;
+}
+
+template <typename T, typename Traits>
+generation_t ObjectPoolBlock<T, Traits>::next_generation() const
+{
+    // unused entries are at the initial generation
+    const generation_t* generations = generations_begin();
+    generation_t max_generation = initial_generation_;
+    for (index_t i = 0; i < high_water_index_; ++i)
+    {
+        max_generation = std::max(max_generation, generations[i]);
+    }
+    return max_generation + 1;
+}
+
+template <typename T, typename Traits>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::num_allocations() const
+{
+    return num_allocations(has_bitmap_t());
+}
+
+template <typename T, typename Traits>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::num_allocations(
+    std::true_type) const
+{
+    const bitmap_word_t* bitmap = bitmap_begin();
+    size_t num_allocs = 0;
+    for (size_t i = 0, count = num_bitmap_words(high_water_index_); i != count; ++i)
+    {
+        num_allocs += count_bits(bitmap[i]);
+    }
+    return static_cast<index_t>(num_allocs);
+}
+
+template <typename T, typename Traits>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::num_allocations(
+    std::false_type) const
+{
+    const index_t* indices = indices_begin();
+    bitmap_word_t words[SCAN_CHUNK_ENTRIES / 64];
+    size_t num_allocs = 0;
+    for (size_t begin = 0; begin < high_water_index_; begin += SCAN_CHUNK_ENTRIES)
+    {
+        const size_t count = std::min<size_t>(SCAN_CHUNK_ENTRIES, high_water_index_ - begin);
+        scan_occupancy(indices, begin, count, words);
+        for (size_t i = 0, num_words = (count + 63) / 64; i != num_words; ++i)
+        {
+            num_allocs += count_bits(words[i]);
+        }
+    }
+    return static_cast<index_t>(num_allocs);
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::relocate(T* dst, T* src, std::true_type)
+{
+    std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), sizeof(T));
+}
+
+template <typename T, typename Traits>
+void ObjectPoolBlock<T, Traits>::relocate(T* dst, T* src, std::false_type)
+{
+    new (dst) T(std::move(*src));
+    src->~T();
+}
+
+template <typename T, typename Traits>
+template <typename F>
+typename ObjectPoolBlock<T, Traits>::index_t ObjectPoolBlock<T, Traits>::move_objects_to(
+    ObjectPoolBlock& dst, index_t max_count, const F func)
+{
+    typedef std::integral_constant<bool, ObjectPoolRelocatable<T>::value> relocatable_t;
+    index_t* indices = indices_begin();
+    generation_t* generations = generations_begin();
+    T* memory = memory_begin();
+    index_t num_moved = 0;
+    for (index_t index = 0; index != high_water_index_ && num_moved != max_count; ++index)
+    {
+        // skip free and reserved entries
+        if (indices[index] != index)
+        {
+            continue;
+        }
+        T* to = dst.reserve_entry();
+        if (!to)
+        {
+            break;
+        }
+        T* from = entry_at(memory, index);
+        relocate(to, from, relocatable_t());
+        const index_t to_index = dst.index_of(to);
+        dst.indices_begin()[to_index] = to_index;
+        dst.set_occupied(to_index, has_bitmap_t());
+        // free the original entry, invalidating handles to it
+        ++generations[index];
+        clear_occupied(index, has_bitmap_t());
         indices[index] = free_head_index_;
-        // store index of next free entry in this entry
         free_head_index_ = index;
+        ++num_moved;
+        func(from, to);
+    }
+    return num_moved;
+}
+
+} // namespace detail
+
+template <typename T, typename Traits>
+size_t FixedObjectPool<T, Traits>::calc_block_align(index_t max_entries)
+{
+    return std::max<size_t>(
+        detail::next_pow2(Block::alloc_size(max_entries)), Block::block_align());
+}
+
+template <typename T, typename Traits>
+FixedObjectPool<T, Traits>::FixedObjectPool(index_t max_entries)
+    : block_(Block::create(max_entries, calc_block_align(max_entries)))
+{
+    if (!detail::register_block(block_, calc_block_align(max_entries)))
+    {
+        // objects in an unregistered block could not find the pool, so
+        // fall back to a block with no entries and fail every allocation
+        Block::destroy(block_);
+        block_ = Block::create(0, Block::block_align());
+        return;
+    }
+    block_->set_pool(this);
+}
+
+template <typename T, typename Traits>
+FixedObjectPool<T, Traits>::~FixedObjectPool()
+{
+    assert(calc_stats().num_allocations == 0);
+    if (block_->pool())
+    {
+        detail::unregister_block(block_, calc_block_align(block_->num_entries()));
     }
+    Block::destroy(block_);
 }
 
-template <typename T>
-template <typename F>
-void ObjectPoolBlock<T>::for_each(const F func) const
+template <typename T, typename Traits>
+FixedObjectPool<T, Traits>* FixedObjectPool<T, Traits>::from_pointer(const T* ptr)
 {
-    const index_t* indices = indices_begin();
-    T* first = memory_begin();
-    for (index_t i = 0, count = entries_per_block_; i != count; ++i)
-    {
-        if (indices[i] == i)
-        {
-            func(first + i);
-        }
-    }
+    const Block* block = Block::from_pointer(ptr, detail::find_block_align(ptr));
+    return static_cast<FixedObjectPool*>(block->pool());
 }
 
-template <typename T>
-void ObjectPoolBlock<T>::delete_all()
+template <typename T, typename Traits>
+template <class... P>
+T* FixedObjectPool<T, Traits>::new_object(P&&... params)
 {
-    // destruct any allocated objects
-    destruct_all(*this);
-    free_head_index_ = 0;
-    index_t* indices = indices_begin();
-    for (index_t i = 0; i < entries_per_block_; ++i)
+    T* ptr = block_->new_object(std::forward<P>(params)...);
+    if (ptr)
+    {
+        counters_.allocated(1);
+    }
+    else
     {
-        indices[i] = i + 1;
+        counters_.failed(1);
     }
+    return ptr;
 }
 
-template <typename T>
-index_t ObjectPoolBlock<T>::num_allocations() const
+template <typename T, typename Traits>
+void FixedObjectPool<T, Traits>::delete_object(const T* ptr)
 {
-    index_t num_allocs = 0;
-    for_each([&num_allocs](const T*)
-        {
-            ++num_allocs;
-        });
-    return num_allocs;
+    if (ptr)
+    {
+        block_->delete_object(ptr);
+        counters_.freed(1);
+    }
 }
 
-} // namespace detail
-
-template <typename T>
-FixedObjectPool<T>::FixedObjectPool(index_t max_entries)
-    : block_(Block::create(max_entries))
+template <typename T, typename Traits>
+template <class... P>
+typename FixedObjectPool<T, Traits>::index_t FixedObjectPool<T, Traits>::new_objects(
+    index_t count, T** out_ptrs, const P&... params)
 {
+    const index_t num_created = block_->new_objects(count, out_ptrs, params...);
+    counters_.allocated(num_created);
+    counters_.failed(count - num_created);
+    return num_created;
 }
 
-template <typename T>
-FixedObjectPool<T>::~FixedObjectPool()
+template <typename T, typename Traits>
+void FixedObjectPool<T, Traits>::delete_objects(T* const* ptrs, index_t count)
 {
-    assert(calc_stats().num_allocations == 0);
-    Block::destroy(block_);
+    block_->delete_objects(ptrs, count);
+    counters_.freed(count);
 }
 
-template <typename T>
-template <class... P>
-T* FixedObjectPool<T>::new_object(P&&... params)
+template <typename T, typename Traits>
+void FixedObjectPool<T, Traits>::delete_all()
 {
-    return block_->new_object(std::forward<P>(params)...);
+    block_->delete_all();
+    counters_.freed(counters_.num_allocations);
 }
 
-template <typename T>
-void FixedObjectPool<T>::delete_object(const T* ptr)
+template <typename T, typename Traits>
+typename FixedObjectPool<T, Traits>::Handle FixedObjectPool<T, Traits>::get_handle(
+    const T* ptr) const
 {
-    block_->delete_object(ptr);
+    Handle handle;
+    handle.block = 0;
+    handle.index = block_->index_of(ptr);
+    handle.generation = block_->generation_of(handle.index);
+    return handle;
 }
 
-template <typename T>
-void FixedObjectPool<T>::delete_all()
+template <typename T, typename Traits>
+T* FixedObjectPool<T, Traits>::get_object(Handle handle) const
 {
-    block_->delete_all();
+    return handle.block == 0 ? block_->get_object(handle.index, handle.generation) : nullptr;
 }
 
-template <typename T>
+template <typename T, typename Traits>
 template <typename F>
-void FixedObjectPool<T>::for_each(const F func) const
+void FixedObjectPool<T, Traits>::for_each(const F func) const
 {
     block_->for_each(func);
 }
 
-template <typename T>
-ObjectPoolStats FixedObjectPool<T>::calc_stats() const
+template <typename T, typename Traits>
+template <typename F, typename E>
+void FixedObjectPool<T, Traits>::parallel_for_each(const F func, E& executor) const
+{
+    // split the block into equal ranges of whole bitmap words
+    const size_t num_entries = block_->num_entries();
+    const size_t num_words = (num_entries + 63) / 64;
+    const size_t num_tasks =
+        std::max<size_t>(std::min<size_t>(executor.num_workers(), num_words), 1);
+    const Block* block = block_;
+    executor.run(num_tasks, [block, func, num_entries, num_words, num_tasks](size_t task)
+        {
+            const size_t first = num_words * task / num_tasks * 64;
+            const size_t last =
+                std::min<size_t>(num_words * (task + 1) / num_tasks * 64, num_entries);
+            block->for_each_in_range(func, static_cast<index_t>(first), static_cast<index_t>(last));
+        });
+}
+
+template <typename T, typename Traits>
+ObjectPoolStats FixedObjectPool<T, Traits>::calc_stats() const
 {
     ObjectPoolStats stats;
     stats.num_blocks = 1;
-    stats.num_allocations = block_->num_allocations();
+    stats.num_allocations = counters_.num_allocations;
+    stats.high_water_mark = counters_.high_water_mark;
+    stats.peak_blocks = 1;
+    stats.bytes_reserved = Block::storage_size(block_->num_entries());
+    stats.bytes_metadata = Block::metadata_size(block_->num_entries());
+    stats.total_allocations = counters_.total_allocations;
+    stats.total_frees = counters_.total_frees;
+    stats.failed_allocations = counters_.failed_allocations;
     return stats;
 }
 
-template <typename T>
-DynamicObjectPool<T>::DynamicObjectPool(index_t entries_per_block)
+template <typename T, typename Traits>
+const int DynamicObjectPool<T, Traits>::NUMA_NODE_ANY;
+
+template <typename T, typename Traits>
+const int DynamicObjectPool<T, Traits>::NUMA_NODE_CALLER;
+
+template <typename T, typename Traits>
+size_t DynamicObjectPool<T, Traits>::calc_block_align(
+    index_t entries_per_block, size_t reserve_size)
+{
+    size_t align = std::max<size_t>(
+        detail::next_pow2(Block::alloc_size(entries_per_block)), Block::block_align());
+    // reserved blocks are committed and decommitted a page at a time so
+    // must not share pages
+    if (reserve_size != 0)
+    {
+        align = std::max(align, detail::virtual_page_size());
+    }
+    return align;
+}
+
+template <typename T, typename Traits>
+DynamicObjectPool<T, Traits>::DynamicObjectPool(
+    index_t entries_per_block, size_t reserve_size, int numa_node)
     : block_info_(nullptr),
+      block_ids_(nullptr),
+      num_block_ids_(0),
+      generation_base_(0),
       num_blocks_(0),
+      peak_blocks_(0),
       free_block_index_(0),
-      entries_per_block_(entries_per_block)
+      entries_per_block_(entries_per_block),
+      block_align_(calc_block_align(entries_per_block, reserve_size)),
+      reserve_memory_(nullptr),
+      reserve_size_(0),
+      reserve_begin_(nullptr),
+      max_blocks_(0),
+      numa_node_(numa_node),
+      owner_(nullptr)
 {
+    if (reserve_size != 0)
+    {
+        // reserve extra space so the first block can be aligned
+        const size_t max_blocks = (reserve_size + block_align_ - 1) / block_align_;
+        const size_t range_align = std::max(block_align_, Block::storage_align());
+        reserve_size_ = max_blocks * block_align_ + range_align;
+        reserve_memory_ = detail::virtual_reserve(reserve_size_);
+        if (reserve_memory_)
+        {
+            const uintptr_t begin =
+                (reinterpret_cast<uintptr_t>(reserve_memory_) + range_align - 1)
+                & ~static_cast<uintptr_t>(range_align - 1);
+            reserve_begin_ = reinterpret_cast<uint8_t*>(begin);
+            Block::advise_storage(reserve_begin_, max_blocks * block_align_);
+            max_blocks_ = static_cast<detail::index_t>(
+                std::min<size_t>(max_blocks, ~detail::index_t(0)));
+            // block ids map directly to addresses so the bookkeeping arrays
+            // are allocated once at their maximum size
+            block_info_ = reinterpret_cast<BlockInfo*>(malloc(max_blocks_ * sizeof(BlockInfo)));
+            block_ids_ = reinterpret_cast<Block**>(malloc(max_blocks_ * sizeof(Block*)));
+        }
+    }
     // always have one block available
     add_block();
 }
 
-template <typename T>
-DynamicObjectPool<T>::~DynamicObjectPool()
+template <typename T, typename Traits>
+DynamicObjectPool<T, Traits>::~DynamicObjectPool()
 {
     // explicitly delete_object or delete_all before pool goes out of scope
     assert(calc_stats().num_allocations == 0);
+    for (detail::index_t index = 0; index != num_blocks_; ++index)
+    {
+        destroy_block(block_info_[index]);
+    }
+    free(block_info_);
+    free(block_ids_);
+    if (reserve_memory_)
+    {
+        detail::virtual_release(reserve_memory_, reserve_size_);
+    }
+}
+
+template <typename T, typename Traits>
+size_t DynamicObjectPool<T, Traits>::block_commit_size() const
+{
+    const size_t page_size = detail::virtual_page_size();
+    return (Block::alloc_size(entries_per_block_) + page_size - 1) & ~(page_size - 1);
+}
+
+template <typename T, typename Traits>
+detail::ObjectPoolBlock<T, Traits>* DynamicObjectPool<T, Traits>::create_block(
+    detail::index_t id, int node)
+{
+    uint8_t* memory;
+    if (reserve_size_ == 0)
+    {
+        if (node < 0)
+        {
+            return Block::create(entries_per_block_, block_align_, generation_base_);
+        }
+        // heap memory may share pages with other allocations, which the
+        // binding would apply to, so the block gets whole pages of its own
+        memory = static_cast<uint8_t*>(detail::virtual_alloc(
+            block_commit_size(), std::max(block_align_, Block::storage_align())));
+        if (!memory)
+        {
+            return nullptr;
+        }
+        Block::advise_storage(memory, block_commit_size());
+    }
+    else
+    {
+        if (id >= max_blocks_)
+        {
+            return nullptr;
+        }
+        memory = reserve_begin_ + id * block_align_;
+        if (!detail::virtual_commit(memory, block_commit_size()))
+        {
+            return nullptr;
+        }
+    }
+    if (node >= 0)
+    {
+        // bind before first touch so no pages need moving
+        detail::numa_bind(memory, block_commit_size(), node);
+    }
+    return Block::create_at(memory, entries_per_block_, generation_base_);
+}
+
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::destroy_block(const BlockInfo& info)
+{
+    // only blocks which were registered point back to the owner
+    if (info.block_->pool())
+    {
+        detail::unregister_block(info.block_, block_align_);
+    }
+    if (reserve_size_ != 0)
+    {
+        Block::destroy_at(info.block_);
+        detail::virtual_decommit(info.block_, block_commit_size());
+    }
+    else if (info.mapped_)
+    {
+        Block::destroy_at(info.block_);
+        detail::virtual_free(info.block_, block_commit_size());
+    }
+    else
+    {
+        Block::destroy(info.block_);
+    }
 }
 
-template <typename T>
-typename DynamicObjectPool<T>::BlockInfo* DynamicObjectPool<T>::add_block()
+template <typename T, typename Traits>
+typename DynamicObjectPool<T, Traits>::BlockInfo* DynamicObjectPool<T, Traits>::add_block()
 {
     assert(free_block_index_ == num_blocks_);
-    if (Block* block = Block::create(entries_per_block_))
+    // reuse the first unused block id, or add a new one. Reserved blocks
+    // therefore fill the lowest free addresses first.
+    detail::index_t id = 0;
+    while (id != num_block_ids_ && block_ids_[id] != nullptr)
+    {
+        ++id;
+    }
+    int node = numa_node_ == NUMA_NODE_CALLER ? detail::numa_current_node() : numa_node_;
+    if (node >= detail::numa_num_nodes())
+    {
+        // nodes which don't exist leave placement to first touch
+        node = NUMA_NODE_ANY;
+    }
+    Block* block = create_block(id, node);
+    if (!block)
+    {
+        return nullptr;
+    }
+    const bool mapped = reserve_size_ == 0 && node >= 0;
+    if (owner_)
+    {
+        if (!detail::register_block(block, block_align_))
+        {
+            BlockInfo info;
+            info.mapped_ = mapped;
+            info.block_ = block;
+            destroy_block(info);
+            return nullptr;
+        }
+        block->set_pool(owner_);
+    }
+    if (id == num_block_ids_)
+    {
+        ++num_block_ids_;
+        if (reserve_size_ == 0)
+        {
+            block_ids_ =
+                reinterpret_cast<Block**>(realloc(block_ids_, num_block_ids_ * sizeof(Block*)));
+        }
+    }
+    block_ids_[id] = block;
+    block->set_block_id(id);
+    block->set_owner_index(num_blocks_);
+    // update the number of blocks
+    ++num_blocks_;
+    peak_blocks_ = std::max(peak_blocks_, num_blocks_);
+    // allocate space for new block info
+    if (reserve_size_ == 0)
     {
-        // update the number of blocks
-        ++num_blocks_;
-        // allocate space for new block info
         block_info_ =
             reinterpret_cast<BlockInfo*>(realloc(block_info_, num_blocks_ * sizeof(BlockInfo)));
-        // initialise the new block info structure
-        BlockInfo& info = block_info_[free_block_index_];
-        info.num_free_ = entries_per_block_;
-        info.offset_ = block->memory_offset();
-        info.block_ = block;
-        return &info;
     }
-    return nullptr;
+    // initialise the new block info structure
+    BlockInfo& info = block_info_[free_block_index_];
+    info.num_free_ = entries_per_block_;
+    info.mapped_ = mapped;
+    // without a requested node the block is wherever its first touch put it,
+    // which only needs asking when there is more than one node
+    if (node < 0)
+    {
+        node = detail::numa_num_nodes() > 1 ? detail::numa_node_of(block) : 0;
+    }
+    info.numa_node_ = static_cast<int16_t>(node);
+    info.block_ = block;
+    return &info;
 }
 
-template <typename T>
-template <typename... P>
-T* DynamicObjectPool<T>::new_object(P&&... params)
+template <typename T, typename Traits>
+typename DynamicObjectPool<T, Traits>::BlockInfo* DynamicObjectPool<T, Traits>::find_free_block()
 {
-    assert(free_block_index_ < num_blocks_);
+    assert(free_block_index_ <= num_blocks_);
 
     // search for a block with free space
     BlockInfo* p_info = block_info_ + free_block_index_;
@@ -303,16 +1375,25 @@ T* DynamicObjectPool<T>::new_object(P&&... params)
     }
 
     // update the free block index
-    free_block_index_ = static_cast<index_t>(p_info - block_info_);
+    free_block_index_ = static_cast<detail::index_t>(p_info - block_info_);
 
     // if no free blocks found then create a new one
     if (free_block_index_ == num_blocks_)
     {
         p_info = add_block();
-        if (!p_info)
-        {
-            return nullptr;
-        }
+    }
+    return p_info;
+}
+
+template <typename T, typename Traits>
+template <typename... P>
+T* DynamicObjectPool<T, Traits>::new_object(P&&... params)
+{
+    BlockInfo* p_info = find_free_block();
+    if (!p_info)
+    {
+        counters_.failed(1);
+        return nullptr;
     }
 
     // construct the new object
@@ -320,33 +1401,142 @@ T* DynamicObjectPool<T>::new_object(P&&... params)
     assert(ptr != nullptr);
     // update num free count
     --p_info->num_free_;
+    counters_.allocated(1);
     return ptr;
 }
 
-template <typename T>
-void DynamicObjectPool<T>::delete_object(const T* ptr)
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::add_free_entries(const Block* block, index_t count)
 {
-    BlockInfo* p_info = block_info_;
-    for (auto end = p_info + num_blocks_; p_info != end; ++p_info)
+    const detail::index_t free_block = block->owner_index();
+    assert(free_block < num_blocks_ && block_info_[free_block].block_ == block);
+    block_info_[free_block].num_free_ += count;
+    if (free_block < free_block_index_)
     {
-        const T* p_entries_begin = p_info->offset_;
-        const T* p_entries_end = p_entries_begin + entries_per_block_;
-        if (ptr >= p_entries_begin && ptr < p_entries_end)
+        free_block_index_ = free_block;
+    }
+}
+
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        // find the owning block from the pointer address
+        Block* block = Block::from_pointer(ptr, block_align_);
+        block->delete_object(ptr);
+        add_free_entries(block, 1);
+        counters_.freed(1);
+    }
+}
+
+template <typename T, typename Traits>
+template <class... P>
+detail::index_t DynamicObjectPool<T, Traits>::new_objects(
+    detail::index_t count, T** out_ptrs, const P&... params)
+{
+    detail::index_t num_created = 0;
+    while (num_created != count)
+    {
+        BlockInfo* p_info = find_free_block();
+        if (!p_info)
         {
-            p_info->block_->delete_object(ptr);
-            ++p_info->num_free_;
-            const index_t free_block = static_cast<index_t>(p_info - block_info_);
-            if (free_block < free_block_index_)
-            {
-                free_block_index_ = free_block;
-            }
-            return;
+            break;
+        }
+        // take as many entries as possible from this block
+        const index_t block_count = p_info->block_->new_objects(
+            static_cast<index_t>(std::min<detail::index_t>(p_info->num_free_, count - num_created)),
+            out_ptrs + num_created, params...);
+        p_info->num_free_ -= block_count;
+        num_created += block_count;
+    }
+    counters_.allocated(num_created);
+    counters_.failed(count - num_created);
+    return num_created;
+}
+
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::delete_objects(T* const* ptrs, detail::index_t count)
+{
+    detail::index_t first = 0;
+    while (first != count)
+    {
+        // delete the run of objects sharing a block at once
+        Block* block = Block::from_pointer(ptrs[first], block_align_);
+        detail::index_t last = first + 1;
+        while (last != count && Block::from_pointer(ptrs[last], block_align_) == block)
+        {
+            ++last;
+        }
+        const index_t run_count = static_cast<index_t>(last - first);
+        block->delete_objects(ptrs + first, run_count);
+        add_free_entries(block, run_count);
+        first = last;
+    }
+    counters_.freed(count);
+}
+
+template <typename T, typename Traits>
+detail::index_t DynamicObjectPool<T, Traits>::reserve_entries(
+    T** entries, detail::index_t count)
+{
+    detail::index_t num_reserved = 0;
+    while (num_reserved != count)
+    {
+        BlockInfo* p_info = find_free_block();
+        if (!p_info)
+        {
+            break;
+        }
+        // take as many entries as possible from this block
+        const index_t block_count = p_info->block_->reserve_entries(
+            entries + num_reserved, static_cast<index_t>(std::min<detail::index_t>(
+                p_info->num_free_, count - num_reserved)));
+        p_info->num_free_ -= block_count;
+        num_reserved += block_count;
+    }
+    counters_.allocated(num_reserved);
+    counters_.failed(count - num_reserved);
+    return num_reserved;
+}
+
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::release_entries(T* const* entries, detail::index_t count)
+{
+    detail::index_t first = 0;
+    while (first != count)
+    {
+        // release the run of entries sharing a block at once
+        Block* block = Block::from_pointer(entries[first], block_align_);
+        detail::index_t last = first + 1;
+        while (last != count && Block::from_pointer(entries[last], block_align_) == block)
+        {
+            ++last;
         }
+        const index_t run_count = static_cast<index_t>(last - first);
+        block->unreserve_entries(entries + first, run_count);
+        add_free_entries(block, run_count);
+        first = last;
     }
+    counters_.freed(count);
 }
 
-template <typename T>
-void DynamicObjectPool<T>::delete_all()
+template <typename T, typename Traits>
+template <class... P>
+T* DynamicObjectPool<T, Traits>::construct_reserved(T* ptr, P&&... params)
+{
+    return Block::from_pointer(ptr, block_align_)
+        ->construct_reserved(ptr, std::forward<P>(params)...);
+}
+
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::destruct_reserved(const T* ptr)
+{
+    Block::from_pointer(ptr, block_align_)->destruct_reserved(ptr);
+}
+
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::delete_all()
 {
     for (BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
          ++p_info)
@@ -355,16 +1545,31 @@ void DynamicObjectPool<T>::delete_all()
         p_info->num_free_ = entries_per_block_;
     }
     free_block_index_ = 0;
+    counters_.freed(counters_.num_allocations);
 }
 
-template <typename T>
-void DynamicObjectPool<T>::reclaim_memory()
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::reclaim_memory(ObjectPoolReclaim mode)
 {
+    if (mode != ObjectPoolReclaim::Free)
+    {
+        // keep every block in place, only releasing the pages behind them
+        const bool lazy = mode == ObjectPoolReclaim::LazyDiscard;
+        for (detail::index_t index = 0; index != num_blocks_; ++index)
+        {
+            if (block_info_[index].num_free_ == entries_per_block_)
+            {
+                block_info_[index].block_->discard_entries(lazy);
+            }
+        }
+        return;
+    }
+
     // loop through all blocks shuffling the used blocks to the front and unused
     // to the back.
-    index_t used_index = num_blocks_;
-    index_t empty_index = num_blocks_;
-    for (index_t index = 0; index < num_blocks_; ++index)
+    detail::index_t used_index = num_blocks_;
+    detail::index_t empty_index = num_blocks_;
+    for (detail::index_t index = 0; index < num_blocks_; ++index)
     {
         if (block_info_[index].num_free_ != entries_per_block_)
         {
@@ -378,6 +1583,8 @@ void DynamicObjectPool<T>::reclaim_memory()
         if (empty_index < used_index && used_index != num_blocks_)
         {
             std::swap(block_info_[empty_index], block_info_[used_index]);
+            block_info_[empty_index].block_->set_owner_index(empty_index);
+            block_info_[used_index].block_->set_owner_index(used_index);
             used_index = empty_index;
             ++empty_index;
         }
@@ -391,19 +1598,26 @@ void DynamicObjectPool<T>::reclaim_memory()
     }
 
     // free remaining empty blocks
-    for (index_t index = used_index + 1; index != num_blocks_; ++index)
+    for (detail::index_t index = used_index + 1; index != num_blocks_; ++index)
     {
-        Block::destroy(block_info_[index].block_);
+        Block* block = block_info_[index].block_;
+        // blocks reusing this id must not accept handles to this block
+        generation_base_ = std::max(generation_base_, block->next_generation());
+        block_ids_[block->block_id()] = nullptr;
+        destroy_block(block_info_[index]);
     }
 
     // resize the block info array
     num_blocks_ = used_index + 1;
-    block_info_ =
-        reinterpret_cast<BlockInfo*>(realloc(block_info_, sizeof(BlockInfo) * num_blocks_));
+    if (reserve_size_ == 0)
+    {
+        block_info_ =
+            reinterpret_cast<BlockInfo*>(realloc(block_info_, sizeof(BlockInfo) * num_blocks_));
+    }
 
     // find the first free block index
     free_block_index_ = num_blocks_;
-    for (index_t index = 0; index != num_blocks_; ++index)
+    for (detail::index_t index = 0; index != num_blocks_; ++index)
     {
         if (block_info_[index].num_free_ != 0)
         {
@@ -413,9 +1627,99 @@ void DynamicObjectPool<T>::reclaim_memory()
     }
 }
 
-template <typename T>
+template <typename T, typename Traits>
+template <typename F>
+size_t DynamicObjectPool<T, Traits>::compact(const F func)
+{
+    // order blocks by NUMA node then from densest to sparsest
+    std::sort(block_info_, block_info_ + num_blocks_,
+        [](const BlockInfo& a, const BlockInfo& b)
+        {
+            return a.numa_node_ != b.numa_node_ ? a.numa_node_ < b.numa_node_
+                                                : a.num_free_ < b.num_free_;
+        });
+    for (detail::index_t index = 0; index != num_blocks_; ++index)
+    {
+        block_info_[index].block_->set_owner_index(index);
+    }
+
+    size_t num_moved = 0;
+    detail::index_t node_begin = 0;
+    while (node_begin != num_blocks_)
+    {
+        detail::index_t node_end = node_begin + 1;
+        while (node_end != num_blocks_ &&
+               block_info_[node_end].numa_node_ == block_info_[node_begin].numa_node_)
+        {
+            ++node_end;
+        }
+        // fill the densest blocks with objects from the sparsest
+        detail::index_t dst = node_begin;
+        detail::index_t src = node_end - 1;
+        while (dst < src)
+        {
+            BlockInfo& dst_info = block_info_[dst];
+            BlockInfo& src_info = block_info_[src];
+            if (dst_info.num_free_ == 0)
+            {
+                ++dst;
+                continue;
+            }
+            const index_t moved = src_info.block_->move_objects_to(
+                *dst_info.block_, dst_info.num_free_, func);
+            dst_info.num_free_ -= moved;
+            src_info.num_free_ += moved;
+            num_moved += moved;
+            if (dst_info.num_free_ != 0)
+            {
+                // the source block has no constructed objects left
+                --src;
+            }
+        }
+        node_begin = node_end;
+    }
+
+    free_block_index_ = 0;
+    reclaim_memory(ObjectPoolReclaim::Free);
+    return num_moved;
+}
+
+template <typename T, typename Traits>
+size_t DynamicObjectPool<T, Traits>::compact()
+{
+    return compact([](const T*, const T*)
+        {
+        });
+}
+
+template <typename T, typename Traits>
+typename DynamicObjectPool<T, Traits>::Handle DynamicObjectPool<T, Traits>::get_handle(
+    const T* ptr) const
+{
+    const Block* block = Block::from_pointer(ptr, block_align_);
+    Handle handle;
+    handle.block = block->block_id();
+    handle.index = block->index_of(ptr);
+    handle.generation = block->generation_of(handle.index);
+    return handle;
+}
+
+template <typename T, typename Traits>
+T* DynamicObjectPool<T, Traits>::get_object(Handle handle) const
+{
+    if (handle.block < num_block_ids_)
+    {
+        if (const Block* block = block_ids_[handle.block])
+        {
+            return block->get_object(handle.index, handle.generation);
+        }
+    }
+    return nullptr;
+}
+
+template <typename T, typename Traits>
 template <typename F>
-void DynamicObjectPool<T>::for_each(const F func) const
+void DynamicObjectPool<T, Traits>::for_each(const F func) const
 {
     for (const BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
          ++p_info)
@@ -427,20 +1731,129 @@ void DynamicObjectPool<T>::for_each(const F func) const
     }
 }
 
-template <typename T>
-ObjectPoolStats DynamicObjectPool<T>::calc_stats() const
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::set_numa_node(int node)
+{
+    numa_node_ = node;
+}
+
+template <typename T, typename Traits>
+int DynamicObjectPool<T, Traits>::numa_node() const
+{
+    return numa_node_;
+}
+
+template <typename T, typename Traits>
+void DynamicObjectPool<T, Traits>::set_owner(void* owner)
+{
+    assert(owner && !owner_ && counters_.num_allocations == 0);
+    owner_ = owner;
+    for (detail::index_t index = 0; index != num_blocks_; ++index)
+    {
+        Block* block = block_info_[index].block_;
+        if (!detail::register_block(block, block_align_))
+        {
+            // the pool is empty, so drop its blocks and let them be added
+            // again, registered or failing like any other block allocation
+            for (detail::index_t i = 0; i != num_blocks_; ++i)
+            {
+                block_ids_[block_info_[i].block_->block_id()] = nullptr;
+                destroy_block(block_info_[i]);
+            }
+            num_blocks_ = 0;
+            free_block_index_ = 0;
+            return;
+        }
+        block->set_pool(owner);
+    }
+}
+
+template <typename T, typename Traits>
+void* DynamicObjectPool<T, Traits>::find_owner(const T* ptr)
+{
+    return Block::from_pointer(ptr, detail::find_block_align(ptr))->pool();
+}
+
+template <typename T, typename Traits>
+template <typename F>
+void DynamicObjectPool<T, Traits>::for_each_on_node(int node, const F func) const
 {
-    ObjectPoolStats stats;
-    stats.num_blocks = num_blocks_;
-    stats.num_allocations = 0;
     for (const BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
          ++p_info)
     {
-        if (p_info->num_free_ < entries_per_block_)
+        if (p_info->numa_node_ == node && p_info->num_free_ < entries_per_block_)
+        {
+            p_info->block_->for_each(func);
+        }
+    }
+}
+
+template <typename T, typename Traits>
+template <typename F, typename E>
+void DynamicObjectPool<T, Traits>::parallel_for_each(const F func, E& executor) const
+{
+    // total number of live entries, using the cached free counts
+    size_t num_live = 0;
+    for (const BlockInfo *p_info = block_info_, *p_end = block_info_ + num_blocks_; p_info != p_end;
+         ++p_info)
+    {
+        num_live += entries_per_block_ - p_info->num_free_;
+    }
+    const size_t num_tasks =
+        std::max<size_t>(std::min<size_t>(executor.num_workers(), num_blocks_), 1);
+
+    // split the blocks into runs with roughly equal numbers of live entries
+    std::vector<detail::index_t> task_first(num_tasks + 1, num_blocks_);
+    task_first[0] = 0;
+    size_t task = 1;
+    size_t running_live = 0;
+    for (detail::index_t index = 0; index != num_blocks_ && task != num_tasks; ++index)
+    {
+        running_live += entries_per_block_ - block_info_[index].num_free_;
+        while (task != num_tasks && running_live * num_tasks >= num_live * task)
         {
-            stats.num_allocations += p_info->block_->num_allocations();
+            task_first[task++] = index + 1;
         }
     }
+
+    const BlockInfo* block_info = block_info_;
+    const index_t entries_per_block = entries_per_block_;
+    executor.run(num_tasks, [block_info, entries_per_block, func, &task_first](size_t task)
+        {
+            for (detail::index_t index = task_first[task], end = task_first[task + 1]; index < end;
+                 ++index)
+            {
+                if (block_info[index].num_free_ < entries_per_block)
+                {
+                    block_info[index].block_->for_each(func);
+                }
+            }
+        });
+}
+
+template <typename T, typename Traits>
+ObjectPoolStats DynamicObjectPool<T, Traits>::calc_stats() const
+{
+    ObjectPoolStats stats;
+    stats.num_blocks = num_blocks_;
+    stats.num_allocations = counters_.num_allocations;
+    stats.high_water_mark = counters_.high_water_mark;
+    stats.peak_blocks = peak_blocks_;
+    if (reserve_size_ == 0)
+    {
+        stats.bytes_reserved = num_blocks_ * Block::storage_size(entries_per_block_);
+        stats.bytes_metadata =
+            num_blocks_ * sizeof(BlockInfo) + num_block_ids_ * sizeof(Block*);
+    }
+    else
+    {
+        stats.bytes_reserved = num_blocks_ * block_commit_size();
+        stats.bytes_metadata = max_blocks_ * (sizeof(BlockInfo) + sizeof(Block*));
+    }
+    stats.bytes_metadata += num_blocks_ * Block::metadata_size(entries_per_block_);
+    stats.total_allocations = counters_.total_allocations;
+    stats.total_frees = counters_.total_frees;
+    stats.failed_allocations = counters_.failed_allocations;
     return stats;
 }
 
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#include "pool_allocator.hpp"
+
+PoolAllocatorArena::PoolAllocatorArena()
+{
+}
+
+PoolAllocatorArena::~PoolAllocatorArena()
+{
+    for (const PoolInfo& info : pools_)
+    {
+        if (!info.in_use(info.pool))
+        {
+            info.destroy(info.pool);
+        }
+    }
+}
+
+PoolAllocatorArena& PoolAllocatorArena::thread_arena()
+{
+    static thread_local PoolAllocatorArena arena;
+    return arena;
+}
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace tests
+{
+
+TEST_CASE("PoolAllocator single and array allocations", "[poolallocator]")
+{
+    PoolAllocatorArena arena;
+    PoolAllocator<uint64_t> alloc(arena);
+    uint64_t* p = alloc.allocate(1);
+    REQUIRE(p != nullptr);
+    *p = 42;
+    REQUIRE(alloc.pool() != nullptr);
+    CHECK(alloc.pool() == arena.pool<PoolAllocator<uint64_t>::Storage>());
+    CHECK(alloc.pool()->calc_stats().num_allocations == 1u);
+    // arrays come from the heap
+    uint64_t* a = alloc.allocate(16);
+    REQUIRE(a != nullptr);
+    a[15] = 1;
+    CHECK(alloc.pool()->calc_stats().num_allocations == 1u);
+    alloc.deallocate(a, 16);
+    alloc.deallocate(p, 1);
+    CHECK(alloc.pool()->calc_stats().num_allocations == 0u);
+    // array sizes overflowing size_t are rejected rather than wrapping
+    CHECK_THROWS_AS(
+        alloc.allocate(SIZE_MAX / sizeof(uint64_t) + 1), const std::bad_array_new_length&);
+}
+
+/// Node payload aligned beyond operator new's guarantee
+struct alignas(128) AllocatorWide
+{
+    uint32_t value;
+};
+
+TEST_CASE("PoolAllocator over aligned allocations", "[poolallocator]")
+{
+    PoolAllocatorArena arena;
+    PoolAllocator<AllocatorWide> alloc(arena);
+    AllocatorWide* p = alloc.allocate(1);
+    REQUIRE(p != nullptr);
+    CHECK((reinterpret_cast<uintptr_t>(p) % alignof(AllocatorWide)) == 0u);
+    CHECK(alloc.pool()->calc_stats().num_allocations == 1u);
+    AllocatorWide* a = alloc.allocate(4);
+    REQUIRE(a != nullptr);
+    CHECK((reinterpret_cast<uintptr_t>(a) % alignof(AllocatorWide)) == 0u);
+    alloc.deallocate(a, 4);
+    alloc.deallocate(p, 1);
+    CHECK(alloc.pool()->calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("PoolAllocator rebinding and equality", "[poolallocator]")
+{
+    PoolAllocatorArena arena;
+    PoolAllocator<uint32_t> a(arena);
+    PoolAllocator<double> b(a);
+    std::allocator_traits<PoolAllocator<uint32_t> >::rebind_alloc<double> c(a);
+    CHECK(a == b);
+    CHECK(!(a != b));
+    CHECK(b == c);
+    static_assert(std::is_same<decltype(c), PoolAllocator<double> >::value, "rebind");
+    // rebound allocators take their pool from the same arena
+    CHECK(&b.arena() == &arena);
+    CHECK(b.pool() == c.pool());
+    CHECK(b.pool() == arena.pool<PoolAllocator<double>::Storage>());
+    // allocators from other arenas are not equal
+    PoolAllocatorArena other;
+    PoolAllocator<uint32_t> d(other);
+    CHECK(a != d);
+    CHECK(a.pool() != d.pool());
+    // default allocators use the thread's arena
+    PoolAllocator<uint32_t> e;
+    CHECK(&e.arena() == &PoolAllocatorArena::thread_arena());
+    CHECK(e == PoolAllocator<double>());
+    CHECK(e != a);
+}
+
+TEST_CASE("PoolAllocator with node based containers", "[poolallocator]")
+{
+    PoolAllocatorArena arena;
+    {
+        std::list<uint32_t, PoolAllocator<uint32_t> > l((PoolAllocator<uint32_t>(arena)));
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            l.push_back(i);
+        }
+        l.remove_if([](uint32_t i)
+            {
+                return i % 2 == 0;
+            });
+        CHECK(l.size() == 500u);
+        CHECK(l.front() == 1u);
+        CHECK(l.back() == 999u);
+    }
+    {
+        typedef std::pair<const uint32_t, uint32_t> ValueT;
+        typedef std::map<uint32_t, uint32_t, std::less<uint32_t>, PoolAllocator<ValueT> > MapT;
+        MapT m((PoolAllocator<ValueT>(arena)));
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            m[i] = i * 2;
+        }
+        for (uint32_t i = 0; i < 1000; i += 3)
+        {
+            m.erase(i);
+        }
+        CHECK(m.size() == 666u);
+        CHECK(m[1] == 2u);
+        // copies and swaps share the pool
+        auto m2 = m;
+        m2.swap(m);
+        CHECK(m2.size() == 666u);
+        CHECK(m2.get_allocator() == m.get_allocator());
+        // assignment from a container on another arena takes its allocator,
+        // so nodes are freed into the pool they came from
+        PoolAllocatorArena other;
+        MapT m3((PoolAllocator<ValueT>(other)));
+        m3[1] = 1;
+        m3 = m2;
+        CHECK(&m3.get_allocator().arena() == &arena);
+        m3 = MapT((PoolAllocator<ValueT>(other)));
+        CHECK(&m3.get_allocator().arena() == &other);
+    }
+    {
+        typedef std::pair<const uint32_t, uint32_t> ValueT;
+        std::unordered_map<uint32_t, uint32_t, std::hash<uint32_t>, std::equal_to<uint32_t>,
+            PoolAllocator<ValueT> >
+            m(16, std::hash<uint32_t>(), std::equal_to<uint32_t>(), PoolAllocator<ValueT>(arena));
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            m[i] = i;
+        }
+        for (uint32_t i = 0; i < 1000; i += 2)
+        {
+            m.erase(i);
+        }
+        CHECK(m.size() == 500u);
+        CHECK(m.count(1) == 1u);
+        CHECK(m.count(2) == 0u);
+    }
+}
+
+TEST_CASE("PoolAllocator thread arenas", "[poolallocator]")
+{
+    // each thread's default allocators use its own arena, so containers on
+    // different threads never share a pool
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> threads;
+    for (uint16_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&failed, t]
+            {
+                for (int round = 0; round < 20; ++round)
+                {
+                    std::list<uint16_t, PoolAllocator<uint16_t> > l;
+                    if (&l.get_allocator().arena() != &PoolAllocatorArena::thread_arena())
+                    {
+                        failed = true;
+                    }
+                    for (uint16_t i = 0; i < 500; ++i)
+                    {
+                        l.push_back(t);
+                    }
+                    for (uint16_t value : l)
+                    {
+                        if (value != t)
+                        {
+                            failed = true;
+                        }
+                    }
+                }
+            });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(!failed);
+}
+
+} // namespace tests
+
+#endif // UNIT_TESTS
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef _BITS_POOL_ALLOCATOR_HPP_
+#define _BITS_POOL_ALLOCATOR_HPP_
+
+#include "object_pool.hpp"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/// PoolAllocatorArena owns the pools PoolAllocators allocate from, one
+/// DynamicObjectPool for each entry size and alignment, each created when an
+/// allocator first needs it. Allocators made from an arena, and any rebound
+/// from them, share its pools.
+///
+/// Neither the arena nor its allocators lock, so an arena and the containers
+/// using it must only be used by one thread at a time.
+class PoolAllocatorArena
+{
+public:
+    PoolAllocatorArena();
+
+    /// Destroys the arena's pools. A pool with objects still allocated is
+    /// left alive, so containers the arena outlives, such as those with
+    /// static storage duration, may still free into it.
+    ~PoolAllocatorArena();
+
+    /// Returns the pool for entries of type Storage, creating it if needed.
+    /// Returns nullptr if the pool can't be allocated.
+    template <typename Storage>
+    DynamicObjectPool<Storage>* pool();
+
+    /// Returns the calling thread's arena, used by default constructed
+    /// allocators
+    static PoolAllocatorArena& thread_arena();
+
+private:
+    /// A type erased pool with the functions to inspect and destroy it
+    struct PoolInfo
+    {
+        size_t size;
+        size_t align;
+        void* pool;
+        bool (*in_use)(const void* pool);
+        void (*destroy)(void* pool);
+    };
+
+    template <typename Storage>
+    static bool pool_in_use(const void* pool);
+    template <typename Storage>
+    static void destroy_pool(void* pool);
+
+    std::vector<PoolInfo> pools_;
+
+    PoolAllocatorArena(const PoolAllocatorArena&) = delete;
+    PoolAllocatorArena& operator=(const PoolAllocatorArena&) = delete;
+};
+
+/// PoolAllocator is a standard C++11 allocator for node based containers
+/// such as std::list, std::map and std::unordered_map.
+///
+/// Single object allocations, which is how node based containers allocate
+/// their nodes, come from a DynamicObjectPool of storage sized and aligned
+/// for T, owned by the PoolAllocatorArena the allocator was made from. Each
+/// container rebinds the allocator to its node type, which takes the node
+/// type's pool from the same arena. Allocations of more than one object,
+/// such as unordered_map bucket arrays, fall back to the heap.
+///
+/// Allocators compare equal when they use the same arena. They propagate
+/// with their containers on copy and move assignment and swap, so a
+/// container's nodes always return to the pool they came from. A default
+/// constructed allocator uses the constructing thread's arena, so containers
+/// using one must stay on that thread.
+template <typename T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef std::false_type is_always_equal;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef PoolAllocator<U> other;
+    };
+
+    /// Storage for a single T, the pool's entry type
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+    typedef DynamicObjectPool<Storage> PoolT;
+
+    /// Allocates from the calling thread's arena
+    PoolAllocator();
+    /// Allocates from the given arena, which must outlive any container
+    /// using the allocator
+    explicit PoolAllocator(PoolAllocatorArena& arena);
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other);
+
+    /// Allocates storage for n objects, from the pool if n is 1
+    T* allocate(size_t n);
+
+    /// Frees storage for n objects, n must match the allocate call
+    void deallocate(T* ptr, size_t n);
+
+    /// Returns the arena the allocator's pools come from
+    PoolAllocatorArena& arena() const;
+
+    /// Returns the pool single allocations come from, taking it from the
+    /// arena on first use. Returns nullptr if the pool can't be allocated.
+    PoolT* pool() const;
+
+private:
+    /// Whether T is aligned beyond what operator new guarantees
+    typedef std::integral_constant<bool, (alignof(T) > alignof(std::max_align_t))>
+        over_aligned_t;
+
+    /// Allocate and free arrays on the heap, aligned for T
+    static T* heap_allocate(size_t n, std::true_type);
+    static T* heap_allocate(size_t n, std::false_type);
+    static void heap_deallocate(T* ptr, std::true_type);
+    static void heap_deallocate(T* ptr, std::false_type);
+
+    PoolAllocatorArena* arena_;
+    /// the arena's pool for T, nullptr until first used so rebinding to
+    /// types which are only allocated in arrays creates no pool
+    mutable PoolT* pool_;
+
+    template <typename U>
+    friend class PoolAllocator;
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs);
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs);
+
+#include "pool_allocator.inl"
+
+#endif // _BITS_POOL_ALLOCATOR_HPP_
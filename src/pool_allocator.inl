@@ -0,0 +1,166 @@
+// Header guards an include is for code completion in IDEs
+// Don't include this file directly!
+#ifndef _BITS_POOL_ALLOCATOR_INL_
+#define _BITS_POOL_ALLOCATOR_INL_
+
+#ifndef _BITS_POOL_ALLOCATOR_HPP_
+#include "pool_allocator.hpp"
+#endif
+
+namespace detail
+{
+
+/// Target size in bytes of the entry storage of PoolAllocator blocks
+const size_t POOL_ALLOCATOR_BLOCK_BYTES = 16384;
+
+/// Returns the number of entries per PoolAllocator block for the given entry
+/// size, at least 64 so small blocks don't dominate with metadata.
+inline index_t pool_allocator_entries_per_block(size_t entry_size)
+{
+    return static_cast<index_t>(std::max<size_t>(64, POOL_ALLOCATOR_BLOCK_BYTES / entry_size));
+}
+
+} // namespace detail
+
+
+template <typename Storage>
+DynamicObjectPool<Storage>* PoolAllocatorArena::pool()
+{
+    // storage types are identified by their size and alignment
+    for (const PoolInfo& info : pools_)
+    {
+        if (info.size == sizeof(Storage) && info.align == alignof(Storage))
+        {
+            return static_cast<DynamicObjectPool<Storage>*>(info.pool);
+        }
+    }
+    DynamicObjectPool<Storage>* pool = new (std::nothrow)
+        DynamicObjectPool<Storage>(detail::pool_allocator_entries_per_block(sizeof(Storage)));
+    if (pool)
+    {
+        PoolInfo info = {sizeof(Storage), alignof(Storage), pool, &pool_in_use<Storage>,
+            &destroy_pool<Storage>};
+        pools_.push_back(info);
+    }
+    return pool;
+}
+
+template <typename Storage>
+bool PoolAllocatorArena::pool_in_use(const void* pool)
+{
+    return static_cast<const DynamicObjectPool<Storage>*>(pool)->calc_stats().num_allocations
+        != 0;
+}
+
+template <typename Storage>
+void PoolAllocatorArena::destroy_pool(void* pool)
+{
+    delete static_cast<DynamicObjectPool<Storage>*>(pool);
+}
+
+template <typename T>
+PoolAllocator<T>::PoolAllocator() : arena_(&PoolAllocatorArena::thread_arena()), pool_(nullptr)
+{
+}
+
+template <typename T>
+PoolAllocator<T>::PoolAllocator(PoolAllocatorArena& arena) : arena_(&arena), pool_(nullptr)
+{
+}
+
+template <typename T>
+template <typename U>
+PoolAllocator<T>::PoolAllocator(const PoolAllocator<U>& other)
+    : arena_(other.arena_), pool_(nullptr)
+{
+}
+
+template <typename T>
+PoolAllocatorArena& PoolAllocator<T>::arena() const
+{
+    return *arena_;
+}
+
+template <typename T>
+typename PoolAllocator<T>::PoolT* PoolAllocator<T>::pool() const
+{
+    if (!pool_)
+    {
+        pool_ = arena_->pool<Storage>();
+    }
+    return pool_;
+}
+
+template <typename T>
+T* PoolAllocator<T>::allocate(size_t n)
+{
+    if (n == 1)
+    {
+        PoolT* pool = this->pool();
+        if (Storage* ptr = pool ? pool->new_object() : nullptr)
+        {
+            return reinterpret_cast<T*>(ptr);
+        }
+        throw std::bad_alloc();
+    }
+    if (n > SIZE_MAX / sizeof(T))
+    {
+        throw std::bad_array_new_length();
+    }
+    return heap_allocate(n, over_aligned_t());
+}
+
+template <typename T>
+void PoolAllocator<T>::deallocate(T* ptr, size_t n)
+{
+    if (n == 1)
+    {
+        pool()->delete_object(reinterpret_cast<Storage*>(ptr));
+    }
+    else
+    {
+        heap_deallocate(ptr, over_aligned_t());
+    }
+}
+
+template <typename T>
+T* PoolAllocator<T>::heap_allocate(size_t n, std::true_type)
+{
+    if (void* ptr = detail::aligned_malloc(n * sizeof(T), alignof(T)))
+    {
+        return static_cast<T*>(ptr);
+    }
+    throw std::bad_alloc();
+}
+
+template <typename T>
+T* PoolAllocator<T>::heap_allocate(size_t n, std::false_type)
+{
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+}
+
+template <typename T>
+void PoolAllocator<T>::heap_deallocate(T* ptr, std::true_type)
+{
+    detail::aligned_free(ptr);
+}
+
+template <typename T>
+void PoolAllocator<T>::heap_deallocate(T* ptr, std::false_type)
+{
+    ::operator delete(ptr);
+}
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+    return &lhs.arena() == &rhs.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>& lhs, const PoolAllocator<U>& rhs)
+{
+    return &lhs.arena() != &rhs.arena();
+}
+
+#endif // _BITS_POOL_ALLOCATOR_INL_
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#include "pool_memory_resource.hpp"
+
+#if OBJECT_POOL_HAS_PMR
+
+pool_memory_resource::pool_memory_resource()
+    : pool_memory_resource(std::pmr::get_default_resource())
+{
+}
+
+pool_memory_resource::pool_memory_resource(std::pmr::memory_resource* upstream)
+    : upstream_(upstream)
+{
+}
+
+std::pmr::memory_resource* pool_memory_resource::upstream_resource() const
+{
+    return upstream_;
+}
+
+ObjectPoolStats pool_memory_resource::calc_stats() const
+{
+    ObjectPoolStats stats;
+    buckets_.add_stats(stats);
+    return stats;
+}
+
+void* pool_memory_resource::do_allocate(size_t bytes, size_t alignment)
+{
+    if (bytes <= MAX_BUCKET_SIZE && alignment <= MAX_BUCKET_ALIGN)
+    {
+        // bucket entries are aligned to their size
+        if (void* ptr = buckets_.allocate(std::max(bytes, alignment)))
+        {
+            return ptr;
+        }
+        throw std::bad_alloc();
+    }
+    return upstream_->allocate(bytes, alignment);
+}
+
+void pool_memory_resource::do_deallocate(void* ptr, size_t bytes, size_t alignment)
+{
+    if (bytes <= MAX_BUCKET_SIZE && alignment <= MAX_BUCKET_ALIGN)
+    {
+        buckets_.deallocate(ptr, std::max(bytes, alignment));
+    }
+    else
+    {
+        upstream_->deallocate(ptr, bytes, alignment);
+    }
+}
+
+bool pool_memory_resource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tests
+{
+
+TEST_CASE("pool_memory_resource buckets", "[pmr]")
+{
+    pool_memory_resource mr;
+    // every size up to the largest bucket comes from the pools
+    std::vector<std::pair<void*, size_t> > v;
+    for (size_t size = 0; size <= pool_memory_resource::MAX_BUCKET_SIZE; size += 7)
+    {
+        void* p = mr.allocate(size, alignof(uint64_t));
+        REQUIRE(p != nullptr);
+        CHECK((reinterpret_cast<uintptr_t>(p) & (alignof(uint64_t) - 1)) == 0);
+        ::memset(p, static_cast<int>(size), size);
+        v.push_back(std::make_pair(p, size));
+    }
+    CHECK(mr.calc_stats().num_allocations == v.size());
+    for (auto& a : v)
+    {
+        // allocations must not overlap
+        const unsigned char* bytes = static_cast<const unsigned char*>(a.first);
+        if (a.second != 0)
+        {
+            CHECK(bytes[0] == static_cast<unsigned char>(a.second));
+            CHECK(bytes[a.second - 1] == static_cast<unsigned char>(a.second));
+        }
+        mr.deallocate(a.first, a.second, alignof(uint64_t));
+    }
+    CHECK(mr.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("pool_memory_resource over aligned requests", "[pmr]")
+{
+    pool_memory_resource mr;
+    // alignments up to the largest bucket come from the pools
+    std::vector<void*> v;
+    for (size_t align = 16; align <= pool_memory_resource::MAX_BUCKET_ALIGN; align *= 2)
+    {
+        void* p = mr.allocate(24, align);
+        REQUIRE(p != nullptr);
+        CHECK((reinterpret_cast<uintptr_t>(p) & (align - 1)) == 0);
+        void* q = mr.allocate(24, align);
+        REQUIRE(q != nullptr);
+        CHECK((reinterpret_cast<uintptr_t>(q) & (align - 1)) == 0);
+        v.push_back(p);
+        v.push_back(q);
+    }
+    CHECK(mr.calc_stats().num_allocations == v.size());
+    for (size_t i = 0; i != v.size(); ++i)
+    {
+        mr.deallocate(v[i], 24, size_t(16) << (i / 2));
+    }
+    CHECK(mr.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("pool_memory_resource passes large requests upstream", "[pmr]")
+{
+    pool_memory_resource mr;
+    CHECK(mr.upstream_resource() == std::pmr::get_default_resource());
+    void* large = mr.allocate(pool_memory_resource::MAX_BUCKET_SIZE + 1);
+    const size_t page_align = pool_memory_resource::MAX_BUCKET_ALIGN * 2;
+    void* aligned = mr.allocate(16, page_align);
+    CHECK((reinterpret_cast<uintptr_t>(aligned) & (page_align - 1)) == 0);
+    CHECK(mr.calc_stats().num_allocations == 0u);
+    mr.deallocate(large, pool_memory_resource::MAX_BUCKET_SIZE + 1);
+    mr.deallocate(aligned, 16, page_align);
+    pool_memory_resource other;
+    CHECK(mr.is_equal(mr));
+    CHECK(!mr.is_equal(other));
+}
+
+TEST_CASE("pool_memory_resource with pmr containers", "[pmr]")
+{
+    pool_memory_resource mr;
+    {
+        std::pmr::map<uint32_t, std::pmr::string> m(&mr);
+        for (uint32_t i = 0; i < 1000; ++i)
+        {
+            m.emplace(i, std::pmr::string(64, 'a' + i % 26));
+        }
+        for (uint32_t i = 0; i < 1000; i += 2)
+        {
+            m.erase(i);
+        }
+        CHECK(m.size() == 500u);
+        CHECK(m[1] == std::pmr::string(64, 'b'));
+        std::pmr::vector<uint32_t> v(&mr);
+        for (uint32_t i = 0; i < 100; ++i)
+        {
+            v.push_back(i);
+        }
+        CHECK(v[99] == 99u);
+        CHECK(mr.calc_stats().num_allocations > 500u);
+    }
+    CHECK(mr.calc_stats().num_allocations == 0u);
+}
+
+} // namespace tests
+
+#endif // UNIT_TESTS
+
+#endif // OBJECT_POOL_HAS_PMR
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef _BITS_POOL_MEMORY_RESOURCE_HPP_
+#define _BITS_POOL_MEMORY_RESOURCE_HPP_
+
+#include "object_pool.hpp"
+
+// pool_memory_resource needs C++17 and a standard library with
+// <memory_resource>, it is left out of other builds.
+#if (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)) \
+    && defined(__has_include)
+#if __has_include(<memory_resource>)
+#define OBJECT_POOL_HAS_PMR 1
+#endif
+#endif
+
+#if OBJECT_POOL_HAS_PMR
+
+#include <memory_resource>
+
+namespace detail
+{
+
+/// Storage for one pool_memory_resource allocation of up to Size bytes.
+/// Entries are aligned to their power of two size, so each bucket serves any
+/// alignment up to its size.
+template <size_t Size>
+struct PmrEntry
+{
+    typename std::aligned_storage<Size, Size>::type storage;
+};
+
+/// A chain of DynamicObjectPools for power of two sizes from Size up to
+/// MaxSize, each serving requests larger than the previous bucket's size.
+template <size_t Size, size_t MaxSize, bool End = (Size > MaxSize)>
+class PmrBuckets
+{
+public:
+    PmrBuckets();
+
+    /// Allocates from the smallest bucket of at least size bytes
+    void* allocate(size_t size);
+
+    /// Frees to the bucket allocate chose for the same size
+    void deallocate(void* ptr, size_t size);
+
+    /// Adds the stats of each bucket to stats
+    void add_stats(ObjectPoolStats& stats) const;
+
+private:
+    DynamicObjectPool<PmrEntry<Size> > pool_;
+    PmrBuckets<Size * 2, MaxSize> next_;
+};
+
+/// End of the bucket chain
+template <size_t Size, size_t MaxSize>
+class PmrBuckets<Size, MaxSize, true>
+{
+public:
+    void* allocate(size_t) { return nullptr; }
+    void deallocate(void*, size_t) {}
+    void add_stats(ObjectPoolStats&) const {}
+};
+
+} // namespace detail
+
+/// pool_memory_resource is a std::pmr::memory_resource which serves small
+/// allocations from DynamicObjectPools, one per power of two size from 8 to
+/// MAX_BUCKET_SIZE bytes. Each bucket's entries are aligned to its size, so
+/// over aligned requests use the bucket of their alignment if that is larger
+/// than their size. Larger allocations and alignments are passed to an
+/// upstream resource.
+///
+/// Any pmr container, e.g. std::pmr::vector, std::pmr::string or
+/// std::pmr::map, can use it without template changes. Like
+/// std::pmr::unsynchronized_pool_resource it is not thread safe.
+class pool_memory_resource : public std::pmr::memory_resource
+{
+public:
+    /// Largest allocation served from the pools
+    static const size_t MAX_BUCKET_SIZE = 4096;
+    /// Largest alignment served from the pools
+    static const size_t MAX_BUCKET_ALIGN = MAX_BUCKET_SIZE;
+
+    pool_memory_resource();
+    explicit pool_memory_resource(std::pmr::memory_resource* upstream);
+
+    /// Returns the resource large and over aligned allocations are passed to
+    std::pmr::memory_resource* upstream_resource() const;
+
+    /// Calculates stats summed over every bucket's pool. Allocations passed
+    /// upstream are not included.
+    ObjectPoolStats calc_stats() const;
+
+protected:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    detail::PmrBuckets<8, MAX_BUCKET_SIZE> buckets_;
+    std::pmr::memory_resource* upstream_;
+
+    pool_memory_resource(const pool_memory_resource&) = delete;
+    pool_memory_resource& operator=(const pool_memory_resource&) = delete;
+};
+
+#include "pool_memory_resource.inl"
+
+#endif // OBJECT_POOL_HAS_PMR
+
+#endif // _BITS_POOL_MEMORY_RESOURCE_HPP_
@@ -0,0 +1,63 @@
+// Header guards an include is for code completion in IDEs
+// Don't include this file directly!
+#ifndef _BITS_POOL_MEMORY_RESOURCE_INL_
+#define _BITS_POOL_MEMORY_RESOURCE_INL_
+
+#ifndef _BITS_POOL_MEMORY_RESOURCE_HPP_
+#include "pool_memory_resource.hpp"
+#endif
+
+namespace detail
+{
+
+/// Target size in bytes of the entry storage of pool_memory_resource blocks
+const size_t PMR_BLOCK_BYTES = 16384;
+
+template <size_t Size, size_t MaxSize, bool End>
+PmrBuckets<Size, MaxSize, End>::PmrBuckets()
+    : pool_(static_cast<index_t>(std::max<size_t>(64, PMR_BLOCK_BYTES / Size)))
+{
+}
+
+template <size_t Size, size_t MaxSize, bool End>
+void* PmrBuckets<Size, MaxSize, End>::allocate(size_t size)
+{
+    if (size <= Size)
+    {
+        return pool_.new_object();
+    }
+    return next_.allocate(size);
+}
+
+template <size_t Size, size_t MaxSize, bool End>
+void PmrBuckets<Size, MaxSize, End>::deallocate(void* ptr, size_t size)
+{
+    if (size <= Size)
+    {
+        pool_.delete_object(static_cast<PmrEntry<Size>*>(ptr));
+    }
+    else
+    {
+        next_.deallocate(ptr, size);
+    }
+}
+
+template <size_t Size, size_t MaxSize, bool End>
+void PmrBuckets<Size, MaxSize, End>::add_stats(ObjectPoolStats& stats) const
+{
+    const ObjectPoolStats pool_stats = pool_.calc_stats();
+    stats.num_blocks += pool_stats.num_blocks;
+    stats.num_allocations += pool_stats.num_allocations;
+    stats.high_water_mark += pool_stats.high_water_mark;
+    stats.peak_blocks += pool_stats.peak_blocks;
+    stats.bytes_reserved += pool_stats.bytes_reserved;
+    stats.bytes_metadata += pool_stats.bytes_metadata;
+    stats.total_allocations += pool_stats.total_allocations;
+    stats.total_frees += pool_stats.total_frees;
+    stats.failed_allocations += pool_stats.failed_allocations;
+    next_.add_stats(stats);
+}
+
+} // namespace detail
+
+#endif // _BITS_POOL_MEMORY_RESOURCE_INL_
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#include "pool_ptr.hpp"
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace tests
+{
+
+struct Counted
+{
+    explicit Counted(int value) : value_(value) { ++s_live; }
+    ~Counted() { --s_live; }
+    int value_;
+    static int s_live;
+};
+
+int Counted::s_live = 0;
+
+FixedObjectPool<Counted> g_counted_pool(16);
+
+typedef static_pooled_ptr<FixedObjectPool<Counted>, g_counted_pool> StaticCountedPtr;
+
+static_assert(sizeof(StaticCountedPtr) == sizeof(Counted*),
+    "pool_ptr to a static pool is the size of a raw pointer");
+static_assert(sizeof(pooled_ptr<FixedObjectPool<Counted> >) == sizeof(Counted*),
+    "pool_ptr to a FixedObjectPool finds the pool from the object");
+static_assert(sizeof(pooled_ptr<DynamicObjectPool<Counted> >) == 2 * sizeof(Counted*),
+    "pool_ptr to a DynamicObjectPool stores one pool pointer");
+
+template <typename PoolT>
+void checkPoolPtr(PoolT& pool)
+{
+    {
+        pooled_ptr<PoolT> p = make_pooled(pool, 7);
+        REQUIRE(p);
+        CHECK(p->value_ == 7);
+        CHECK((*p).value_ == 7);
+        CHECK(Counted::s_live == 1);
+        CHECK(pool.calc_stats().num_allocations == 1);
+
+        // moving transfers ownership without touching the pool
+        pooled_ptr<PoolT> q(std::move(p));
+        CHECK(p == nullptr);
+        CHECK(q != nullptr);
+        CHECK(pool.calc_stats().num_allocations == 1);
+
+        pooled_ptr<PoolT> r = make_pooled(pool, 8);
+        r = std::move(q);
+        CHECK(r->value_ == 7);
+        CHECK(Counted::s_live == 1);
+        CHECK(pool.calc_stats().num_allocations == 1);
+
+        // released objects must be deleted by the caller
+        Counted* raw = r.release();
+        CHECK(!r);
+        CHECK(pool.calc_stats().num_allocations == 1);
+        r.reset(raw);
+        r = nullptr;
+        CHECK(Counted::s_live == 0);
+        CHECK(pool.calc_stats().num_allocations == 0);
+
+        std::vector<pooled_ptr<PoolT> > ptrs;
+        for (int i = 0; i < 10; ++i)
+        {
+            ptrs.push_back(make_pooled(pool, i));
+        }
+        CHECK(Counted::s_live == 10);
+        ptrs[0].swap(ptrs[9]);
+        CHECK(ptrs[0]->value_ == 9);
+        CHECK(ptrs[9]->value_ == 0);
+    }
+    CHECK(Counted::s_live == 0);
+    CHECK(pool.calc_stats().num_allocations == 0);
+}
+
+TEST_CASE("pool_ptr with FixedObjectPool", "[poolptr]")
+{
+    FixedObjectPool<Counted> pool(16);
+    checkPoolPtr(pool);
+    // an exhausted pool gives an empty pointer
+    std::vector<pooled_ptr<FixedObjectPool<Counted> > > ptrs;
+    for (int i = 0; i < 16; ++i)
+    {
+        ptrs.push_back(make_pooled(pool, i));
+    }
+    CHECK(!make_pooled(pool, 16));
+}
+
+TEST_CASE("pool_ptr with DynamicObjectPool", "[poolptr]")
+{
+    DynamicObjectPool<Counted> pool(4);
+    checkPoolPtr(pool);
+    pooled_ptr<DynamicObjectPool<Counted> > p = make_pooled(pool, 1);
+    CHECK(p.get_deleter().pool == &pool);
+}
+
+TEST_CASE("pool_ptr with many FixedObjectPools", "[poolptr]")
+{
+    // pools of different sizes have different block alignments, each object
+    // must still be returned to its own pool
+    std::vector<std::unique_ptr<FixedObjectPool<Counted> > > pools;
+    std::vector<pooled_ptr<FixedObjectPool<Counted> > > ptrs;
+    for (uint32_t i = 0; i < 200; ++i)
+    {
+        pools.emplace_back(new FixedObjectPool<Counted>(1 + i % 50 * 7));
+        ptrs.push_back(make_pooled(*pools.back(), static_cast<int>(i)));
+        REQUIRE(FixedObjectPool<Counted>::from_pointer(ptrs.back().get()) == pools.back().get());
+    }
+    // destroying pools unregisters their blocks
+    for (uint32_t i = 0; i < 200; i += 2)
+    {
+        ptrs[i] = nullptr;
+        pools[i].reset();
+    }
+    for (uint32_t i = 1; i < 200; i += 2)
+    {
+        CHECK(FixedObjectPool<Counted>::from_pointer(ptrs[i].get()) == pools[i].get());
+        ptrs[i] = nullptr;
+        CHECK(pools[i]->calc_stats().num_allocations == 0);
+    }
+    CHECK(Counted::s_live == 0);
+}
+
+TEST_CASE("pool_ptr with a static pool", "[poolptr]")
+{
+    {
+        StaticCountedPtr p = make_pooled<FixedObjectPool<Counted>, g_counted_pool>(3);
+        REQUIRE(p);
+        CHECK(p->value_ == 3);
+        CHECK(g_counted_pool.calc_stats().num_allocations == 1);
+        StaticCountedPtr q;
+        CHECK(!q);
+        q = std::move(p);
+        CHECK(!p);
+        CHECK(q->value_ == 3);
+        CHECK(g_counted_pool.calc_stats().num_allocations == 1);
+    }
+    CHECK(Counted::s_live == 0);
+    CHECK(g_counted_pool.calc_stats().num_allocations == 0);
+}
+
+} // namespace tests
+
+#endif // UNIT_TESTS
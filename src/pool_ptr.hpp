@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef _BITS_POOL_PTR_HPP_
+#define _BITS_POOL_PTR_HPP_
+
+#include "object_pool.hpp"
+
+#include <cstddef>
+#include <utility>
+
+/// Deleter which returns objects to a pool it points to. Works with any
+/// pool providing delete_object, e.g. FixedObjectPool or DynamicObjectPool.
+template <typename PoolT>
+struct PoolDeleter
+{
+    PoolT* pool;
+
+    PoolDeleter() : pool(nullptr) {}
+    PoolDeleter(PoolT& p) : pool(&p) {}
+
+    template <typename T>
+    void operator()(T* ptr) const
+    {
+        pool->delete_object(ptr);
+    }
+};
+
+/// FixedObjectPool finds the pool owning an object from its block, so its
+/// deleter has no state and a pooled_ptr is the size of a raw pointer.
+template <typename T, typename Traits>
+struct PoolDeleter<FixedObjectPool<T, Traits> >
+{
+    PoolDeleter() {}
+    PoolDeleter(FixedObjectPool<T, Traits>&) {}
+
+    void operator()(T* ptr) const
+    {
+        FixedObjectPool<T, Traits>::from_pointer(ptr)->delete_object(ptr);
+    }
+};
+
+/// Deleter which returns objects to a pool with static storage duration
+/// given as a template argument. It has no state, so a pool_ptr using it is
+/// the size of a raw pointer.
+template <typename PoolT, PoolT& Pool>
+struct StaticPoolDeleter
+{
+    template <typename T>
+    void operator()(T* ptr) const
+    {
+        Pool.delete_object(ptr);
+    }
+};
+
+/// pool_ptr is a move only smart pointer owning an object allocated from a
+/// pool, returning the object to the pool when it is destroyed or reset.
+/// Like std::unique_ptr, stateless deleters take no space.
+template <typename T, typename Deleter>
+class pool_ptr : private Deleter
+{
+public:
+    typedef T element_type;
+    typedef Deleter deleter_type;
+
+    pool_ptr();
+    pool_ptr(std::nullptr_t);
+    pool_ptr(T* ptr, const Deleter& deleter = Deleter());
+    pool_ptr(pool_ptr&& other);
+    ~pool_ptr();
+
+    pool_ptr& operator=(pool_ptr&& other);
+    pool_ptr& operator=(std::nullptr_t);
+
+    /// Returns the owned object, or nullptr
+    T* get() const;
+    T& operator*() const;
+    T* operator->() const;
+    explicit operator bool() const;
+
+    /// Gives up ownership of the object without deleting it
+    T* release();
+
+    /// Deletes the owned object, if any, and takes ownership of ptr
+    void reset(T* ptr = nullptr);
+
+    void swap(pool_ptr& other);
+
+    Deleter& get_deleter();
+    const Deleter& get_deleter() const;
+
+private:
+    T* ptr_;
+
+    pool_ptr(const pool_ptr&) = delete;
+    pool_ptr& operator=(const pool_ptr&) = delete;
+};
+
+/// pool_ptr for objects from a pool referenced by each pointer, except for a
+/// FixedObjectPool which is found from the object
+template <typename PoolT>
+using pooled_ptr = pool_ptr<typename PoolT::value_t, PoolDeleter<PoolT> >;
+
+/// pool_ptr for objects from a pool with static storage duration, the same
+/// size as a raw pointer
+template <typename PoolT, PoolT& Pool>
+using static_pooled_ptr = pool_ptr<typename PoolT::value_t, StaticPoolDeleter<PoolT, Pool> >;
+
+/// Constructs an object in the given pool, forwarding params to its
+/// constructor. Returns an empty pointer if the pool is out of space.
+template <typename PoolT, class... P>
+pooled_ptr<PoolT> make_pooled(PoolT& pool, P&&... params);
+
+/// Constructs an object in the pool given as a template argument, e.g.
+/// make_pooled<decltype(g_pool), g_pool>(params...).
+template <typename PoolT, PoolT& Pool, class... P>
+static_pooled_ptr<PoolT, Pool> make_pooled(P&&... params);
+
+template <typename T, typename D>
+bool operator==(const pool_ptr<T, D>& lhs, const pool_ptr<T, D>& rhs);
+template <typename T, typename D>
+bool operator!=(const pool_ptr<T, D>& lhs, const pool_ptr<T, D>& rhs);
+template <typename T, typename D>
+bool operator==(const pool_ptr<T, D>& lhs, std::nullptr_t);
+template <typename T, typename D>
+bool operator!=(const pool_ptr<T, D>& lhs, std::nullptr_t);
+
+#include "pool_ptr.inl"
+
+#endif // _BITS_POOL_PTR_HPP_
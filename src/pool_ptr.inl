@@ -0,0 +1,152 @@
+// Header guards an include is for code completion in IDEs
+// Don't include this file directly!
+#ifndef _BITS_POOL_PTR_INL_
+#define _BITS_POOL_PTR_INL_
+
+#ifndef _BITS_POOL_PTR_HPP_
+#include "pool_ptr.hpp"
+#endif
+
+template <typename T, typename Deleter>
+pool_ptr<T, Deleter>::pool_ptr() : ptr_(nullptr)
+{
+}
+
+template <typename T, typename Deleter>
+pool_ptr<T, Deleter>::pool_ptr(std::nullptr_t) : ptr_(nullptr)
+{
+}
+
+template <typename T, typename Deleter>
+pool_ptr<T, Deleter>::pool_ptr(T* ptr, const Deleter& deleter) : Deleter(deleter), ptr_(ptr)
+{
+}
+
+template <typename T, typename Deleter>
+pool_ptr<T, Deleter>::pool_ptr(pool_ptr&& other)
+    : Deleter(std::move(other.get_deleter())), ptr_(other.release())
+{
+}
+
+template <typename T, typename Deleter>
+pool_ptr<T, Deleter>::~pool_ptr()
+{
+    reset();
+}
+
+template <typename T, typename Deleter>
+pool_ptr<T, Deleter>& pool_ptr<T, Deleter>::operator=(pool_ptr&& other)
+{
+    reset(other.release());
+    get_deleter() = std::move(other.get_deleter());
+    return *this;
+}
+
+template <typename T, typename Deleter>
+pool_ptr<T, Deleter>& pool_ptr<T, Deleter>::operator=(std::nullptr_t)
+{
+    reset();
+    return *this;
+}
+
+template <typename T, typename Deleter>
+T* pool_ptr<T, Deleter>::get() const
+{
+    return ptr_;
+}
+
+template <typename T, typename Deleter>
+T& pool_ptr<T, Deleter>::operator*() const
+{
+    assert(ptr_ != nullptr);
+    return *ptr_;
+}
+
+template <typename T, typename Deleter>
+T* pool_ptr<T, Deleter>::operator->() const
+{
+    assert(ptr_ != nullptr);
+    return ptr_;
+}
+
+template <typename T, typename Deleter>
+pool_ptr<T, Deleter>::operator bool() const
+{
+    return ptr_ != nullptr;
+}
+
+template <typename T, typename Deleter>
+T* pool_ptr<T, Deleter>::release()
+{
+    T* ptr = ptr_;
+    ptr_ = nullptr;
+    return ptr;
+}
+
+template <typename T, typename Deleter>
+void pool_ptr<T, Deleter>::reset(T* ptr)
+{
+    T* old = ptr_;
+    ptr_ = ptr;
+    if (old)
+    {
+        get_deleter()(old);
+    }
+}
+
+template <typename T, typename Deleter>
+void pool_ptr<T, Deleter>::swap(pool_ptr& other)
+{
+    std::swap(get_deleter(), other.get_deleter());
+    std::swap(ptr_, other.ptr_);
+}
+
+template <typename T, typename Deleter>
+Deleter& pool_ptr<T, Deleter>::get_deleter()
+{
+    return *this;
+}
+
+template <typename T, typename Deleter>
+const Deleter& pool_ptr<T, Deleter>::get_deleter() const
+{
+    return *this;
+}
+
+template <typename PoolT, class... P>
+pooled_ptr<PoolT> make_pooled(PoolT& pool, P&&... params)
+{
+    return pooled_ptr<PoolT>(pool.new_object(std::forward<P>(params)...), PoolDeleter<PoolT>(pool));
+}
+
+template <typename PoolT, PoolT& Pool, class... P>
+static_pooled_ptr<PoolT, Pool> make_pooled(P&&... params)
+{
+    return static_pooled_ptr<PoolT, Pool>(Pool.new_object(std::forward<P>(params)...));
+}
+
+template <typename T, typename D>
+bool operator==(const pool_ptr<T, D>& lhs, const pool_ptr<T, D>& rhs)
+{
+    return lhs.get() == rhs.get();
+}
+
+template <typename T, typename D>
+bool operator!=(const pool_ptr<T, D>& lhs, const pool_ptr<T, D>& rhs)
+{
+    return lhs.get() != rhs.get();
+}
+
+template <typename T, typename D>
+bool operator==(const pool_ptr<T, D>& lhs, std::nullptr_t)
+{
+    return lhs.get() == nullptr;
+}
+
+template <typename T, typename D>
+bool operator!=(const pool_ptr<T, D>& lhs, std::nullptr_t)
+{
+    return lhs.get() != nullptr;
+}
+
+#endif // _BITS_POOL_PTR_INL_
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#include "pooled_shared.hpp"
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+
+namespace tests
+{
+
+struct SharedAsset
+{
+    explicit SharedAsset(int id) : id_(id) { ++s_live; }
+    ~SharedAsset() { --s_live; }
+    int id_;
+    static int s_live;
+};
+
+int SharedAsset::s_live = 0;
+
+static_assert(sizeof(pooled_shared<SharedAsset>) == sizeof(SharedAsset*),
+    "pooled_shared is a single pointer");
+
+template <bool Atomic>
+void checkPooledShared()
+{
+    typedef SharedObjectPool<SharedAsset, Atomic> PoolT;
+    typedef typename PoolT::pointer_t PtrT;
+    PoolT pool(4);
+    {
+        PtrT a = pool.make_shared(1);
+        REQUIRE(a);
+        CHECK(a->id_ == 1);
+        CHECK(a.use_count() == 1u);
+        CHECK(SharedAsset::s_live == 1);
+
+        PtrT b = a;
+        CHECK(a == b);
+        CHECK(a.use_count() == 2u);
+        {
+            PtrT c(b);
+            CHECK(c.use_count() == 3u);
+            PtrT d(std::move(c));
+            CHECK(!c);
+            CHECK(d.use_count() == 3u);
+        }
+        CHECK(a.use_count() == 2u);
+
+        // the object lives until the last reference is released
+        a.reset();
+        CHECK(a == nullptr);
+        CHECK(a.use_count() == 0u);
+        CHECK(SharedAsset::s_live == 1);
+        CHECK(pool.calc_stats().num_allocations == 1);
+        b = nullptr;
+        CHECK(SharedAsset::s_live == 0);
+        CHECK(pool.calc_stats().num_allocations == 0);
+
+        // self and cross assignment
+        PtrT e = pool.make_shared(2);
+        PtrT f = pool.make_shared(3);
+        PtrT& alias = e;
+        e = alias;
+        CHECK(e.use_count() == 1u);
+        e = f;
+        CHECK(SharedAsset::s_live == 1);
+        CHECK(e->id_ == 3);
+        CHECK(f.use_count() == 2u);
+
+        std::vector<PtrT> ptrs;
+        for (int i = 0; i < 10; ++i)
+        {
+            ptrs.push_back(pool.make_shared(i));
+        }
+        int sum = 0;
+        pool.for_each([&sum](SharedAsset* asset)
+            {
+                sum += asset->id_;
+            });
+        CHECK(sum == 45 + 3);
+        CHECK(pool.calc_stats().num_allocations == 11);
+    }
+    CHECK(SharedAsset::s_live == 0);
+    CHECK(pool.calc_stats().num_allocations == 0);
+}
+
+TEST_CASE("pooled_shared reference counting", "[pooledshared]")
+{
+    checkPooledShared<true>();
+}
+
+TEST_CASE("pooled_shared non-atomic reference counting", "[pooledshared]")
+{
+    checkPooledShared<false>();
+}
+
+TEST_CASE("pooled_shared released on other threads", "[pooledshared]")
+{
+    static const size_t num_threads = 4;
+    static const int num_objects = 1000;
+    SharedObjectPool<uint64_t> pool(64);
+    std::vector<pooled_shared<uint64_t> > ptrs;
+    for (int i = 0; i < num_objects; ++i)
+    {
+        ptrs.push_back(pool.make_shared(i));
+    }
+    // every thread holds copies of all objects then drops them, racing with
+    // the other threads to release the last reference
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([ptrs]() mutable
+            {
+                for (auto& ptr : ptrs)
+                {
+                    pooled_shared<uint64_t> copy = ptr;
+                    ptr.reset();
+                }
+            });
+    }
+    ptrs.clear();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    CHECK(pool.calc_stats().num_allocations == 0);
+    // entries released remotely are collected and reused by make_shared
+    const size_t num_blocks = pool.calc_stats().num_blocks;
+    for (int i = 0; i < num_objects; ++i)
+    {
+        ptrs.push_back(pool.make_shared(i));
+    }
+    CHECK(pool.calc_stats().num_blocks == num_blocks);
+    ptrs.clear();
+}
+
+TEST_CASE("pooled_shared returns objects to their own pool", "[pooledshared]")
+{
+    // without a pool pointer per entry, the pool is found from the block
+    SharedObjectPool<SharedAsset, false> first(4);
+    SharedObjectPool<SharedAsset, false> second(4);
+    std::vector<pooled_shared<SharedAsset, false> > ptrs;
+    for (int i = 0; i < 20; ++i)
+    {
+        ptrs.push_back((i % 3 == 0 ? first : second).make_shared(i));
+    }
+    CHECK(first.calc_stats().num_allocations == 7);
+    CHECK(second.calc_stats().num_allocations == 13);
+    ptrs.erase(ptrs.begin(), ptrs.begin() + 10);
+    CHECK(first.calc_stats().num_allocations == 3);
+    CHECK(second.calc_stats().num_allocations == 7);
+    ptrs.clear();
+    CHECK(first.calc_stats().num_allocations == 0);
+    CHECK(second.calc_stats().num_allocations == 0);
+    CHECK(SharedAsset::s_live == 0);
+}
+
+} // namespace tests
+
+#endif // UNIT_TESTS
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef _BITS_POOLED_SHARED_HPP_
+#define _BITS_POOLED_SHARED_HPP_
+
+#include "concurrent_object_pool.hpp"
+#include "object_pool.hpp"
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, bool Atomic, typename Traits>
+class SharedObjectPool;
+
+namespace detail
+{
+
+/// Reference count and pool types for atomic and non-atomic sharing
+template <bool Atomic>
+struct SharedCount;
+
+template <>
+struct SharedCount<true>
+{
+    typedef std::atomic<uint32_t> count_t;
+    template <typename E, typename Traits>
+    using pool_t = ThreadOwnedObjectPool<E, Traits>;
+};
+
+template <>
+struct SharedCount<false>
+{
+    typedef uint32_t count_t;
+    template <typename E, typename Traits>
+    using pool_t = DynamicObjectPool<E, Traits>;
+};
+
+/// Increments a reference count
+inline void shared_acquire(std::atomic<uint32_t>& count);
+inline void shared_acquire(uint32_t& count);
+
+/// Decrements a reference count, returning the new count
+inline uint32_t shared_release(std::atomic<uint32_t>& count);
+inline uint32_t shared_release(uint32_t& count);
+
+/// A pool entry holding the shared object and its reference count, so a
+/// pooled_shared needs only a single pointer. The pool is found from the
+/// entry's block.
+template <typename T, bool Atomic>
+struct SharedEntry
+{
+    template <class... P>
+    SharedEntry(P&&... params);
+
+    typename SharedCount<Atomic>::count_t refs_;
+    T value_;
+};
+
+} // namespace detail
+
+/// pooled_shared is a reference counted pointer to an object in a
+/// SharedObjectPool. Unlike std::shared_ptr there is no separate control
+/// block, the count is stored in the pool entry next to the object, and the
+/// object is returned to its pool when the last reference is released.
+///
+/// With Atomic set the count may be shared between threads. Otherwise all
+/// copies must be used by a single thread.
+template <typename T, bool Atomic = true, typename Traits = ObjectPoolTraits>
+class pooled_shared
+{
+public:
+    typedef T element_type;
+
+    pooled_shared();
+    pooled_shared(std::nullptr_t);
+    pooled_shared(const pooled_shared& other);
+    pooled_shared(pooled_shared&& other);
+    ~pooled_shared();
+
+    pooled_shared& operator=(const pooled_shared& other);
+    pooled_shared& operator=(pooled_shared&& other);
+    pooled_shared& operator=(std::nullptr_t);
+
+    /// Returns the shared object, or nullptr
+    T* get() const;
+    T& operator*() const;
+    T* operator->() const;
+    explicit operator bool() const;
+
+    /// Returns the number of references to the object, or 0 if empty
+    uint32_t use_count() const;
+
+    /// Releases this reference, leaving the pointer empty
+    void reset();
+
+    void swap(pooled_shared& other);
+
+private:
+    typedef detail::SharedEntry<T, Atomic> Entry;
+
+    /// Takes ownership of a newly created entry's initial reference
+    explicit pooled_shared(Entry* entry);
+
+    Entry* entry_;
+
+    friend class SharedObjectPool<T, Atomic, Traits>;
+};
+
+/// SharedObjectPool is a DynamicObjectPool of objects shared through
+/// pooled_shared pointers. Its blocks are registered with a pointer back to
+/// the SharedObjectPool, so when the last reference is released the pool is
+/// found from the entry's block rather than stored in every entry.
+///
+/// With Atomic set the entries are kept in a ThreadOwnedObjectPool. The pool
+/// is owned by the thread which constructs it, and make_shared and the other
+/// pool functions must be called from that thread, but pointers may be
+/// copied and released on any thread. Reference counts are atomic. An object
+/// whose last reference is released on another thread is destructed there
+/// and its entry is pushed onto the pool's lock-free remote free list, which
+/// the owner collects on a later make_shared, so no lock is ever taken.
+///
+/// With Atomic unset the pool and its pointers must only be used from a
+/// single thread, and no atomic operations are used.
+///
+/// In the make+copy+release benchmark the atomic pool beats std::make_shared
+/// once the process has started a thread, but not in a single threaded
+/// process, where libstdc++ skips atomic count updates and this pool does
+/// not. Use the non-atomic pool there, which beats std::make_shared.
+template <typename T, bool Atomic = true, typename Traits = ObjectPoolTraits>
+class SharedObjectPool
+{
+public:
+    typedef detail::index_t index_t;
+    typedef T value_t;
+    typedef pooled_shared<T, Atomic, Traits> pointer_t;
+
+    SharedObjectPool(index_t entries_per_block);
+
+    /// All pointers must have been released before the pool is destroyed
+    ~SharedObjectPool();
+
+    /// Constructs a new shared object from the pool with a reference count
+    /// of one. Returns an empty pointer if there is no available space.
+    template <class... P>
+    pointer_t make_shared(P&&... params);
+
+    /// Reclaim unused object pool blocks
+    void reclaim_memory();
+
+    /// Calls the given function for all live objects. With Atomic set, no
+    /// pointer may be released on another thread while this is running.
+    template <typename F>
+    void for_each(const F func) const;
+
+    /// Calculates object pool stats. With Atomic set, no pointer may be
+    /// released on another thread while this is running.
+    ObjectPoolStats calc_stats() const;
+
+private:
+    typedef detail::SharedEntry<T, Atomic> Entry;
+    typedef typename detail::SharedCount<Atomic>::template pool_t<Entry, Traits> Pool;
+
+    /// Returns an entry whose count has reached zero to its pool
+    static void release(Entry* entry);
+
+    Pool pool_;
+
+    friend class pooled_shared<T, Atomic, Traits>;
+
+    SharedObjectPool(const SharedObjectPool&) = delete;
+    SharedObjectPool& operator=(const SharedObjectPool&) = delete;
+};
+
+template <typename T, bool A, typename Tr>
+bool operator==(const pooled_shared<T, A, Tr>& lhs, const pooled_shared<T, A, Tr>& rhs);
+template <typename T, bool A, typename Tr>
+bool operator!=(const pooled_shared<T, A, Tr>& lhs, const pooled_shared<T, A, Tr>& rhs);
+template <typename T, bool A, typename Tr>
+bool operator==(const pooled_shared<T, A, Tr>& lhs, std::nullptr_t);
+template <typename T, bool A, typename Tr>
+bool operator!=(const pooled_shared<T, A, Tr>& lhs, std::nullptr_t);
+
+#include "pooled_shared.inl"
+
+#endif // _BITS_POOLED_SHARED_HPP_
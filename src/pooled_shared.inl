@@ -0,0 +1,227 @@
+// Header guards an include is for code completion in IDEs
+// Don't include this file directly!
+#ifndef _BITS_POOLED_SHARED_INL_
+#define _BITS_POOLED_SHARED_INL_
+
+#ifndef _BITS_POOLED_SHARED_HPP_
+#include "pooled_shared.hpp"
+#endif
+
+namespace detail
+{
+
+void shared_acquire(std::atomic<uint32_t>& count)
+{
+    // a new reference is made from an existing one, so needs no ordering
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void shared_acquire(uint32_t& count)
+{
+    ++count;
+}
+
+uint32_t shared_release(std::atomic<uint32_t>& count)
+{
+    // writes through other references must be visible before destruction
+    return count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+}
+
+uint32_t shared_release(uint32_t& count)
+{
+    return --count;
+}
+
+template <typename T, bool Atomic>
+template <class... P>
+SharedEntry<T, Atomic>::SharedEntry(P&&... params)
+    : refs_(1), value_(std::forward<P>(params)...)
+{
+}
+
+} // namespace detail
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>::pooled_shared() : entry_(nullptr)
+{
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>::pooled_shared(std::nullptr_t) : entry_(nullptr)
+{
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>::pooled_shared(Entry* entry) : entry_(entry)
+{
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>::pooled_shared(const pooled_shared& other)
+    : entry_(other.entry_)
+{
+    if (entry_)
+    {
+        detail::shared_acquire(entry_->refs_);
+    }
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>::pooled_shared(pooled_shared&& other) : entry_(other.entry_)
+{
+    other.entry_ = nullptr;
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>::~pooled_shared()
+{
+    reset();
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>& pooled_shared<T, Atomic, Traits>::operator=(
+    const pooled_shared& other)
+{
+    // copy first in case other is owned by the object this releases
+    pooled_shared(other).swap(*this);
+    return *this;
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>& pooled_shared<T, Atomic, Traits>::operator=(
+    pooled_shared&& other)
+{
+    pooled_shared(std::move(other)).swap(*this);
+    return *this;
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>& pooled_shared<T, Atomic, Traits>::operator=(std::nullptr_t)
+{
+    reset();
+    return *this;
+}
+
+template <typename T, bool Atomic, typename Traits>
+T* pooled_shared<T, Atomic, Traits>::get() const
+{
+    return entry_ ? &entry_->value_ : nullptr;
+}
+
+template <typename T, bool Atomic, typename Traits>
+T& pooled_shared<T, Atomic, Traits>::operator*() const
+{
+    assert(entry_ != nullptr);
+    return entry_->value_;
+}
+
+template <typename T, bool Atomic, typename Traits>
+T* pooled_shared<T, Atomic, Traits>::operator->() const
+{
+    assert(entry_ != nullptr);
+    return &entry_->value_;
+}
+
+template <typename T, bool Atomic, typename Traits>
+pooled_shared<T, Atomic, Traits>::operator bool() const
+{
+    return entry_ != nullptr;
+}
+
+template <typename T, bool Atomic, typename Traits>
+uint32_t pooled_shared<T, Atomic, Traits>::use_count() const
+{
+    return entry_ ? static_cast<uint32_t>(entry_->refs_) : 0;
+}
+
+template <typename T, bool Atomic, typename Traits>
+void pooled_shared<T, Atomic, Traits>::reset()
+{
+    Entry* entry = entry_;
+    entry_ = nullptr;
+    if (entry && detail::shared_release(entry->refs_) == 0)
+    {
+        SharedObjectPool<T, Atomic, Traits>::release(entry);
+    }
+}
+
+template <typename T, bool Atomic, typename Traits>
+void pooled_shared<T, Atomic, Traits>::swap(pooled_shared& other)
+{
+    std::swap(entry_, other.entry_);
+}
+
+template <typename T, bool A, typename Tr>
+bool operator==(const pooled_shared<T, A, Tr>& lhs, const pooled_shared<T, A, Tr>& rhs)
+{
+    return lhs.get() == rhs.get();
+}
+
+template <typename T, bool A, typename Tr>
+bool operator!=(const pooled_shared<T, A, Tr>& lhs, const pooled_shared<T, A, Tr>& rhs)
+{
+    return lhs.get() != rhs.get();
+}
+
+template <typename T, bool A, typename Tr>
+bool operator==(const pooled_shared<T, A, Tr>& lhs, std::nullptr_t)
+{
+    return lhs.get() == nullptr;
+}
+
+template <typename T, bool A, typename Tr>
+bool operator!=(const pooled_shared<T, A, Tr>& lhs, std::nullptr_t)
+{
+    return lhs.get() != nullptr;
+}
+
+template <typename T, bool Atomic, typename Traits>
+SharedObjectPool<T, Atomic, Traits>::SharedObjectPool(index_t entries_per_block)
+    : pool_(entries_per_block)
+{
+    pool_.set_owner(this);
+}
+
+template <typename T, bool Atomic, typename Traits>
+SharedObjectPool<T, Atomic, Traits>::~SharedObjectPool()
+{
+    assert(pool_.calc_stats().num_allocations == 0);
+}
+
+template <typename T, bool Atomic, typename Traits>
+template <class... P>
+pooled_shared<T, Atomic, Traits> SharedObjectPool<T, Atomic, Traits>::make_shared(
+    P&&... params)
+{
+    return pointer_t(pool_.new_object(std::forward<P>(params)...));
+}
+
+template <typename T, bool Atomic, typename Traits>
+void SharedObjectPool<T, Atomic, Traits>::release(Entry* entry)
+{
+    static_cast<SharedObjectPool*>(Pool::find_owner(entry))->pool_.delete_object(entry);
+}
+
+template <typename T, bool Atomic, typename Traits>
+void SharedObjectPool<T, Atomic, Traits>::reclaim_memory()
+{
+    pool_.reclaim_memory();
+}
+
+template <typename T, bool Atomic, typename Traits>
+template <typename F>
+void SharedObjectPool<T, Atomic, Traits>::for_each(const F func) const
+{
+    pool_.for_each([&func](Entry* entry)
+        {
+            func(&entry->value_);
+        });
+}
+
+template <typename T, bool Atomic, typename Traits>
+ObjectPoolStats SharedObjectPool<T, Atomic, Traits>::calc_stats() const
+{
+    return pool_.calc_stats();
+}
+
+#endif // _BITS_POOLED_SHARED_INL_
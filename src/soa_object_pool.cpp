@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#include "soa_object_pool.hpp"
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace tests
+{
+
+TEST_CASE("SoAObjectPool new and delete", "[soapool]")
+{
+    typedef SoAObjectPool<float, double, uint32_t> PoolT;
+    PoolT pool(64);
+    CHECK(pool.field_data<0>(0) == nullptr);
+
+    const PoolT::index_t a = pool.new_entry(1.0f, 2.0, 3u);
+    const PoolT::index_t b = pool.new_entry();
+    REQUIRE(a != pool.max_entries());
+    REQUIRE(b != pool.max_entries());
+    // the first field is the block's entries, the others are cache line aligned
+    CHECK((reinterpret_cast<uintptr_t>(pool.field_data<0>(0)) % alignof(float)) == 0u);
+    CHECK((reinterpret_cast<uintptr_t>(pool.field_data<1>(0)) % detail::MIN_BLOCK_ALIGN) == 0u);
+    CHECK((reinterpret_cast<uintptr_t>(pool.field_data<2>(0)) % detail::MIN_BLOCK_ALIGN) == 0u);
+    CHECK(a != b);
+    CHECK(pool.get<0>(a) == 1.0f);
+    CHECK(pool.get<1>(a) == 2.0);
+    CHECK(pool.get<2>(a) == 3u);
+    CHECK(pool.get<0>(b) == 0.0f);
+    CHECK(pool.get<2>(b) == 0u);
+    pool.get<2>(b) = 7u;
+    CHECK(pool.field_data<2>(0)[b] == 7u);
+    CHECK(pool.calc_stats().num_allocations == 2u);
+
+    // handles go stale when the entry is deleted and reused
+    const PoolT::Handle h = pool.get_handle(a);
+    CHECK(pool.get_index(h) == a);
+    pool.delete_entry(a);
+    CHECK(!pool.is_live(a));
+    CHECK(pool.get_index(h) == pool.max_entries());
+    CHECK(pool.new_entry(4.0f, 5.0, 6u) == a);
+    CHECK(pool.get_index(h) == pool.max_entries());
+    CHECK(pool.get_index(PoolT::Handle()) == pool.max_entries());
+
+    // a full pool returns max_entries
+    while (pool.new_entry() != pool.max_entries())
+    {
+    }
+    ObjectPoolStats stats = pool.calc_stats();
+    CHECK(stats.num_allocations == 64u);
+    CHECK(stats.failed_allocations == 1u);
+    CHECK(stats.bytes_reserved > 64 * (sizeof(float) + sizeof(double) + sizeof(uint32_t)));
+    pool.delete_all();
+    CHECK(pool.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("SoAObjectPool spans of live runs", "[soapool]")
+{
+    typedef SoAObjectPool<float, float, std::string> PoolT;
+    PoolT pool(256);
+    std::vector<PoolT::index_t> entries;
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        entries.push_back(pool.new_entry(float(i), 1.0f, std::to_string(i)));
+    }
+    // delete entries in 3..9, 64..127 and 250..255 to split the runs
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        if ((i >= 3 && i < 10) || (i >= 64 && i < 128) || i >= 250)
+        {
+            pool.delete_entry(entries[i]);
+        }
+    }
+
+    std::vector<std::pair<PoolT::index_t, PoolT::index_t> > runs;
+    pool.for_each_run([&runs](PoolT::index_t first, PoolT::index_t last)
+        {
+            runs.push_back(std::make_pair(first, last));
+        });
+    REQUIRE(runs.size() == 3u);
+    CHECK(runs[0] == std::make_pair(PoolT::index_t(0), PoolT::index_t(3)));
+    CHECK(runs[1] == std::make_pair(PoolT::index_t(10), PoolT::index_t(64)));
+    CHECK(runs[2] == std::make_pair(PoolT::index_t(128), PoolT::index_t(250)));
+
+    // update one field from another over each span
+    size_t count = 0;
+    pool.for_each_span<0, 1>([&count](size_t n, float* x, const float* vx)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                x[i] += vx[i];
+            }
+            count += n;
+        });
+    CHECK(count == 3u + 54u + 122u);
+    for (auto& run : runs)
+    {
+        for (PoolT::index_t i = run.first; i != run.second; ++i)
+        {
+            CHECK(pool.get<0>(i) == float(i) + 1.0f);
+            CHECK(pool.get<2>(i) == std::to_string(i));
+        }
+    }
+    pool.delete_all();
+    CHECK(pool.calc_stats().num_allocations == 0u);
+}
+
+TEST_CASE("SoAObjectPool multiple blocks", "[soapool]")
+{
+    typedef SoAObjectPool<uint32_t, uint64_t> PoolT;
+    PoolT pool(1000, 50);
+    CHECK(pool.entries_per_block() == 64u);
+    CHECK(pool.max_entries() == 1024u);
+    std::vector<PoolT::index_t> entries;
+    for (uint32_t i = 0; i < 1024; ++i)
+    {
+        entries.push_back(pool.new_entry(i, i * 2u));
+        REQUIRE(entries.back() != pool.max_entries());
+    }
+    CHECK(pool.new_entry() == pool.max_entries());
+    CHECK(pool.calc_stats().num_blocks == 16u);
+    const PoolT::Handle h = pool.get_handle(entries[700]);
+    CHECK(h.block == 700u / 64);
+    CHECK(pool.get_index(h) == entries[700]);
+
+    // keep a pseudo random half, with blocks 2 to 4 fully occupied
+    std::vector<bool> live(1024, true);
+    uint32_t seed = 12345;
+    for (uint32_t i = 0; i < 1024; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        if ((i < 128 || i >= 320) && (seed >> 16) % 2 == 0)
+        {
+            pool.delete_entry(entries[i]);
+            live[i] = false;
+        }
+    }
+    CHECK(pool.get_index(h) == (live[700] ? entries[700] : pool.max_entries()));
+
+    // spans cover exactly the live entries, whether passed whole or singly
+    std::vector<bool> visited(1024, false);
+    size_t longest = 0;
+    pool.for_each_span<0, 1>([&](size_t count, const uint32_t* a, const uint64_t* b)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                CHECK(b[i] == a[i] * 2u);
+                CHECK(!visited[a[i]]);
+                visited[a[i]] = true;
+            }
+            longest = std::max(longest, count);
+        });
+    CHECK(visited == live);
+    // spans end at block boundaries
+    CHECK(longest == 64u);
+
+    // freed entries in the first block with space are reused first
+    const size_t first_free = std::find(live.begin(), live.end(), false) - live.begin();
+    const PoolT::index_t reused = pool.new_entry(0u, 0u);
+    CHECK((reused / 64) == (first_free / 64));
+    CHECK(!live[reused]);
+    pool.delete_all();
+    CHECK(pool.calc_stats().num_allocations == 0u);
+}
+
+/// Field too large for a block to fit in the address space
+struct SoAHuge
+{
+    uint8_t data[1 << 20];
+};
+
+TEST_CASE("SoAObjectPool failed block allocation", "[soapool]")
+{
+    SoAObjectPool<uint8_t, SoAHuge> pool(1u << 27, 1u << 27);
+    CHECK(pool.new_entry() == pool.max_entries());
+    CHECK(pool.calc_stats().failed_allocations == 1u);
+    CHECK(pool.calc_stats().num_blocks == 0u);
+}
+
+/// Field aligned beyond a cache line
+struct alignas(256) SoAWide
+{
+    float lanes_[64];
+};
+
+TEST_CASE("SoAObjectPool over aligned fields", "[soapool]")
+{
+    typedef SoAObjectPool<uint8_t, SoAWide> PoolT;
+    PoolT pool(3);
+    const PoolT::index_t a = pool.new_entry();
+    REQUIRE(a != pool.max_entries());
+    CHECK((reinterpret_cast<uintptr_t>(pool.field_data<1>(0)) % alignof(SoAWide)) == 0u);
+    pool.get<1>(a).lanes_[63] = 1.0f;
+    CHECK(pool.get<1>(a).lanes_[63] == 1.0f);
+    pool.delete_all();
+}
+
+} // namespace tests
+
+#endif // UNIT_TESTS
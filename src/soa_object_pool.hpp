@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef _BITS_SOA_OBJECT_POOL_HPP_
+#define _BITS_SOA_OBJECT_POOL_HPP_
+
+#include "object_pool.hpp"
+
+#include <tuple>
+
+namespace detail
+{
+
+/// Compile time list of indices for expanding over a parameter pack
+template <size_t... I>
+struct IndexSequence
+{
+};
+
+template <size_t N, size_t... I>
+struct MakeIndexSequence : MakeIndexSequence<N - 1, N - 1, I...>
+{
+};
+
+template <size_t... I>
+struct MakeIndexSequence<0, I...>
+{
+    typedef IndexSequence<I...> type;
+};
+
+/// The largest alignment of the given types
+template <typename... Ts>
+struct MaxAlign;
+
+template <typename T>
+struct MaxAlign<T> : std::integral_constant<size_t, alignof(T)>
+{
+};
+
+template <typename T, typename... Ts>
+struct MaxAlign<T, Ts...>
+    : std::integral_constant<size_t,
+          (alignof(T) > MaxAlign<Ts...>::value ? alignof(T) : MaxAlign<Ts...>::value)>
+{
+};
+
+} // namespace detail
+
+/// SoAObjectPool is a pool storing each field of its entries in separate
+/// contiguous arrays per block, a structure of arrays layout.
+///
+/// Each block is an ObjectPoolBlock whose entries are the first field, so
+/// occupancy uses the same free list, generations and occupancy scan as the
+/// other pools. The arrays of the remaining fields follow in the same
+/// allocation, each aligned to a cache line. Blocks are added as entries are
+/// needed, up to max_entries rounded up to whole blocks, and are kept until
+/// the pool is destroyed.
+///
+/// Entries are identified by index, the block number times
+/// entries_per_block() plus the entry's position in its block.
+/// for_each_span passes pointers to runs of consecutive live entries for the
+/// selected fields, so kernels touching a few fields only load those fields
+/// and can be auto-vectorised.
+template <typename... Fields>
+class SoAObjectPool
+{
+    static_assert(sizeof...(Fields) != 0, "SoAObjectPool needs at least one field");
+
+public:
+    typedef detail::index_t index_t;
+    typedef ObjectPoolHandle Handle;
+
+    /// The type of field I
+    template <size_t I>
+    using field_t = typename std::tuple_element<I, std::tuple<Fields...> >::type;
+
+    /// Entries per block unless the constructor is given otherwise
+    static const index_t DEFAULT_ENTRIES_PER_BLOCK = 4096;
+
+    /// Creates a pool of at least max_entries entries. entries_per_block is
+    /// rounded up to a power of two, and down to the smallest power of two
+    /// holding max_entries.
+    SoAObjectPool(index_t max_entries, index_t entries_per_block = DEFAULT_ENTRIES_PER_BLOCK);
+    ~SoAObjectPool();
+
+    /// Allocates an entry with default constructed fields, returning its
+    /// index or max_entries() if there is no available space.
+    index_t new_entry();
+
+    /// Allocates an entry with fields constructed from the given values,
+    /// returning its index or max_entries() if there is no available space.
+    index_t new_entry(Fields... values);
+
+    /// Deletes the entry at the given index, which must be live.
+    void delete_entry(index_t index);
+
+    /// Delete all current allocations
+    void delete_all();
+
+    /// Returns the maximum number of entries, a whole number of blocks
+    index_t max_entries() const;
+
+    /// Returns the number of entries in each block
+    index_t entries_per_block() const;
+
+    /// Returns true if the entry at the given index is live
+    bool is_live(index_t index) const;
+
+    /// Returns field I of the entry at the given index
+    template <size_t I>
+    field_t<I>& get(index_t index) const;
+
+    /// Returns the start of the array of field I for the entries of the
+    /// given block, or nullptr if the block has not been added yet.
+    template <size_t I>
+    field_t<I>* field_data(index_t block) const;
+
+    /// Returns a handle to the entry at the given index, which must be live
+    Handle get_handle(index_t index) const;
+
+    /// Returns the index of the entry referred to by the handle, or
+    /// max_entries() if the entry has since been deleted.
+    index_t get_index(Handle handle) const;
+
+    /// Calls func(first, last) for each run of consecutive live entries with
+    /// indices in [first, last), in index order. Runs end at block ends.
+    template <typename F>
+    void for_each_run(const F func) const;
+
+    /// Calls func(count, field_data<I>(block) + first...) for each span of
+    /// count consecutive live entries, passing a pointer into each selected
+    /// field's array. For example for_each_span<0, 1>(func) calls
+    /// func(size_t count, field_t<0>* a, field_t<1>* b). Whole words of 64
+    /// live entries are joined into spans, while the live entries of partly
+    /// occupied words are passed one at a time, as finding such short runs
+    /// costs more than visiting their entries.
+    template <size_t... I, typename F>
+    void for_each_span(const F func) const;
+
+    /// Returns object pool stats in constant time. bytes_reserved includes
+    /// the field arrays.
+    ObjectPoolStats calc_stats() const;
+
+private:
+    typedef detail::ObjectPoolBlock<field_t<0>, ObjectPoolTraits> Block;
+
+    /// Returns the alignment of each field array after the first, a cache
+    /// line or the largest field alignment if that is larger
+    static size_t array_align();
+
+    /// Returns field I of the entry at the given position in a block
+    template <size_t I>
+    field_t<I>* field_at(Block* block, index_t index) const;
+
+    /// Allocates a block and its field arrays, returns nullptr on failure
+    Block* create_block() const;
+
+    /// Takes a free entry, adding a block if needed. Returns the entry's
+    /// block number, or num_blocks_ if the pool is full.
+    index_t reserve_entry(field_t<0>*& ptr);
+
+    /// Constructs field I, marking the entry allocated for the first field
+    template <size_t I, class P>
+    void construct_field(Block* block, index_t index, P&& value, std::true_type);
+    template <size_t I, class P>
+    void construct_field(Block* block, index_t index, P&& value, std::false_type);
+
+    template <size_t... I, class... P>
+    void construct_fields(
+        Block* block, index_t index, detail::IndexSequence<I...>, P&&... values);
+
+    /// Destructs field I, except the first which the block destructs
+    template <size_t I>
+    void destruct_field(Block* block, index_t index, std::true_type);
+    template <size_t I>
+    void destruct_field(Block* block, index_t index, std::false_type);
+
+    template <size_t... I>
+    void destruct_fields(Block* block, index_t index, detail::IndexSequence<I...>);
+
+    /// Allocates an entry and constructs its fields from values
+    template <class... P>
+    index_t emplace_entry(P&&... values);
+
+    typedef typename detail::MakeIndexSequence<sizeof...(Fields)>::type fields_t;
+
+    /// blocks by block number, nullptr for blocks not added yet
+    Block** blocks_;
+    /// the number of blocks the pool may add
+    index_t num_blocks_;
+    /// the number of blocks added
+    index_t num_created_;
+    /// the first block which may have a free entry
+    index_t free_block_;
+    const index_t entries_per_block_;
+    /// log2 of entries_per_block_, splitting indices into block and position
+    const uint32_t block_shift_;
+    /// offset of each field array from the start of its block
+    size_t offsets_[sizeof...(Fields)];
+    /// total size of a block and its field arrays
+    size_t block_size_;
+    detail::PoolCounters counters_;
+
+    SoAObjectPool(const SoAObjectPool&) = delete;
+    SoAObjectPool& operator=(const SoAObjectPool&) = delete;
+};
+
+#include "soa_object_pool.inl"
+
+#endif // _BITS_SOA_OBJECT_POOL_HPP_
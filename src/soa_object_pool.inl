@@ -0,0 +1,360 @@
+// Header guards an include is for code completion in IDEs
+// Don't include this file directly!
+#ifndef _BITS_SOA_OBJECT_POOL_INL_
+#define _BITS_SOA_OBJECT_POOL_INL_
+
+#ifndef _BITS_SOA_OBJECT_POOL_HPP_
+#include "soa_object_pool.hpp"
+#endif
+
+template <typename... Fields>
+const detail::index_t SoAObjectPool<Fields...>::DEFAULT_ENTRIES_PER_BLOCK;
+
+template <typename... Fields>
+size_t SoAObjectPool<Fields...>::array_align()
+{
+    return std::max<size_t>(detail::MIN_BLOCK_ALIGN, detail::MaxAlign<Fields...>::value);
+}
+
+template <typename... Fields>
+SoAObjectPool<Fields...>::SoAObjectPool(index_t max_entries, index_t entries_per_block)
+    : blocks_(nullptr),
+      num_blocks_(0),
+      num_created_(0),
+      free_block_(0),
+      entries_per_block_(static_cast<index_t>(detail::next_pow2(
+          std::max<index_t>(std::min(entries_per_block, max_entries), 1)))),
+      block_shift_(detail::count_trailing_zeros(entries_per_block_)),
+      block_size_(0)
+{
+    // the first field is the block's entries, the others follow it
+    const size_t sizes[] = {sizeof(Fields)...};
+    offsets_[0] = Block::alloc_size(entries_per_block_) - sizes[0] * entries_per_block_;
+    block_size_ = Block::alloc_size(entries_per_block_);
+    for (size_t i = 1; i != sizeof...(Fields); ++i)
+    {
+        offsets_[i] = detail::align_to(block_size_, array_align());
+        block_size_ = offsets_[i] + sizes[i] * entries_per_block_;
+    }
+    const index_t num_blocks = (max_entries + entries_per_block_ - 1) >> block_shift_;
+    // a pool which can't allocate its block list stays empty, so every
+    // new_entry fails
+    blocks_ = reinterpret_cast<Block**>(calloc(std::max<index_t>(num_blocks, 1), sizeof(Block*)));
+    if (blocks_)
+    {
+        num_blocks_ = num_blocks;
+    }
+}
+
+template <typename... Fields>
+SoAObjectPool<Fields...>::~SoAObjectPool()
+{
+    assert(calc_stats().num_allocations == 0);
+    for (index_t i = 0; i != num_blocks_; ++i)
+    {
+        if (Block* block = blocks_[i])
+        {
+            Block::destroy_at(block);
+            detail::aligned_free(block);
+        }
+    }
+    free(blocks_);
+}
+
+template <typename... Fields>
+template <size_t I>
+typename SoAObjectPool<Fields...>::template field_t<I>* SoAObjectPool<Fields...>::field_at(
+    Block* block, index_t index) const
+{
+    return reinterpret_cast<field_t<I>*>(reinterpret_cast<uint8_t*>(block) + offsets_[I]) + index;
+}
+
+template <typename... Fields>
+typename SoAObjectPool<Fields...>::Block* SoAObjectPool<Fields...>::create_block() const
+{
+    void* memory =
+        detail::aligned_malloc(block_size_, std::max(array_align(), Block::block_align()));
+    return memory ? Block::create_at(memory, entries_per_block_) : nullptr;
+}
+
+template <typename... Fields>
+template <size_t I, class P>
+void SoAObjectPool<Fields...>::construct_field(
+    Block* block, index_t index, P&& value, std::true_type)
+{
+    block->construct_reserved(field_at<I>(block, index), std::forward<P>(value));
+}
+
+template <typename... Fields>
+template <size_t I, class P>
+void SoAObjectPool<Fields...>::construct_field(
+    Block* block, index_t index, P&& value, std::false_type)
+{
+    new (field_at<I>(block, index)) field_t<I>(std::forward<P>(value));
+}
+
+template <typename... Fields>
+template <size_t... I, class... P>
+void SoAObjectPool<Fields...>::construct_fields(
+    Block* block, index_t index, detail::IndexSequence<I...>, P&&... values)
+{
+    // expand over each field in order, constructing it from the matching value
+    const int expand[] = {0,
+        (construct_field<I>(block, index, std::forward<P>(values),
+             std::integral_constant<bool, I == 0>()),
+            0)...};
+    (void)expand;
+}
+
+template <typename... Fields>
+template <size_t I>
+void SoAObjectPool<Fields...>::destruct_field(Block*, index_t, std::true_type)
+{
+}
+
+template <typename... Fields>
+template <size_t I>
+void SoAObjectPool<Fields...>::destruct_field(Block* block, index_t index, std::false_type)
+{
+    field_at<I>(block, index)->~field_t<I>();
+}
+
+template <typename... Fields>
+template <size_t... I>
+void SoAObjectPool<Fields...>::destruct_fields(
+    Block* block, index_t index, detail::IndexSequence<I...>)
+{
+    const int expand[] = {
+        0, (destruct_field<I>(block, index, std::integral_constant<bool, I == 0>()), 0)...};
+    (void)expand;
+}
+
+template <typename... Fields>
+detail::index_t SoAObjectPool<Fields...>::reserve_entry(field_t<0>*& ptr)
+{
+    for (; free_block_ != num_blocks_; ++free_block_)
+    {
+        Block*& block = blocks_[free_block_];
+        if (!block)
+        {
+            block = create_block();
+            if (!block)
+            {
+                break;
+            }
+            ++num_created_;
+        }
+        if ((ptr = block->reserve_entry()) != nullptr)
+        {
+            return free_block_;
+        }
+    }
+    return num_blocks_;
+}
+
+template <typename... Fields>
+template <class... P>
+detail::index_t SoAObjectPool<Fields...>::emplace_entry(P&&... values)
+{
+    field_t<0>* ptr = nullptr;
+    const index_t block_index = reserve_entry(ptr);
+    if (block_index == num_blocks_)
+    {
+        counters_.failed(1);
+        return max_entries();
+    }
+    Block* block = blocks_[block_index];
+    const index_t index = block->index_of(ptr);
+    construct_fields(block, index, fields_t(), std::forward<P>(values)...);
+    counters_.allocated(1);
+    return (block_index << block_shift_) | index;
+}
+
+template <typename... Fields>
+detail::index_t SoAObjectPool<Fields...>::new_entry()
+{
+    return emplace_entry(Fields()...);
+}
+
+template <typename... Fields>
+detail::index_t SoAObjectPool<Fields...>::new_entry(Fields... values)
+{
+    return emplace_entry(std::move(values)...);
+}
+
+template <typename... Fields>
+void SoAObjectPool<Fields...>::delete_entry(index_t index)
+{
+    assert(is_live(index));
+    const index_t block_index = index >> block_shift_;
+    Block* block = blocks_[block_index];
+    index &= entries_per_block_ - 1;
+    destruct_fields(block, index, fields_t());
+    // the block destructs the first field
+    block->delete_object(field_at<0>(block, index));
+    free_block_ = std::min(free_block_, block_index);
+    counters_.freed(1);
+}
+
+template <typename... Fields>
+void SoAObjectPool<Fields...>::delete_all()
+{
+    for (index_t i = 0; i != num_blocks_; ++i)
+    {
+        if (Block* block = blocks_[i])
+        {
+            block->for_each_run([this, block](index_t first, index_t last)
+                {
+                    for (index_t index = first; index != last; ++index)
+                    {
+                        destruct_fields(block, index, fields_t());
+                    }
+                });
+            block->delete_all();
+        }
+    }
+    free_block_ = 0;
+    counters_.freed(counters_.num_allocations);
+}
+
+template <typename... Fields>
+detail::index_t SoAObjectPool<Fields...>::max_entries() const
+{
+    return num_blocks_ << block_shift_;
+}
+
+template <typename... Fields>
+detail::index_t SoAObjectPool<Fields...>::entries_per_block() const
+{
+    return entries_per_block_;
+}
+
+template <typename... Fields>
+bool SoAObjectPool<Fields...>::is_live(index_t index) const
+{
+    const index_t block_index = index >> block_shift_;
+    if (block_index >= num_blocks_ || !blocks_[block_index])
+    {
+        return false;
+    }
+    const Block* block = blocks_[block_index];
+    index &= entries_per_block_ - 1;
+    return block->get_object(index, block->generation_of(index)) != nullptr;
+}
+
+template <typename... Fields>
+template <size_t I>
+typename SoAObjectPool<Fields...>::template field_t<I>& SoAObjectPool<Fields...>::get(
+    index_t index) const
+{
+    assert(is_live(index));
+    return *field_at<I>(blocks_[index >> block_shift_], index & (entries_per_block_ - 1));
+}
+
+template <typename... Fields>
+template <size_t I>
+typename SoAObjectPool<Fields...>::template field_t<I>* SoAObjectPool<Fields...>::field_data(
+    index_t block) const
+{
+    assert(block < num_blocks_);
+    return blocks_[block] ? field_at<I>(blocks_[block], 0) : nullptr;
+}
+
+template <typename... Fields>
+ObjectPoolHandle SoAObjectPool<Fields...>::get_handle(index_t index) const
+{
+    assert(is_live(index));
+    Handle handle;
+    handle.block = index >> block_shift_;
+    handle.index = index & (entries_per_block_ - 1);
+    handle.generation = blocks_[handle.block]->generation_of(handle.index);
+    return handle;
+}
+
+template <typename... Fields>
+detail::index_t SoAObjectPool<Fields...>::get_index(Handle handle) const
+{
+    if (handle.block < num_blocks_ && blocks_[handle.block] &&
+        blocks_[handle.block]->get_object(handle.index, handle.generation))
+    {
+        return (handle.block << block_shift_) | handle.index;
+    }
+    return max_entries();
+}
+
+template <typename... Fields>
+template <typename F>
+void SoAObjectPool<Fields...>::for_each_run(const F func) const
+{
+    for (index_t i = 0; i != num_blocks_; ++i)
+    {
+        if (const Block* block = blocks_[i])
+        {
+            const index_t base = i << block_shift_;
+            block->for_each_run([base, &func](index_t first, index_t last)
+                {
+                    func(base + first, base + last);
+                });
+        }
+    }
+}
+
+template <typename... Fields>
+template <size_t... I, typename F>
+void SoAObjectPool<Fields...>::for_each_span(const F func) const
+{
+    for (index_t i = 0; i != num_blocks_; ++i)
+    {
+        Block* block = blocks_[i];
+        if (!block)
+        {
+            continue;
+        }
+        // the span of whole occupied words not yet passed to func
+        index_t span_first = 0;
+        index_t span_last = 0;
+        block->for_each_occupancy_word([&](index_t first, detail::bitmap_word_t word)
+            {
+                if (word == ~detail::bitmap_word_t(0))
+                {
+                    span_first = span_first == span_last ? first : span_first;
+                    span_last = first + 64;
+                    return;
+                }
+                if (span_first != span_last)
+                {
+                    func(static_cast<size_t>(span_last - span_first),
+                        field_at<I>(block, span_first)...);
+                    span_first = span_last;
+                }
+                for (; word != 0; word &= word - 1)
+                {
+                    const index_t index = first + detail::count_trailing_zeros(word);
+                    func(size_t(1), field_at<I>(block, index)...);
+                }
+            });
+        if (span_first != span_last)
+        {
+            func(static_cast<size_t>(span_last - span_first), field_at<I>(block, span_first)...);
+        }
+    }
+}
+
+template <typename... Fields>
+ObjectPoolStats SoAObjectPool<Fields...>::calc_stats() const
+{
+    ObjectPoolStats stats;
+    stats.num_blocks = num_created_;
+    stats.peak_blocks = num_created_;
+    stats.bytes_reserved = num_created_ * block_size_;
+    stats.bytes_metadata =
+        num_created_ * Block::metadata_size(entries_per_block_) + num_blocks_ * sizeof(Block*);
+    stats.num_allocations = counters_.num_allocations;
+    stats.high_water_mark = counters_.high_water_mark;
+    stats.total_allocations = counters_.total_allocations;
+    stats.total_frees = counters_.total_frees;
+    stats.failed_allocations = counters_.failed_allocations;
+    return stats;
+}
+
+#endif // _BITS_SOA_OBJECT_POOL_INL_
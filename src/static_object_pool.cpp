@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#include "static_object_pool.hpp"
+
+//
+// Tests
+//
+
+#if UNIT_TESTS
+
+#include "catch.hpp"
+#include "pool_ptr.hpp"
+
+#include <vector>
+
+namespace tests
+{
+
+struct StaticTracked
+{
+    explicit StaticTracked(uint32_t value) : value_(value) { ++s_live; }
+    ~StaticTracked() { --s_live; }
+    uint32_t value_;
+    static int s_live;
+};
+
+int StaticTracked::s_live = 0;
+
+// small pools are their entries plus a single occupancy word and counters
+static_assert(sizeof(StaticObjectPool<uint32_t, 64>) ==
+                  64 * sizeof(uint32_t) + sizeof(uint64_t) + sizeof(detail::PoolCounters),
+    "single word occupancy");
+static_assert(std::is_same<StaticObjectPool<uint32_t, 1000>::index_t, uint16_t>::value,
+    "large pools use the narrowest index type");
+
+StaticObjectPool<StaticTracked, 8> g_static_pool;
+
+template <size_t N>
+void staticNewAndDelete()
+{
+    StaticObjectPool<uint32_t, N> pool;
+    std::vector<uint32_t*> v(N, nullptr);
+    for (uint32_t i = 0; i < N; ++i)
+    {
+        v[i] = pool.new_object(i);
+        REQUIRE(v[i] != nullptr);
+        CHECK(pool.index_of(v[i]) == i);
+    }
+    CHECK(pool.new_object(0u) == nullptr);
+    CHECK(pool.calc_stats().failed_allocations == 1u);
+    CHECK(pool.calc_stats().num_allocations == N);
+
+    // delete every other entry, the rest are visited in order
+    for (uint32_t i = 0; i < N; i += 2)
+    {
+        pool.delete_object(v[i]);
+    }
+    uint32_t next = 1;
+    pool.for_each([&next](const uint32_t* p)
+        {
+            CHECK(*p == next);
+            next += 2;
+        });
+    CHECK(next == N / 2 * 2 + 1);
+
+    // freed entries are reused
+    for (uint32_t i = 0; i < N; i += 2)
+    {
+        uint32_t* p = pool.new_object(i);
+        REQUIRE(p != nullptr);
+        CHECK(*p == i);
+    }
+    CHECK(pool.new_object(0u) == nullptr);
+    size_t count = 0;
+    pool.for_each([&count](const uint32_t*)
+        {
+            ++count;
+        });
+    CHECK(count == N);
+
+    pool.delete_all();
+    ObjectPoolStats stats = pool.calc_stats();
+    CHECK(stats.num_allocations == 0u);
+    CHECK(stats.high_water_mark == N);
+    CHECK(stats.bytes_reserved == N * sizeof(uint32_t));
+    pool.for_each([](const uint32_t*)
+        {
+            FAIL("no objects should remain");
+        });
+    // the lowest entry is used first after delete_all
+    uint32_t* p = pool.new_object(7u);
+    CHECK(pool.index_of(p) == 0u);
+    pool.delete_object(p);
+}
+
+TEST_CASE("StaticObjectPool single word", "[staticpool]")
+{
+    staticNewAndDelete<1>();
+    staticNewAndDelete<10>();
+    staticNewAndDelete<64>();
+}
+
+TEST_CASE("StaticObjectPool free list", "[staticpool]")
+{
+    staticNewAndDelete<65>();
+    staticNewAndDelete<255>();
+    staticNewAndDelete<1000>();
+}
+
+TEST_CASE("StaticObjectPool destructs objects", "[staticpool]")
+{
+    {
+        StaticObjectPool<StaticTracked, 100> pool;
+        for (uint32_t i = 0; i < 50; ++i)
+        {
+            pool.new_object(i);
+        }
+        CHECK(StaticTracked::s_live == 50);
+        pool.delete_all();
+        CHECK(StaticTracked::s_live == 0);
+    }
+    {
+        typedef static_pooled_ptr<StaticObjectPool<StaticTracked, 8>, g_static_pool> StaticPtr;
+        StaticPtr p = make_pooled<StaticObjectPool<StaticTracked, 8>, g_static_pool>(3u);
+        REQUIRE(p);
+        CHECK(p->value_ == 3u);
+        CHECK(StaticTracked::s_live == 1);
+        CHECK(g_static_pool.calc_stats().num_allocations == 1u);
+    }
+    CHECK(StaticTracked::s_live == 0);
+    CHECK(g_static_pool.calc_stats().num_allocations == 0u);
+}
+
+} // namespace tests
+
+#endif // UNIT_TESTS
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2015 Cameron Hart
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+*/
+#ifndef _BITS_STATIC_OBJECT_POOL_HPP_
+#define _BITS_STATIC_OBJECT_POOL_HPP_
+
+#include "object_pool.hpp"
+
+namespace detail
+{
+
+/// Occupancy of a StaticObjectPool. Pools of up to 64 entries keep a single
+/// word with a bit set for each free entry, so allocating is a count
+/// trailing zeros and a clear of the lowest set bit.
+template <size_t N, bool SingleWord = (N <= 64)>
+class StaticOccupancy
+{
+public:
+    typedef typename IndexForCapacity<N>::type index_t;
+
+    StaticOccupancy();
+
+    /// Marks the lowest free entry as live and returns its index, or N if
+    /// every entry is live.
+    index_t acquire();
+
+    /// Marks a live entry as free
+    void release(index_t index);
+
+    /// Returns true if the entry is live
+    bool is_live(index_t index) const;
+
+    /// Marks every entry as free
+    void clear();
+
+    /// Calls the given function with the index of each live entry in order
+    template <typename F>
+    void for_each(const F func) const;
+
+private:
+    /// bits set for valid entries, the low N bits of the word
+    static const bitmap_word_t ALL_ENTRIES =
+        N == 64 ? ~bitmap_word_t(0) : (bitmap_word_t(1) << (N % 64)) - 1;
+
+    bitmap_word_t free_;
+};
+
+/// Occupancy of a StaticObjectPool of more than 64 entries, using the same
+/// free list and index scan as ObjectPoolBlock.
+template <size_t N>
+class StaticOccupancy<N, false>
+{
+public:
+    typedef typename IndexForCapacity<N>::type index_t;
+
+    StaticOccupancy();
+
+    index_t acquire();
+    void release(index_t index);
+    bool is_live(index_t index) const;
+    void clear();
+
+    template <typename F>
+    void for_each(const F func) const;
+
+private:
+    /// an entry's own index when live, otherwise the next free entry
+    index_t indices_[N];
+    /// first free entry, N if full
+    index_t free_head_;
+};
+
+} // namespace detail
+
+/// StaticObjectPool is a fixed size pool of N entries which embeds its
+/// storage and occupancy in the pool object itself. It makes no heap
+/// allocation, so it can be placed in static storage, on the stack or inside
+/// another object, and its entries are reached without a pointer chase.
+///
+/// The layout is fixed at compile time. Up to 64 entries use a single
+/// occupancy word, larger pools a free list of the narrowest index type able
+/// to address N entries.
+template <typename T, size_t N>
+class StaticObjectPool
+{
+    static_assert(N > 0, "StaticObjectPool must have at least one entry");
+
+public:
+    typedef detail::StaticOccupancy<N> Occupancy;
+    typedef typename Occupancy::index_t index_t;
+    typedef T value_t;
+
+    StaticObjectPool();
+    ~StaticObjectPool();
+
+    /// Constructs a new object from the pool. Returns nullptr if there is no
+    /// available space.
+    template <class... P>
+    T* new_object(P&&... params);
+
+    /// Deletes the given pointer. The pointer must be owned by the pool.
+    void delete_object(const T* ptr);
+
+    /// Delete all current allocations
+    void delete_all();
+
+    /// Returns the index of an entry owned by the pool
+    index_t index_of(const T* ptr) const;
+
+    /// Calls the given function for all allocated entries
+    template <typename F>
+    void for_each(const F func) const;
+
+    /// Returns object pool stats in constant time
+    ObjectPoolStats calc_stats() const;
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+    /// Returns the entry at the given index
+    T* entry_at(index_t index) const;
+
+    /// Calls destructors on all live objects, unless they are trivial
+    void destruct_all(std::true_type);
+    void destruct_all(std::false_type);
+
+    Storage storage_[N];
+    Occupancy occupancy_;
+    detail::PoolCounters counters_;
+
+    StaticObjectPool(const StaticObjectPool&) = delete;
+    StaticObjectPool& operator=(const StaticObjectPool&) = delete;
+};
+
+#include "static_object_pool.inl"
+
+#endif // _BITS_STATIC_OBJECT_POOL_HPP_
@@ -0,0 +1,223 @@
+// Header guards an include is for code completion in IDEs
+// Don't include this file directly!
+#ifndef _BITS_STATIC_OBJECT_POOL_INL_
+#define _BITS_STATIC_OBJECT_POOL_INL_
+
+#ifndef _BITS_STATIC_OBJECT_POOL_HPP_
+#include "static_object_pool.hpp"
+#endif
+
+namespace detail
+{
+
+template <size_t N, bool SingleWord>
+StaticOccupancy<N, SingleWord>::StaticOccupancy() : free_(ALL_ENTRIES)
+{
+}
+
+template <size_t N, bool SingleWord>
+typename StaticOccupancy<N, SingleWord>::index_t StaticOccupancy<N, SingleWord>::acquire()
+{
+    if (free_ == 0)
+    {
+        return static_cast<index_t>(N);
+    }
+    const index_t index = static_cast<index_t>(count_trailing_zeros(free_));
+    free_ &= free_ - 1;
+    return index;
+}
+
+template <size_t N, bool SingleWord>
+void StaticOccupancy<N, SingleWord>::release(index_t index)
+{
+    assert(is_live(index));
+    free_ |= bitmap_word_t(1) << index;
+}
+
+template <size_t N, bool SingleWord>
+bool StaticOccupancy<N, SingleWord>::is_live(index_t index) const
+{
+    return index < N && (free_ & (bitmap_word_t(1) << index)) == 0;
+}
+
+template <size_t N, bool SingleWord>
+void StaticOccupancy<N, SingleWord>::clear()
+{
+    free_ = ALL_ENTRIES;
+}
+
+template <size_t N, bool SingleWord>
+template <typename F>
+void StaticOccupancy<N, SingleWord>::for_each(const F func) const
+{
+    for (bitmap_word_t word = ~free_ & ALL_ENTRIES; word != 0; word &= word - 1)
+    {
+        func(static_cast<index_t>(count_trailing_zeros(word)));
+    }
+}
+
+template <size_t N>
+StaticOccupancy<N, false>::StaticOccupancy()
+{
+    clear();
+}
+
+template <size_t N>
+typename StaticOccupancy<N, false>::index_t StaticOccupancy<N, false>::acquire()
+{
+    const index_t index = free_head_;
+    if (index != N)
+    {
+        free_head_ = indices_[index];
+        indices_[index] = index;
+    }
+    return index;
+}
+
+template <size_t N>
+void StaticOccupancy<N, false>::release(index_t index)
+{
+    assert(is_live(index));
+    indices_[index] = free_head_;
+    free_head_ = index;
+}
+
+template <size_t N>
+bool StaticOccupancy<N, false>::is_live(index_t index) const
+{
+    return index < N && indices_[index] == index;
+}
+
+template <size_t N>
+void StaticOccupancy<N, false>::clear()
+{
+    free_head_ = 0;
+    for (size_t i = 0; i < N; ++i)
+    {
+        indices_[i] = static_cast<index_t>(i + 1);
+    }
+}
+
+template <size_t N>
+template <typename F>
+void StaticOccupancy<N, false>::for_each(const F func) const
+{
+    bitmap_word_t words[SCAN_CHUNK_ENTRIES / 64];
+    for (size_t begin = 0; begin < N; begin += SCAN_CHUNK_ENTRIES)
+    {
+        const size_t count = std::min<size_t>(SCAN_CHUNK_ENTRIES, N - begin);
+        scan_occupancy(indices_, begin, count, words);
+        for (size_t i = 0, num_words = (count + 63) / 64; i != num_words; ++i)
+        {
+            for (bitmap_word_t word = words[i]; word != 0; word &= word - 1)
+            {
+                func(static_cast<index_t>(begin + i * 64 + count_trailing_zeros(word)));
+            }
+        }
+    }
+}
+
+} // namespace detail
+
+template <typename T, size_t N>
+StaticObjectPool<T, N>::StaticObjectPool()
+{
+}
+
+template <typename T, size_t N>
+StaticObjectPool<T, N>::~StaticObjectPool()
+{
+    assert(calc_stats().num_allocations == 0);
+}
+
+template <typename T, size_t N>
+T* StaticObjectPool<T, N>::entry_at(index_t index) const
+{
+    return reinterpret_cast<T*>(const_cast<Storage*>(storage_ + index));
+}
+
+template <typename T, size_t N>
+template <class... P>
+T* StaticObjectPool<T, N>::new_object(P&&... params)
+{
+    const index_t index = occupancy_.acquire();
+    if (index == N)
+    {
+        counters_.failed(1);
+        return nullptr;
+    }
+    counters_.allocated(1);
+    return new (entry_at(index)) T(std::forward<P>(params)...);
+}
+
+template <typename T, size_t N>
+void StaticObjectPool<T, N>::delete_object(const T* ptr)
+{
+    if (ptr)
+    {
+        const index_t index = index_of(ptr);
+        ptr->~T();
+        occupancy_.release(index);
+        counters_.freed(1);
+    }
+}
+
+template <typename T, size_t N>
+void StaticObjectPool<T, N>::destruct_all(std::true_type)
+{
+    // skip calling destructors for trivially destructible types
+}
+
+template <typename T, size_t N>
+void StaticObjectPool<T, N>::destruct_all(std::false_type)
+{
+    for_each([](T* ptr)
+        {
+            ptr->~T();
+        });
+}
+
+template <typename T, size_t N>
+void StaticObjectPool<T, N>::delete_all()
+{
+    destruct_all(std::is_trivially_destructible<T>());
+    occupancy_.clear();
+    counters_.freed(counters_.num_allocations);
+}
+
+template <typename T, size_t N>
+typename StaticObjectPool<T, N>::index_t StaticObjectPool<T, N>::index_of(const T* ptr) const
+{
+    const Storage* storage = reinterpret_cast<const Storage*>(ptr);
+    assert(storage >= storage_ && storage < storage_ + N);
+    return static_cast<index_t>(storage - storage_);
+}
+
+template <typename T, size_t N>
+template <typename F>
+void StaticObjectPool<T, N>::for_each(const F func) const
+{
+    const StaticObjectPool* pool = this;
+    occupancy_.for_each([pool, &func](index_t index)
+        {
+            func(pool->entry_at(index));
+        });
+}
+
+template <typename T, size_t N>
+ObjectPoolStats StaticObjectPool<T, N>::calc_stats() const
+{
+    ObjectPoolStats stats;
+    stats.num_blocks = 1;
+    stats.num_allocations = counters_.num_allocations;
+    stats.high_water_mark = counters_.high_water_mark;
+    stats.peak_blocks = 1;
+    stats.bytes_reserved = sizeof(storage_);
+    stats.bytes_metadata = sizeof(occupancy_);
+    stats.total_allocations = counters_.total_allocations;
+    stats.total_frees = counters_.total_frees;
+    stats.failed_allocations = counters_.failed_allocations;
+    return stats;
+}
+
+#endif // _BITS_STATIC_OBJECT_POOL_INL_